@@ -0,0 +1,170 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "Character/ShooterAimTraceComponent.h"
+#include "Components/SceneComponent.h"
+#include "GameFramework/Pawn.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/UObjectIterator.h"
+
+static FAutoConsoleCommandWithWorld GShooterAimTraceDumpCommand(
+	TEXT("Shooter.AimTrace.Dump"),
+	TEXT("Logs async trace, cache hit and sync fallback counters for every aim trace component in the world"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		for (const UShooterAimTraceComponent* AimTrace : TObjectRange<UShooterAimTraceComponent>())
+		{
+			if (AimTrace->GetWorld() == World)
+			{
+				AimTrace->DumpStats();
+			}
+		}
+	}));
+
+UShooterAimTraceComponent::UShooterAimTraceComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+
+	// trace once the view source has been moved and animated for this frame
+	PrimaryComponentTick.TickGroup = TG_PostUpdateWork;
+}
+
+void UShooterAimTraceComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// ignore the actor we're aiming for
+	QueryParams.Init(GetOwner(), FCollisionQueryParams(SCENE_QUERY_STAT(ShooterAimTrace), false, GetOwner()));
+
+	UpdateTickEnabled();
+}
+
+void UShooterAimTraceComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (!ViewSource)
+	{
+		return;
+	}
+
+	UWorld* World = GetWorld();
+
+	// pick up the result of the trace we issued last frame
+	FTraceDatum TraceData;
+
+	// skip it if a synchronous fallback has published a newer result since it was issued
+	if (World->QueryTraceData(PendingTrace, TraceData) && (!LatestResult.bValid || PendingTraceTime > LatestResult.TraceTime))
+	{
+		if (const FHitResult* Hit = FHitResult::GetFirstBlockingHit(TraceData.OutHits))
+		{
+			PublishResult(*Hit, PendingDirection, PendingTraceTime);
+
+		} else {
+
+			// nothing was hit, so build an empty result along the trace
+			PublishResult(FHitResult(TraceData.Start, TraceData.End), PendingDirection, PendingTraceTime);
+		}
+	}
+
+	// issue this frame's trace
+	PendingDirection = ViewSource->GetForwardVector();
+	PendingTraceTime = World->GetTimeSeconds();
+
+	const FVector Start = ViewSource->GetComponentLocation();
+	const FVector End = Start + (PendingDirection * TraceDistance);
+
+	PendingTrace = World->AsyncLineTraceByChannel(EAsyncTraceType::Single, Start, End, TraceChannel, GetQueryParams());
+
+	++NumAsyncTraces;
+}
+
+void UShooterAimTraceComponent::UpdateTickEnabled()
+{
+	// components on non-pawn owners always trace
+	const APawn* PawnOwner = Cast<APawn>(GetOwner());
+
+	if (!PawnOwner)
+	{
+		return;
+	}
+
+	SetComponentTickEnabled(PawnOwner->HasAuthority() || PawnOwner->IsLocallyControlled());
+}
+
+void UShooterAimTraceComponent::SetViewSource(USceneComponent* InViewSource, float InTraceDistance)
+{
+	ViewSource = InViewSource;
+	TraceDistance = InTraceDistance;
+}
+
+FVector UShooterAimTraceComponent::GetAimTargetLocation()
+{
+	if (!ViewSource)
+	{
+		return LatestResult.TargetLocation;
+	}
+
+	const FVector Start = ViewSource->GetComponentLocation();
+	const FVector Direction = ViewSource->GetForwardVector();
+
+	// use the cached result if it still matches our view
+	if (IsCacheFresh(Start, Direction))
+	{
+		++NumCacheHits;
+		return LatestResult.TargetLocation;
+	}
+
+	// the cache is stale, so trace right away
+	++NumSyncFallbacks;
+
+	FHitResult OutHit;
+
+	GetWorld()->LineTraceSingleByChannel(OutHit, Start, Start + (Direction * TraceDistance), TraceChannel, GetQueryParams());
+
+	PublishResult(OutHit, Direction, GetWorld()->GetTimeSeconds());
+
+	return LatestResult.TargetLocation;
+}
+
+void UShooterAimTraceComponent::DumpStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("%s aim trace: async %d, cache hits %d, sync fallbacks %d"),
+		*GetNameSafe(GetOwner()), NumAsyncTraces, NumCacheHits, NumSyncFallbacks);
+}
+
+bool UShooterAimTraceComponent::IsCacheFresh(const FVector& Start, const FVector& Direction) const
+{
+	if (!LatestResult.bValid)
+	{
+		return false;
+	}
+
+	// is the result too old?
+	if (GetWorld()->GetTimeSeconds() - LatestResult.TraceTime > StaleTolerance)
+	{
+		return false;
+	}
+
+	// has the view moved too far?
+	if (FVector::DistSquared(Start, LatestResult.Hit.TraceStart) > FMath::Square(MaxOriginDeviation))
+	{
+		return false;
+	}
+
+	// has the view turned too far?
+	return FVector::DotProduct(Direction, LatestResult.Direction) >= FMath::Cos(FMath::DegreesToRadians(MaxAimDeviation));
+}
+
+void UShooterAimTraceComponent::PublishResult(const FHitResult& Hit, const FVector& Direction, double TraceTime)
+{
+	LatestResult.Hit = Hit;
+	LatestResult.Direction = Direction;
+	LatestResult.TargetLocation = Hit.bBlockingHit ? Hit.ImpactPoint : Hit.TraceEnd;
+	LatestResult.TraceTime = TraceTime;
+	LatestResult.bValid = true;
+
+	// notify consumers
+	OnAimTraceUpdated.Broadcast(LatestResult);
+}
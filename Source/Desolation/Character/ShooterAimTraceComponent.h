@@ -0,0 +1,151 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Engine/HitResult.h"
+#include "WorldCollision.h"
+#include "Combat/ShooterCombatQueryParams.h"
+#include "ShooterAimTraceComponent.generated.h"
+
+class USceneComponent;
+
+/**
+ *  Result of a single aim trace
+ */
+USTRUCT(BlueprintType)
+struct FShooterAimTraceResult
+{
+	GENERATED_BODY()
+
+	/** Hit data for the trace. Holds the trace start and end even when nothing was hit */
+	UPROPERTY(BlueprintReadOnly, Category="Aim Trace")
+	FHitResult Hit;
+
+	/** Direction of the trace */
+	UPROPERTY(BlueprintReadOnly, Category="Aim Trace")
+	FVector Direction = FVector::ForwardVector;
+
+	/** Location to aim at. Either the impact point or the end of the trace */
+	UPROPERTY(BlueprintReadOnly, Category="Aim Trace")
+	FVector TargetLocation = FVector::ZeroVector;
+
+	/** World time when the trace was issued */
+	UPROPERTY(BlueprintReadOnly, Category="Aim Trace")
+	double TraceTime = 0.0;
+
+	/** If true, this result holds trace data */
+	UPROPERTY(BlueprintReadOnly, Category="Aim Trace")
+	bool bValid = false;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FShooterAimTraceUpdatedDelegate, const FShooterAimTraceResult&, Result);
+
+/**
+ *  Issues one async aim trace per frame from a view source and shares the result with every consumer
+ *  Weapons, crosshairs and interaction checks read the cached result instead of running their own blocking traces
+ *  A synchronous trace is only run when the cached result is too old or the view has moved too far since it was issued
+ */
+UCLASS(ClassGroup=(Shooter), meta=(BlueprintSpawnableComponent))
+class DESOLATION_API UShooterAimTraceComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+protected:
+
+	/** Collision channel to trace against */
+	UPROPERTY(EditAnywhere, Category="Aim Trace")
+	TEnumAsByte<ECollisionChannel> TraceChannel = ECC_Visibility;
+
+	/** Max distance of the aim trace */
+	UPROPERTY(EditAnywhere, Category="Aim Trace")
+	float TraceDistance = 10000.0f;
+
+	/** Max age in seconds of a cached result before consumers fall back to a synchronous trace */
+	UPROPERTY(EditAnywhere, Category="Aim Trace", meta = (ClampMin = 0, Units = "s"))
+	float StaleTolerance = 0.1f;
+
+	/** Max angle in degrees the view may have turned since the cached trace before it's considered stale */
+	UPROPERTY(EditAnywhere, Category="Aim Trace", meta = (ClampMin = 0, Units = "deg"))
+	float MaxAimDeviation = 2.0f;
+
+	/** Max distance the view may have moved since the cached trace before it's considered stale */
+	UPROPERTY(EditAnywhere, Category="Aim Trace", meta = (ClampMin = 0, Units = "cm"))
+	float MaxOriginDeviation = 25.0f;
+
+	/** Component the trace is issued from, along its forward vector */
+	UPROPERTY()
+	TObjectPtr<USceneComponent> ViewSource;
+
+	/** Most recent aim trace result */
+	FShooterAimTraceResult LatestResult;
+
+	/** Handle of the async trace issued this frame */
+	FTraceHandle PendingTrace;
+
+	/** Direction of the pending async trace */
+	FVector PendingDirection = FVector::ForwardVector;
+
+	/** World time when the pending async trace was issued */
+	double PendingTraceTime = 0.0;
+
+	/** Trace params built once for the owner */
+	FShooterCombatQueryParams QueryParams;
+
+	/** Number of async traces issued */
+	int32 NumAsyncTraces = 0;
+
+	/** Number of target requests served from the cache */
+	int32 NumCacheHits = 0;
+
+	/** Number of target requests that needed a synchronous trace */
+	int32 NumSyncFallbacks = 0;
+
+public:
+
+	/** Called whenever a new aim trace result is available */
+	UPROPERTY(BlueprintAssignable, Category="Aim Trace")
+	FShooterAimTraceUpdatedDelegate OnAimTraceUpdated;
+
+public:
+
+	/** Constructor */
+	UShooterAimTraceComponent();
+
+	/** Builds the trace params for the owner and decides whether to tick */
+	virtual void BeginPlay() override;
+
+	/** Reads back last frame's trace and issues this frame's */
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+public:
+
+	/** Only ticks for the server and the locally controlled owner. Simulated proxies never need an aim trace */
+	void UpdateTickEnabled();
+
+	/** Sets the component to trace from and the trace distance */
+	void SetViewSource(USceneComponent* InViewSource, float InTraceDistance);
+
+	/** Returns the most recent aim trace result, regardless of its age */
+	UFUNCTION(BlueprintPure, Category="Aim Trace")
+	const FShooterAimTraceResult& GetLatestResult() const { return LatestResult; }
+
+	/** Returns the location to aim at, using the cached result when it's still fresh */
+	UFUNCTION(BlueprintCallable, Category="Aim Trace")
+	FVector GetAimTargetLocation();
+
+	/** Logs the trace counters */
+	void DumpStats() const;
+
+protected:
+
+	/** Returns true if the cached result still matches the given view */
+	bool IsCacheFresh(const FVector& Start, const FVector& Direction) const;
+
+	/** Stores a new result and notifies consumers */
+	void PublishResult(const FHitResult& Hit, const FVector& Direction, double TraceTime);
+
+	/** Returns the trace params shared by async and sync traces */
+	FShooterQueryParamsRef GetQueryParams() const { return QueryParams.GetSelfParams(); }
+};
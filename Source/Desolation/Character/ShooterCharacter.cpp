@@ -3,6 +3,11 @@
 
 #include "ShooterCharacter.h"
 #include "ShooterWeapon/ShooterWeapon.h"
+#include "ShooterAimTraceComponent.h"
+#include "Combat/ShooterLagCompensation.h"
+#include "Combat/ShooterHitboxRegistry.h"
+#include "Combat/ShooterDamageSubsystem.h"
+#include "Combat/ShooterShotBatchComponent.h"
 #include "EnhancedInputComponent.h"
 #include "Components/InputComponent.h"
 #include "Components/PawnNoiseEmitterComponent.h"
@@ -10,13 +15,62 @@
 #include "Components/SkeletalMeshComponent.h"
 #include "Engine/World.h"
 #include "Camera/CameraComponent.h"
-#include "AbilitySystemComponent.h"
+#include "GameplayAbilities/ShooterGameplayTags.h"
+#include "Animation/AnimInstance.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Weapon Animation Switch"), STAT_ShooterWeaponAnimSwitch, STATGROUP_Game);
+
+static bool GShooterLogWeaponSwitchTime = false;
+static FAutoConsoleVariableRef CVarShooterLogWeaponSwitchTime(
+	TEXT("Shooter.Weapons.LogSwitchTime"),
+	GShooterLogWeaponSwitchTime,
+	TEXT("If true, logs the time in microseconds spent applying weapon animation on every weapon switch"));
 
 void AShooterCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 
 	AbilitySystemComponent->InitAbilityActorInfo(this, this);
+
+	// aim from the first person camera
+	AimTrace->SetViewSource(GetFirstPersonCameraComponent(), MaxAimDistance);
+
+	// record our hitboxes so remote shots against us can be rewound
+	if (UShooterLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UShooterLagCompensationSubsystem>())
+	{
+		LagCompensation->RegisterCharacter(this);
+	}
+
+	// make our capsule hittable by registry traces
+	if (UShooterHitboxRegistrySubsystem* HitboxRegistry = GetWorld()->GetSubsystem<UShooterHitboxRegistrySubsystem>())
+	{
+		HitboxRegistry->RegisterCharacter(this);
+	}
+}
+
+void AShooterCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// stop recording our hitboxes
+	if (UShooterLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UShooterLagCompensationSubsystem>())
+	{
+		LagCompensation->UnregisterCharacter(this);
+	}
+
+	if (UShooterHitboxRegistrySubsystem* HitboxRegistry = GetWorld()->GetSubsystem<UShooterHitboxRegistrySubsystem>())
+	{
+		HitboxRegistry->UnregisterCharacter(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AShooterCharacter::NotifyControllerChanged()
+{
+	Super::NotifyControllerChanged();
+
+	// only the server and the controlling client need to run the aim trace
+	AimTrace->UpdateTickEnabled();
 }
 
 AShooterCharacter::AShooterCharacter(const FObjectInitializer& FObjectInitializer)
@@ -25,13 +79,22 @@ AShooterCharacter::AShooterCharacter(const FObjectInitializer& FObjectInitialize
 	// create the noise emitter component
 	PawnNoiseEmitter = CreateDefaultSubobject<UPawnNoiseEmitterComponent>(TEXT("Pawn Noise Emitter"));
 
+	// create the aim trace component
+	AimTrace = CreateDefaultSubobject<UShooterAimTraceComponent>(TEXT("Aim Trace"));
+
+	// create the predicted shot batching component
+	ShotBatch = CreateDefaultSubobject<UShooterShotBatchComponent>(TEXT("Shot Batch"));
+
 	// configure movement
 	GetCharacterMovement()->RotationRate = FRotator(0.0f, 600.0f, 0.0f);
 
 	// Create and Replicate ASC
-	AbilitySystemComponent = CreateDefaultSubobject<UAbilitySystemComponent>(TEXT("AbilitySystemComponent"));
+	AbilitySystemComponent = CreateDefaultSubobject<UShooterAbilitySystemComponent>(TEXT("AbilitySystemComponent"));
 	AbilitySystemComponent->SetIsReplicated(true);
 
+	// rebuild the input dispatch table whenever granted abilities change
+	AbilitySystemComponent->OnAbilityListChanged.AddUObject(this, &AShooterCharacter::OnAbilityListChanged);
+
 	// TODO: Create (only) and add Attributes to protected variable in header..
 	
 }
@@ -48,6 +111,9 @@ void AShooterCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputCo
 		{
 			for (const auto& Binding : InputBindings->AbilityInputActions)
 			{
+				// add the input tag to the dispatch table. Spec handles are filled in once abilities are granted
+				AbilityInputDispatch.FindOrAdd(Binding.InputTag);
+
 				EnhancedInputComponent->BindAction(
 					Binding.InputAction,
 					ETriggerEvent::Started,
@@ -70,20 +136,65 @@ void AShooterCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputCo
 
 void AShooterCharacter::OnAbilityActivated(FGameplayTag InputTag)
 {
-	
-	//GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Red,FString::Printf(TEXT("ShooterCharacter Ability Activated")));
-	// Activate the WeaponFire Gameplay Ability
-	AbilitySystemComponent->TryActivateAbilitiesByTag(FGameplayTagContainer(InputTag));
+	// abilities replicate in after input is bound, so rebuild the dispatch table whenever the granted list changes
+	if (bAbilityInputDispatchDirty)
+	{
+		RebuildAbilityInputDispatch();
+	}
+
+	// activate the specs bound to this input. The fire ability gates itself on the equipped weapon
+	if (const TArray<FGameplayAbilitySpecHandle>* SpecHandles = AbilityInputDispatch.Find(InputTag))
+	{
+		for (const FGameplayAbilitySpecHandle& SpecHandle : *SpecHandles)
+		{
+			AbilitySystemComponent->TryActivateAbility(SpecHandle);
+		}
+	}
 }
 
 void AShooterCharacter::OnAbilityEnded(FGameplayTag InputTag)
 {
-	// Broadcast explicit "StopFire" tag 
-	const FGameplayTag StopFireTag =
-		FGameplayTag::RequestGameplayTag(TEXT("Survival.Ability.Weapon.StopFiring"));
+	// Broadcast explicit "StopFire" tag
 	FGameplayEventData EventData;
-	EventData.EventTag = StopFireTag;
-	AbilitySystemComponent->HandleGameplayEvent(StopFireTag, &EventData);
+	EventData.EventTag = ShooterGameplayTags::Ability_Weapon_StopFiring;
+	AbilitySystemComponent->HandleGameplayEvent(EventData.EventTag, &EventData);
+}
+
+void AShooterCharacter::RebuildAbilityInputDispatch()
+{
+	// keep the input tags, but drop the old spec handles
+	for (TPair<FGameplayTag, TArray<FGameplayAbilitySpecHandle>>& Entry : AbilityInputDispatch)
+	{
+		Entry.Value.Reset();
+	}
+
+	const TArray<FGameplayAbilitySpec>& Specs = AbilitySystemComponent->GetActivatableAbilities();
+
+	// map every input tag to the specs whose ability carries it
+	for (const FGameplayAbilitySpec& Spec : Specs)
+	{
+		if (!Spec.Ability)
+		{
+			continue;
+		}
+
+		const FGameplayTagContainer& AbilityTags = Spec.Ability->GetAssetTags();
+
+		for (TPair<FGameplayTag, TArray<FGameplayAbilitySpecHandle>>& Entry : AbilityInputDispatch)
+		{
+			if (AbilityTags.HasTag(Entry.Key))
+			{
+				Entry.Value.Add(Spec.Handle);
+			}
+		}
+	}
+
+	bAbilityInputDispatchDirty = false;
+}
+
+void AShooterCharacter::OnAbilityListChanged()
+{
+	bAbilityInputDispatchDirty = true;
 }
 
 float AShooterCharacter::TakeDamage(float Damage, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser)
@@ -100,20 +211,26 @@ float AShooterCharacter::TakeDamage(float Damage, struct FDamageEvent const& Dam
 	// Have we depleted HP?
 	if (CurrentHP <= 0.0f)
 	{
-		// deactivate the weapon
-		if (IsValid(CurrentWeapon))
-		{
-			CurrentWeapon->DeactivateWeapon();
-		}
+		// die once all of this frame's damage has been applied
+		UShooterDamageSubsystem::QueueOrResolveDeath(GetWorld(), this, FSimpleDelegate::CreateUObject(this, &AShooterCharacter::Die));
+	}
 
-		// reset the bullet counter UI
-		OnBulletCountUpdated.Broadcast(0, 0);
+	return Damage;
+}
 
-		// destroy this character
-		Destroy();
+void AShooterCharacter::Die()
+{
+	// deactivate the weapon
+	if (IsValid(CurrentWeapon))
+	{
+		CurrentWeapon->DeactivateWeapon();
 	}
 
-	return Damage;
+	// reset the bullet counter UI
+	OnBulletCountUpdated.Broadcast(0, 0);
+
+	// destroy this character
+	Destroy();
 }
 
 void AShooterCharacter::DoStartFiring()
@@ -196,19 +313,21 @@ void AShooterCharacter::UpdateWeaponHUD(int32 CurrentAmmo, int32 MagazineSize)
 
 FVector AShooterCharacter::GetWeaponTargetLocation()
 {
-	// trace ahead from the camera viewpoint
-	FHitResult OutHit;
+	FShooterCombatQueryScope QueryScope;
 
-	const FVector Start = GetFirstPersonCameraComponent()->GetComponentLocation();
-	const FVector End = Start + (GetFirstPersonCameraComponent()->GetForwardVector() * MaxAimDistance);
+	// use this frame's shared camera aim trace. It only traces synchronously if the cached result is stale
+	const FVector AimTarget = AimTrace->GetAimTargetLocation();
 
-	FCollisionQueryParams QueryParams;
-	QueryParams.AddIgnoredActor(this);
-
-	GetWorld()->LineTraceSingleByChannel(OutHit, Start, End, ECC_Visibility, QueryParams);
+	// the server sees remote players' targets later than they did, so aim where the target was on their screen
+	if (HasAuthority() && !IsLocallyControlled())
+	{
+		if (const UShooterLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UShooterLagCompensationSubsystem>())
+		{
+			return LagCompensation->CompensateAimTarget(this, GetFirstPersonCameraComponent()->GetComponentLocation(), AimTarget);
+		}
+	}
 
-	// return either the impact point or the trace end
-	return OutHit.bBlockingHit ? OutHit.ImpactPoint : OutHit.TraceEnd;
+	return AimTarget;
 }
 
 void AShooterCharacter::AddWeaponClass(const TSubclassOf<AShooterWeapon>& WeaponClass)
@@ -232,6 +351,9 @@ void AShooterCharacter::AddWeaponClass(const TSubclassOf<AShooterWeapon>& Weapon
 			// add the weapon to the owned list
 			OwnedWeapons.Add(AddedWeapon);
 
+			// grant the weapon's fire ability once for as long as we own it
+			GrantWeaponAbility(AddedWeapon);
+
 			// if we have an existing weapon, deactivate it
 			if (CurrentWeapon)
 			{
@@ -250,31 +372,93 @@ void AShooterCharacter::OnWeaponActivated(AShooterWeapon* Weapon)
 	// update the bullet counter
 	OnBulletCountUpdated.Broadcast(Weapon->GetMagazineSize(), Weapon->GetBulletCount());
 
-	// set the character mesh AnimInstances
-	GetFirstPersonMesh()->SetAnimInstanceClass(Weapon->GetFirstPersonAnimInstanceClass());
-	GetMesh()->SetAnimInstanceClass(Weapon->GetThirdPersonAnimInstanceClass());
+	// apply the weapon animation to the character meshes
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ShooterWeaponAnimSwitch);
+
+		const double SwitchStartTime = FPlatformTime::Seconds();
+
+		ApplyWeaponAnimation(GetFirstPersonMesh(), Weapon->GetFirstPersonAnimLayerClass(), Weapon->GetFirstPersonAnimInstanceClass(), LinkedFirstPersonLayerClass);
+		ApplyWeaponAnimation(GetMesh(), Weapon->GetThirdPersonAnimLayerClass(), Weapon->GetThirdPersonAnimInstanceClass(), LinkedThirdPersonLayerClass);
+
+		if (GShooterLogWeaponSwitchTime)
+		{
+			UE_LOG(LogTemp, Log, TEXT("%s switched animation to %s in %.1fus"), *GetName(), *GetNameSafe(Weapon), (FPlatformTime::Seconds() - SwitchStartTime) * 1000000.0);
+		}
+	}
 
-	// Grant the Fire Weapon Ability for this weapon
-	if (AbilitySystemComponent && Weapon->GetWeaponFireAbility())
+	// the weapon's fire ability was granted on pickup, so equipping only raises the tag that gates it
+	if (AbilitySystemComponent)
 	{
-		// 1. Create a spec with INDEX_NONE for InputID
-		FGameplayAbilitySpec Spec(
-			Weapon->GetWeaponFireAbility(),  // TSubclassOf<UGameplayAbility>
-			/*Level=*/ 1,
-			/*InputID=*/ 1,
-			/*SourceObject=*/ Weapon
-		);
-		
-		// 3. Give it to the ASC
-		AbilitySystemComponent->GiveAbility(Spec);
+		AbilitySystemComponent->SetLooseGameplayTagCount(ShooterGameplayTags::Weapon_Equipped, 1);
 	}
 }
 
+void AShooterCharacter::ApplyWeaponAnimation(USkeletalMeshComponent* TargetMesh, TSubclassOf<UAnimInstance> LayerClass, TSubclassOf<UAnimInstance> AnimInstanceClass, TSubclassOf<UAnimInstance>& LinkedLayerClass)
+{
+	if (!TargetMesh)
+	{
+		return;
+	}
+
+	if (LayerClass)
+	{
+		// already linked, nothing to do
+		if (LayerClass == LinkedLayerClass && TargetMesh->GetAnimInstance())
+		{
+			return;
+		}
+
+		// unlink the previous weapon's layers in case it implemented interfaces the new layers don't replace
+		if (LinkedLayerClass)
+		{
+			TargetMesh->UnlinkAnimClassLayers(LinkedLayerClass);
+		}
+
+		// relink the layers on the persistent anim instance. The base graph keeps running
+		TargetMesh->LinkAnimClassLayers(LayerClass);
+		LinkedLayerClass = LayerClass;
+
+	} else {
+
+		// the weapon has no layers, so fall back to swapping the whole anim instance
+		if (LinkedLayerClass)
+		{
+			TargetMesh->UnlinkAnimClassLayers(LinkedLayerClass);
+			LinkedLayerClass = nullptr;
+		}
+
+		// only re-initialize the animation if the class actually changes
+		if (AnimInstanceClass && TargetMesh->GetAnimClass() != AnimInstanceClass)
+		{
+			TargetMesh->SetAnimInstanceClass(AnimInstanceClass);
+		}
+	}
+}
+
+void AShooterCharacter::GrantWeaponAbility(AShooterWeapon* Weapon)
+{
+	// abilities are only granted by the server
+	if (!AbilitySystemComponent || !Weapon->GetWeaponFireAbility() || !HasAuthority())
+	{
+		return;
+	}
+
+	// weapons don't replicate, so the source object is the weapon's class. Clients can resolve it and match it to their own weapon
+	const FGameplayAbilitySpec Spec(Weapon->GetWeaponFireAbility(), /*Level=*/ 1, /*InputID=*/ 1, /*SourceObject=*/ Weapon->GetClass());
+
+	Weapon->SetFireAbilityHandle(AbilitySystemComponent->GiveAbility(Spec));
+}
+
 void AShooterCharacter::OnWeaponDeactivated(AShooterWeapon* Weapon)
 {
+	// send any shots fired with this weapon before the server sees the switch
+	ShotBatch->FlushShots();
+
+	// lower the equipped tag. The fire ability stays granted for the next time the weapon is equipped
 	if (AbilitySystemComponent)
 	{
-		AbilitySystemComponent->ClearAllAbilities();
+		AbilitySystemComponent->SetLooseGameplayTagCount(ShooterGameplayTags::Weapon_Equipped, 0);
 	}
 }
 
@@ -6,13 +6,19 @@
 #include "DesolationCharacter.h"
 #include "ShooterWeapon/ShooterWeaponHolder.h"
 #include "AbilitySystemInterface.h"
+#include "GameplayAbilities/ShooterAbilitySystemComponent.h"
+#include "GameplayAbilitySpecHandle.h"
 #include "DataAssets/AbilityInputActionBinding.h"
 #include "ShooterCharacter.generated.h"
 
 class AShooterWeapon;
+class UAnimInstance;
+class USkeletalMeshComponent;
 class UInputAction;
 class UInputComponent;
 class UPawnNoiseEmitterComponent;
+class UShooterAimTraceComponent;
+class UShooterShotBatchComponent;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FBulletCountUpdatedDelegate, int32, MagazineSize, int32, Bullets);
 
@@ -30,10 +36,24 @@ class DESOLATION_API AShooterCharacter : public ADesolationCharacter, public ISh
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Components", meta = (AllowPrivateAccess = "true"))
 	UPawnNoiseEmitterComponent* PawnNoiseEmitter;
 
+	/** Shares a per-frame camera aim trace between firing and any other aim consumers */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Components", meta = (AllowPrivateAccess = "true"))
+	UShooterAimTraceComponent* AimTrace;
+
+	/** Sends predicted shots to the server for confirmation */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Components", meta = (AllowPrivateAccess = "true"))
+	UShooterShotBatchComponent* ShotBatch;
+
 protected:
 
 	virtual void BeginPlay() override;
 
+	/** Gameplay cleanup */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Updates components that depend on who controls this character */
+	virtual void NotifyControllerChanged() override;
+
 	/** Fire weapon input action */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category ="Input")
 	UInputAction* FireAction;
@@ -68,6 +88,12 @@ protected:
 	/** Weapon currently equipped and ready to shoot with */
 	TObjectPtr<AShooterWeapon> CurrentWeapon;
 
+	/** Anim layer class currently linked into the first person mesh */
+	TSubclassOf<UAnimInstance> LinkedFirstPersonLayerClass;
+
+	/** Anim layer class currently linked into the third person mesh */
+	TSubclassOf<UAnimInstance> LinkedThirdPersonLayerClass;
+
 public:
 
 	// -------- IAbilitySystemInterface --------
@@ -96,9 +122,21 @@ protected:
 	UFUNCTION()
 	void OnAbilityEnded(FGameplayTag InputTag);
 
+	/** Maps each bound input tag to the spec handles of the abilities it activates */
+	TMap<FGameplayTag, TArray<FGameplayAbilitySpecHandle>> AbilityInputDispatch;
+
+	/** If true, the granted ability list changed since the dispatch table was built */
+	bool bAbilityInputDispatchDirty = true;
+
+	/** Rebuilds the input dispatch table from the granted ability specs */
+	void RebuildAbilityInputDispatch();
+
+	/** Flags the dispatch table for a rebuild when the granted ability list changes, on the server or as it replicates in */
+	void OnAbilityListChanged();
+
 	// the core GAS object
 	UPROPERTY(BlueprintReadWrite, Category="Ability System Component")
-	UAbilitySystemComponent* AbilitySystemComponent;
+	UShooterAbilitySystemComponent* AbilitySystemComponent;
 
 	// Add Attribute Set (ie. Health, Armor, Mana, etc.)
 
@@ -107,6 +145,11 @@ public:
 	/** Handle incoming damage */
 	virtual float TakeDamage(float Damage, struct FDamageEvent const& DamageEvent, AController* EventInstigator, AActor* DamageCauser) override;
 
+protected:
+
+	/** Called once HP is depleted and this frame's damage has been applied */
+	void Die();
+
 public:
 
 	/** Handles start firing input */
@@ -154,11 +197,37 @@ public:
 
 	//~End IShooterWeaponHolder interface
 
+protected:
+
+	/** Returns the aim trace component */
+	UShooterAimTraceComponent* GetAimTrace() const { return AimTrace; }
+
+public:
+
+	/** Returns the weapon currently equipped */
+	AShooterWeapon* GetCurrentWeapon() const { return CurrentWeapon; }
+
+	/** Returns the index of an owned weapon, or INDEX_NONE */
+	int32 GetOwnedWeaponIndex(const AShooterWeapon* Weapon) const { return OwnedWeapons.IndexOfByKey(Weapon); }
+
+	/** Returns the owned weapon at an index, or nullptr */
+	AShooterWeapon* GetOwnedWeapon(int32 Index) const { return OwnedWeapons.IsValidIndex(Index) ? OwnedWeapons[Index] : nullptr; }
+
 protected:
 
 	/** Returns true if the character already owns a weapon of the given class */
 	AShooterWeapon* FindWeaponOfType(TSubclassOf<AShooterWeapon> WeaponClass) const;
 
+	/** Grants a newly owned weapon's fire ability and caches its spec handle on the weapon */
+	void GrantWeaponAbility(AShooterWeapon* Weapon);
+
+	/**
+	 *  Applies a weapon's animation to a character mesh
+	 *  Relinks anim layers on the mesh's persistent anim instance if the weapon has them,
+	 *  otherwise swaps the whole anim instance class, which re-initializes the mesh's animation
+	 */
+	static void ApplyWeaponAnimation(USkeletalMeshComponent* TargetMesh, TSubclassOf<UAnimInstance> LayerClass, TSubclassOf<UAnimInstance> AnimInstanceClass, TSubclassOf<UAnimInstance>& LinkedLayerClass);
+
 	// TEST FOR DEBUGGING
 	UFUNCTION(Exec, BlueprintCallable, Category = "Debug")
 	void DebugPrintTags();
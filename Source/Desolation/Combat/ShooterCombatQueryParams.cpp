@@ -0,0 +1,412 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "Combat/ShooterCombatQueryParams.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "AIController.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Containers/Ticker.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/MemoryBase.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogShooterCombatQueries, Log, All);
+DEFINE_LOG_CATEGORY(LogShooterCombatQueries);
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Combat Queries"), STAT_ShooterCombatQueries, STATGROUP_Game);
+
+static bool GShooterPrebuiltQueryParams = true;
+static FAutoConsoleVariableRef CVarShooterPrebuiltQueryParams(
+	TEXT("Shooter.Queries.PrebuiltParams"),
+	GShooterPrebuiltQueryParams,
+	TEXT("If true, combat traces reuse their character's, weapon's or projectile instigator's prebuilt query params. If false, params are built for every trace"));
+
+/** Combat queries run since startup */
+static int64 GShooterCombatQueryCount = 0;
+
+/** Collision query params built by the combat param getters since startup. The prebuilt templates only build one when the target changes */
+static int64 GShooterQueryParamsBuilt = 0;
+
+/** Frames the allocation report waits after spawning its firefight, so the AI finds its target and pools and scratch buffers grow before anything is counted */
+static constexpr int32 ShooterQueryReportWarmupFrames = 60;
+
+/** Returns the heap allocations made by every thread since startup, or 0 if the allocator isn't counting them */
+static uint64 GetShooterHeapAllocationCount()
+{
+#if UE_STATS
+	return FMalloc::TotalMallocCalls + FMalloc::TotalReallocCalls;
+#else
+	return 0;
+#endif
+}
+
+/**
+ *  Phases of the combat query allocation report
+ */
+enum class EShooterQueryReportPhase : uint8
+{
+	Idle,
+	Warmup,
+	PerTraceParams,
+	PrebuiltParams,
+};
+
+/**
+ *  Measures heap allocations per frame in a firefight, first with params built for every combat trace, then with the prebuilt templates
+ *  Spawns rings of AI pawns around the local player and keeps the player alive so the fight lasts the whole report,
+ *  then removes the pawns and logs both phases
+ */
+struct FShooterQueryAllocationReport
+{
+	/** World the firefight runs in */
+	TWeakObjectPtr<UWorld> World;
+
+	/** AI pawns spawned for the firefight */
+	TArray<TWeakObjectPtr<APawn>> SpawnedPawns;
+
+	/** Player the AI pawns fight */
+	TWeakObjectPtr<APawn> PlayerPawn;
+
+	/** Whether the player could be damaged before the report made it invulnerable */
+	bool bSavedPlayerCanBeDamaged = true;
+
+	/** Current phase of the report */
+	EShooterQueryReportPhase Phase = EShooterQueryReportPhase::Idle;
+
+	/** Frames measured per phase */
+	int32 Frames = 0;
+
+	/** Frames left in the current phase */
+	int32 FramesLeft = 0;
+
+	/** Counters at the start of the current phase */
+	uint64 PhaseStartAllocations = 0;
+	int64 PhaseStartParamsBuilt = 0;
+	int64 PhaseStartQueries = 0;
+
+	/** Totals of the per trace phase */
+	uint64 PerTraceAllocations = 0;
+	int64 PerTraceParamsBuilt = 0;
+	int64 PerTraceQueries = 0;
+
+	/** Value of Shooter.Queries.PrebuiltParams before the report took it over */
+	bool bSavedPrebuiltParams = true;
+
+	/** Spawns the firefight and starts measuring for the given number of frames per phase */
+	void Start(UWorld* InWorld, int32 NumFrames, int32 NumPawns, const FString& PawnClassPath)
+	{
+		if (Phase != EShooterQueryReportPhase::Idle)
+		{
+			UE_LOG(LogShooterCombatQueries, Warning, TEXT("A combat query allocation report is already running"));
+			return;
+		}
+
+		const APlayerController* PlayerController = InWorld->GetFirstPlayerController();
+		APawn* Player = PlayerController ? PlayerController->GetPawn() : nullptr;
+
+		if (!Player)
+		{
+			UE_LOG(LogShooterCombatQueries, Warning, TEXT("The allocation report needs a local player pawn for the AI to fight"));
+			return;
+		}
+
+		// use the given pawn class, or the class of the first AI controlled pawn in the level
+		UClass* PawnClass = nullptr;
+
+		if (!PawnClassPath.IsEmpty())
+		{
+			PawnClass = LoadClass<APawn>(nullptr, *PawnClassPath);
+
+		} else {
+
+			for (TActorIterator<APawn> It(InWorld); It; ++It)
+			{
+				if (Cast<AAIController>(It->GetController()))
+				{
+					PawnClass = It->GetClass();
+					break;
+				}
+			}
+		}
+
+		if (!PawnClass)
+		{
+			UE_LOG(LogShooterCombatQueries, Warning, TEXT("The allocation report found no AI pawn class to spawn. Place an NPC in the level or pass a class path"));
+			return;
+		}
+
+#if !UE_STATS
+		UE_LOG(LogShooterCombatQueries, Warning, TEXT("Heap allocations are only counted in builds with stats. The report will show 0 allocations"));
+#endif
+
+		World = InWorld;
+		Frames = NumFrames;
+
+		SpawnFirefight(Player, PawnClass, NumPawns);
+
+		// keep the player alive, so the fight doesn't end partway through a phase
+		PlayerPawn = Player;
+		bSavedPlayerCanBeDamaged = Player->CanBeDamaged();
+		Player->SetCanBeDamaged(false);
+
+		bSavedPrebuiltParams = GShooterPrebuiltQueryParams;
+
+		BeginPhase(EShooterQueryReportPhase::Warmup);
+
+		// count frames on the core ticker, so the report doesn't need anything ticking in the world
+		FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FShooterQueryAllocationReport::Tick));
+	}
+
+	/** Spawns AI pawns in rings around the player, all facing in */
+	void SpawnFirefight(const APawn* Player, UClass* PawnClass, int32 NumPawns)
+	{
+		constexpr int32 PawnsPerRing = 20;
+		constexpr double FirstRingRadius = 1500.0;
+		constexpr double RingSpacing = 300.0;
+
+		const FVector PlayerLocation = Player->GetActorLocation();
+
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButDontSpawnIfColliding;
+
+		for (int32 Index = 0; Index < NumPawns; ++Index)
+		{
+			const double Radius = FirstRingRadius + RingSpacing * (Index / PawnsPerRing);
+			const double Angle = UE_TWO_PI * (Index % PawnsPerRing) / PawnsPerRing;
+
+			const FVector Location = PlayerLocation + FVector(FMath::Cos(Angle) * Radius, FMath::Sin(Angle) * Radius, 0.0);
+			const FRotator Facing(0.0, (PlayerLocation - Location).Rotation().Yaw, 0.0);
+
+			// pawns that would spawn inside level geometry are skipped. The report logs how many made it
+			APawn* Pawn = World->SpawnActor<APawn>(PawnClass, Location, Facing, SpawnParams);
+
+			if (!Pawn)
+			{
+				continue;
+			}
+
+			if (!Pawn->GetController())
+			{
+				Pawn->SpawnDefaultController();
+			}
+
+			SpawnedPawns.Add(Pawn);
+		}
+	}
+
+	/** Starts measuring a phase */
+	void BeginPhase(EShooterQueryReportPhase NewPhase)
+	{
+		Phase = NewPhase;
+		FramesLeft = NewPhase == EShooterQueryReportPhase::Warmup ? ShooterQueryReportWarmupFrames : Frames;
+		PhaseStartAllocations = GetShooterHeapAllocationCount();
+		PhaseStartParamsBuilt = GShooterQueryParamsBuilt;
+		PhaseStartQueries = GShooterCombatQueryCount;
+
+		switch (Phase)
+		{
+		case EShooterQueryReportPhase::Warmup:
+		case EShooterQueryReportPhase::PerTraceParams:
+			GShooterPrebuiltQueryParams = false;
+			break;
+
+		case EShooterQueryReportPhase::PrebuiltParams:
+			GShooterPrebuiltQueryParams = true;
+			break;
+
+		case EShooterQueryReportPhase::Idle:
+
+			// the report is over, so hand the CVar back
+			GShooterPrebuiltQueryParams = bSavedPrebuiltParams;
+			break;
+		}
+	}
+
+	/** Counts down the current phase and moves on when it's done. Returns false once the report is over */
+	bool Tick(float DeltaTime)
+	{
+		// don't leave the CVar overridden if the world goes away mid report
+		if (!World.IsValid())
+		{
+			Finish();
+			return false;
+		}
+
+		if (--FramesLeft > 0)
+		{
+			return true;
+		}
+
+		const uint64 Allocations = GetShooterHeapAllocationCount() - PhaseStartAllocations;
+		const int64 ParamsBuilt = GShooterQueryParamsBuilt - PhaseStartParamsBuilt;
+		const int64 Queries = GShooterCombatQueryCount - PhaseStartQueries;
+
+		if (Phase == EShooterQueryReportPhase::Warmup)
+		{
+			BeginPhase(EShooterQueryReportPhase::PerTraceParams);
+			return true;
+		}
+
+		if (Phase == EShooterQueryReportPhase::PerTraceParams)
+		{
+			// keep the first phase's totals and measure the prebuilt params next
+			PerTraceAllocations = Allocations;
+			PerTraceParamsBuilt = ParamsBuilt;
+			PerTraceQueries = Queries;
+
+			BeginPhase(EShooterQueryReportPhase::PrebuiltParams);
+			return true;
+		}
+
+		int32 NumFighting = 0;
+
+		for (const TWeakObjectPtr<APawn>& Pawn : SpawnedPawns)
+		{
+			NumFighting += Pawn.IsValid() ? 1 : 0;
+		}
+
+		UE_LOG(LogShooterCombatQueries, Log, TEXT("Combat query allocations over %d frames, %d AI pawns fighting the player. Allocations count every thread:"), Frames, NumFighting);
+		UE_LOG(LogShooterCombatQueries, Log, TEXT("  per trace params: %.1f allocations/frame, %.1f params built/frame, %.1f queries/frame"),
+			static_cast<double>(PerTraceAllocations) / Frames, static_cast<double>(PerTraceParamsBuilt) / Frames, static_cast<double>(PerTraceQueries) / Frames);
+		UE_LOG(LogShooterCombatQueries, Log, TEXT("  prebuilt params:  %.1f allocations/frame, %.1f params built/frame, %.1f queries/frame"),
+			static_cast<double>(Allocations) / Frames, static_cast<double>(ParamsBuilt) / Frames, static_cast<double>(Queries) / Frames);
+
+		Finish();
+		return false;
+	}
+
+	/** Removes the firefight and restores the player and the CVar */
+	void Finish()
+	{
+		for (const TWeakObjectPtr<APawn>& Pawn : SpawnedPawns)
+		{
+			if (!Pawn.IsValid())
+			{
+				continue;
+			}
+
+			AController* Controller = Pawn->GetController();
+			Pawn->Destroy();
+
+			if (Controller)
+			{
+				Controller->Destroy();
+			}
+		}
+
+		SpawnedPawns.Reset();
+
+		if (APawn* Player = PlayerPawn.Get())
+		{
+			Player->SetCanBeDamaged(bSavedPlayerCanBeDamaged);
+		}
+
+		PlayerPawn.Reset();
+
+		BeginPhase(EShooterQueryReportPhase::Idle);
+	}
+};
+
+/** Allocation report started by the console command */
+static FShooterQueryAllocationReport GShooterQueryAllocationReport;
+
+static FAutoConsoleCommandWithWorldAndArgs GShooterQueryAllocationReportCommand(
+	TEXT("Shooter.Queries.AllocationReport"),
+	TEXT("Spawns AI pawns around the player and counts heap allocations per frame, first with query params built per trace, then with prebuilt params. Args: [Frames=120] [Pawns=100] [PawnClassPath]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (World)
+		{
+			const int32 NumFrames = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 120;
+			const int32 NumPawns = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 0) : 100;
+
+			GShooterQueryAllocationReport.Start(World, NumFrames, NumPawns, Args.Num() > 2 ? Args[2] : FString());
+		}
+	}));
+
+////////////////////////////////////////////////////////////////////
+
+void FShooterCombatQueryParams::Init(const AActor* InOwner, const FCollisionQueryParams& InSelfParams, const AActor* InExtraIgnoredActor)
+{
+	Owner = InOwner;
+	ExtraIgnoredActor = InExtraIgnoredActor;
+	SelfParams = InSelfParams;
+	CachedTargetId = 0;
+
+	if (ExtraIgnoredActor)
+	{
+		SelfParams.AddIgnoredActor(ExtraIgnoredActor);
+	}
+}
+
+FShooterQueryParamsRef FShooterCombatQueryParams::GetSelfParams() const
+{
+	FShooterQueryParamsRef Params;
+
+	// build fresh params for every trace, the way trace sites did before the templates
+	if (!GShooterPrebuiltQueryParams)
+	{
+		FCollisionQueryParams& LocalParams = Params.Local.Emplace(SelfParams.TraceTag, SelfParams.StatId, SelfParams.bTraceComplex, Owner);
+		LocalParams.AddIgnoredActor(ExtraIgnoredActor);
+		++GShooterQueryParamsBuilt;
+
+	} else {
+
+		Params.Cached = &SelfParams;
+	}
+
+	return Params;
+}
+
+FShooterQueryParamsRef FShooterCombatQueryParams::GetTargetParams(const AActor* Target)
+{
+	FShooterQueryParamsRef Params;
+
+	// build fresh params for every trace and leave the cached template alone
+	if (!GShooterPrebuiltQueryParams)
+	{
+		FCollisionQueryParams& LocalParams = Params.Local.Emplace(SelfParams.TraceTag, SelfParams.StatId, SelfParams.bTraceComplex, Owner);
+		LocalParams.AddIgnoredActor(ExtraIgnoredActor);
+		LocalParams.AddIgnoredActor(Target);
+		++GShooterQueryParamsBuilt;
+
+		return Params;
+	}
+
+	const uint32 TargetId = Target ? Target->GetUniqueID() : 0;
+
+	if (TargetId != CachedTargetId || TargetId == 0)
+	{
+		// start from the template, so only the target is added
+		TargetParams = SelfParams;
+		TargetParams.AddIgnoredActor(Target);
+		CachedTargetId = TargetId;
+		++GShooterQueryParamsBuilt;
+	}
+
+	Params.Cached = &TargetParams;
+	return Params;
+}
+
+int64 FShooterCombatQueryParams::GetNumParamsBuilt()
+{
+	return GShooterQueryParamsBuilt;
+}
+
+////////////////////////////////////////////////////////////////////
+
+FShooterCombatQueryScope::FShooterCombatQueryScope()
+{
+	if (IsInGameThread())
+	{
+		++GShooterCombatQueryCount;
+	}
+
+	INC_DWORD_STAT(STAT_ShooterCombatQueries);
+}
+
+int64 FShooterCombatQueryScope::GetNumQueries()
+{
+	return GShooterCombatQueryCount;
+}
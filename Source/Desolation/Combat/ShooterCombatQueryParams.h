@@ -0,0 +1,73 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CollisionQueryParams.h"
+#include "Misc/Optional.h"
+
+/**
+ *  Query params handed to a combat trace. Points at a prebuilt template, or holds params built just for this trace
+ *  Keep it alive for as long as the trace uses the params
+ */
+struct DESOLATION_API FShooterQueryParamsRef
+{
+	/** Prebuilt template the params come from */
+	const FCollisionQueryParams* Cached = nullptr;
+
+	/** Params built for this trace only */
+	TOptional<FCollisionQueryParams> Local;
+
+	/** Returns the params to trace with */
+	const FCollisionQueryParams& Get() const { return Local.IsSet() ? Local.GetValue() : *Cached; }
+
+	/** Lets the params be passed straight into world trace calls */
+	operator const FCollisionQueryParams&() const { return Get(); }
+};
+
+/**
+ *  Collision query params built once for a character and reused by every combat trace it runs
+ *  Saves rebuilding the ignore list for each aim, line of sight, perception, weapon and projectile trace
+ */
+struct DESOLATION_API FShooterCombatQueryParams
+{
+	/** Builds the templates for the given owner. The extra actor, if any, is ignored by every trace alongside the owner */
+	void Init(const AActor* InOwner, const FCollisionQueryParams& InSelfParams, const AActor* InExtraIgnoredActor = nullptr);
+
+	/** Returns params that ignore the owner */
+	FShooterQueryParamsRef GetSelfParams() const;
+
+	/** Returns params that ignore the owner and the given target. The template is rebuilt only when the target changes */
+	FShooterQueryParamsRef GetTargetParams(const AActor* Target);
+
+	/** Returns the collision query params built by the getters since startup */
+	static int64 GetNumParamsBuilt();
+
+protected:
+
+	/** Actor the params were built for */
+	const AActor* Owner = nullptr;
+
+	/** Actor ignored alongside the owner, such as the holder of a weapon */
+	const AActor* ExtraIgnoredActor = nullptr;
+
+	/** Params ignoring the owner */
+	FCollisionQueryParams SelfParams;
+
+	/** Params ignoring the owner and the cached target */
+	FCollisionQueryParams TargetParams;
+
+	/** Unique id of the target the target params were built for */
+	uint32 CachedTargetId = 0;
+};
+
+/**
+ *  Marks a combat trace site. Counts the queries run each frame
+ */
+struct DESOLATION_API FShooterCombatQueryScope
+{
+	FShooterCombatQueryScope();
+
+	/** Returns the combat queries run on the game thread since startup */
+	static int64 GetNumQueries();
+};
@@ -0,0 +1,290 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "Combat/ShooterDamageSubsystem.h"
+#include "Combat/ShooterRadialDamageType.h"
+#include "GameFramework/Character.h"
+#include "Kismet/GameplayStatics.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/DamageType.h"
+#include "Engine/World.h"
+#include "Components/PrimitiveComponent.h"
+
+DECLARE_CYCLE_STAT(TEXT("Shooter Damage Queue"), STAT_ShooterDamageQueue, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queued Hits"), STAT_ShooterQueuedHits, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Applied Damage Calls"), STAT_ShooterAppliedDamageCalls, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Resolved Deaths"), STAT_ShooterResolvedDeaths, STATGROUP_Game);
+DECLARE_CYCLE_STAT(TEXT("Shooter Radial Damage"), STAT_ShooterRadialDamage, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Radial Damage Occlusion Tests"), STAT_ShooterRadialOcclusionTests, STATGROUP_Game);
+
+void UShooterDamageSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	OcclusionQueryParams.Init(nullptr, FCollisionQueryParams(SCENE_QUERY_STAT(ShooterRadialDamageOcclusion), false));
+}
+
+void UShooterDamageSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterDamageQueue);
+
+	// apply all damage first, so every hit this frame counts before anyone dies
+	ApplyQueuedDamage();
+
+	// then resolve the deaths it caused
+	ResolveDeaths();
+}
+
+TStatId UShooterDamageSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterDamageSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterDamageSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterDamageSubsystem::QueueDamage(AActor* Victim, float Damage, AController* Instigator, AActor* Causer, TSubclassOf<UDamageType> DamageType)
+{
+	if (!Victim || Damage == 0.0f)
+	{
+		return;
+	}
+
+	FShooterDamageRecord& Record = Queue.AddDefaulted_GetRef();
+	Record.Victim = Victim;
+	Record.Instigator = Instigator;
+	Record.Causer = Causer;
+	Record.DamageType = DamageType ? DamageType.Get() : UDamageType::StaticClass();
+	Record.Damage = Damage;
+
+	INC_DWORD_STAT(STAT_ShooterQueuedHits);
+}
+
+void UShooterDamageSubsystem::QueueOrApplyDamage(UWorld* World, AActor* Victim, float Damage, AController* Instigator, AActor* Causer, TSubclassOf<UDamageType> DamageType)
+{
+	// clients only predict their shots. Damage is applied by the server once it confirms them
+	if (World && World->GetNetMode() == NM_Client)
+	{
+		return;
+	}
+
+	if (UShooterDamageSubsystem* DamageSubsystem = World ? World->GetSubsystem<UShooterDamageSubsystem>() : nullptr)
+	{
+		DamageSubsystem->QueueDamage(Victim, Damage, Instigator, Causer, DamageType);
+
+	} else {
+
+		UGameplayStatics::ApplyDamage(Victim, Damage, Instigator, Causer, DamageType);
+	}
+}
+
+int32 UShooterDamageSubsystem::QueueRadialDamage(const FVector& Origin, float BaseDamage, AController* Instigator, AActor* Causer, TSubclassOf<UShooterRadialDamageType> DamageType, const AActor* IgnoreActor)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterRadialDamage);
+
+	const UShooterRadialDamageType* RadialDamage = DamageType ? DamageType->GetDefaultObject<UShooterRadialDamageType>() : nullptr;
+	const UShooterHitboxRegistrySubsystem* HitboxRegistry = GetWorld()->GetSubsystem<UShooterHitboxRegistrySubsystem>();
+
+	if (!RadialDamage || !HitboxRegistry || BaseDamage == 0.0f)
+	{
+		return 0;
+	}
+
+	// only visit characters in the hash cells the blast reaches
+	HitboxRegistry->OverlapCharacters(Origin, RadialDamage->OuterRadius, RadialOverlaps);
+
+	// set up the occlusion query once for the whole explosion, ignoring the causer
+	const FShooterQueryParamsRef OcclusionParams = OcclusionQueryParams.GetTargetParams(Causer);
+
+	// static geometry is only gathered once a victim needs an occlusion test
+	bool bGatheredOcclusion = false;
+
+	int32 NumDamaged = 0;
+
+	for (const FShooterHitboxOverlap& Overlap : RadialOverlaps)
+	{
+		ACharacter* Victim = HitboxRegistry->GetCharacter(Overlap.Owner);
+
+		if (!Victim || Victim == IgnoreActor)
+		{
+			continue;
+		}
+
+		const float Damage = BaseDamage * RadialDamage->GetDamageScale(Overlap.Distance);
+
+		if (Damage <= 0.0f)
+		{
+			continue;
+		}
+
+		// shield characters behind walls. Aim at the closest point of their capsule so partial cover still counts
+		if (RadialDamage->bCheckOcclusion)
+		{
+			INC_DWORD_STAT(STAT_ShooterRadialOcclusionTests);
+
+			if (!bGatheredOcclusion)
+			{
+				GatherOcclusionPrimitives(Origin, RadialDamage->OuterRadius, OcclusionParams);
+				bGatheredOcclusion = true;
+			}
+
+			if (IsOccluded(Origin, Overlap.ClosestPoint, OcclusionParams))
+			{
+				continue;
+			}
+		}
+
+		QueueDamage(Victim, Damage, Instigator, Causer, DamageType);
+		++NumDamaged;
+	}
+
+	return NumDamaged;
+}
+
+void UShooterDamageSubsystem::GatherOcclusionPrimitives(const FVector& Origin, double Radius, const FCollisionQueryParams& QueryParams)
+{
+	FShooterCombatQueryScope QueryScope;
+
+	// one physics query for the whole explosion. Everything that can shield a victim is inside the blast radius
+	OcclusionOverlaps.Reset();
+	GetWorld()->OverlapMultiByObjectType(OcclusionOverlaps, Origin, FQuat::Identity, FCollisionObjectQueryParams(ECC_WorldStatic), FCollisionShape::MakeSphere(Radius), QueryParams);
+
+	// instanced meshes report one overlap per instance, but each component only needs to be traced once
+	OcclusionPrimitives.Reset();
+
+	for (const FOverlapResult& OverlapResult : OcclusionOverlaps)
+	{
+		if (const UPrimitiveComponent* Primitive = OverlapResult.GetComponent())
+		{
+			OcclusionPrimitives.AddUnique(Primitive);
+		}
+	}
+}
+
+bool UShooterDamageSubsystem::IsOccluded(const FVector& Origin, const FVector& Target, const FCollisionQueryParams& QueryParams) const
+{
+	FHitResult OcclusionHit;
+
+	// trace the gathered primitives directly, skipping the scene broadphase
+	for (const UPrimitiveComponent* Primitive : OcclusionPrimitives)
+	{
+		if (Primitive->LineTraceComponent(OcclusionHit, Origin, Target, QueryParams))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void UShooterDamageSubsystem::QueueOrApplyRadialDamage(UWorld* World, const FVector& Origin, float BaseDamage, AController* Instigator, AActor* Causer, TSubclassOf<UShooterRadialDamageType> DamageType, AActor* IgnoreActor)
+{
+	// clients only predict their shots. Damage is applied by the server once it confirms them
+	if (!World || World->GetNetMode() == NM_Client)
+	{
+		return;
+	}
+
+	if (UShooterDamageSubsystem* DamageSubsystem = World->GetSubsystem<UShooterDamageSubsystem>())
+	{
+		DamageSubsystem->QueueRadialDamage(Origin, BaseDamage, Instigator, Causer, DamageType, IgnoreActor);
+
+	} else if (const UShooterRadialDamageType* RadialDamage = DamageType ? DamageType->GetDefaultObject<UShooterRadialDamageType>() : nullptr) {
+
+		TArray<AActor*> IgnoreActors;
+		IgnoreActors.Add(IgnoreActor);
+
+		UGameplayStatics::ApplyRadialDamageWithFalloff(World, BaseDamage, BaseDamage * RadialDamage->MinDamageScale, Origin, RadialDamage->InnerRadius, RadialDamage->OuterRadius,
+			RadialDamage->DamageFalloff, DamageType, IgnoreActors, Causer, Instigator);
+	}
+}
+
+void UShooterDamageSubsystem::QueueDeath(AActor* Victim, FSimpleDelegate OnDeath)
+{
+	FShooterPendingDeath& Death = PendingDeaths.AddDefaulted_GetRef();
+	Death.Victim = Victim;
+	Death.OnDeath = MoveTemp(OnDeath);
+}
+
+void UShooterDamageSubsystem::QueueOrResolveDeath(UWorld* World, AActor* Victim, FSimpleDelegate OnDeath)
+{
+	if (UShooterDamageSubsystem* DamageSubsystem = World ? World->GetSubsystem<UShooterDamageSubsystem>() : nullptr)
+	{
+		DamageSubsystem->QueueDeath(Victim, MoveTemp(OnDeath));
+
+	} else {
+
+		OnDeath.ExecuteIfBound();
+	}
+}
+
+void UShooterDamageSubsystem::ApplyQueuedDamage()
+{
+	if (Queue.IsEmpty())
+	{
+		return;
+	}
+
+	// merge hits sharing a victim, instigator and damage type
+	Merged.Reset();
+	MergedLookup.Reset();
+
+	for (const FShooterDamageRecord& Record : Queue)
+	{
+		AActor* Victim = Record.Victim.Get();
+
+		// skip victims destroyed since they were hit
+		if (!Victim)
+		{
+			continue;
+		}
+
+		const TTuple<AActor*, AController*, UClass*> Key(Victim, Record.Instigator.Get(), Record.DamageType);
+
+		if (const int32* MergedIndex = MergedLookup.Find(Key))
+		{
+			// credit the latest causer with the combined damage
+			Merged[*MergedIndex].Damage += Record.Damage;
+			Merged[*MergedIndex].Causer = Record.Causer;
+
+		} else {
+
+			MergedLookup.Add(Key, Merged.Add(Record));
+		}
+	}
+
+	Queue.Reset();
+
+	// apply one damage call per merged group
+	for (const FShooterDamageRecord& Record : Merged)
+	{
+		// an earlier damage call this frame may have destroyed the victim
+		if (AActor* Victim = Record.Victim.Get())
+		{
+			UGameplayStatics::ApplyDamage(Victim, Record.Damage, Record.Instigator.Get(), Record.Causer.Get(), Record.DamageType);
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_ShooterAppliedDamageCalls, Merged.Num());
+}
+
+void UShooterDamageSubsystem::ResolveDeaths()
+{
+	// deaths may raise more deaths, so keep going until the list is drained
+	for (int32 Index = 0; Index < PendingDeaths.Num(); ++Index)
+	{
+		// copy out the delegate, since running it may grow the array
+		const FSimpleDelegate OnDeath = PendingDeaths[Index].OnDeath;
+
+		if (PendingDeaths[Index].Victim.IsValid())
+		{
+			OnDeath.ExecuteIfBound();
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_ShooterResolvedDeaths, PendingDeaths.Num());
+
+	PendingDeaths.Reset();
+}
@@ -0,0 +1,138 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Combat/ShooterHitboxRegistry.h"
+#include "Combat/ShooterCombatQueryParams.h"
+#include "Engine/OverlapResult.h"
+#include "ShooterDamageSubsystem.generated.h"
+
+class AController;
+class UDamageType;
+class UPrimitiveComponent;
+class UShooterRadialDamageType;
+
+/**
+ *  A single hit waiting to be applied
+ */
+struct FShooterDamageRecord
+{
+	/** Actor taking the damage */
+	TWeakObjectPtr<AActor> Victim;
+
+	/** Controller responsible for the damage */
+	TWeakObjectPtr<AController> Instigator;
+
+	/** Actor that caused the damage, such as a projectile or weapon */
+	TWeakObjectPtr<AActor> Causer;
+
+	/** Type of damage. Damage type classes are never unloaded during play, so a raw pointer is safe for a frame */
+	UClass* DamageType = nullptr;
+
+	/** Amount of damage */
+	float Damage = 0.0f;
+};
+
+/**
+ *  A death waiting to be resolved
+ */
+struct FShooterPendingDeath
+{
+	/** Actor that died */
+	TWeakObjectPtr<AActor> Victim;
+
+	/** Runs the victim's death handling */
+	FSimpleDelegate OnDeath;
+};
+
+/**
+ *  Collects hits during the frame and applies them once, after actors have ticked
+ *  Hits on the same victim from the same instigator and damage type are merged into a single ApplyDamage call
+ *  Deaths raised while applying damage are resolved afterwards, outside of any collision callback
+ */
+UCLASS()
+class DESOLATION_API UShooterDamageSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+	/** Hits queued this frame */
+	TArray<FShooterDamageRecord> Queue;
+
+	/** Scratch list of merged hits, in the order each merged group was first hit */
+	TArray<FShooterDamageRecord> Merged;
+
+	/** Scratch lookup from victim, instigator and damage type to merged hit index */
+	TMap<TTuple<AActor*, AController*, UClass*>, int32> MergedLookup;
+
+	/** Deaths raised while applying this frame's damage */
+	TArray<FShooterPendingDeath> PendingDeaths;
+
+	/** Scratch list of characters caught in an explosion */
+	TArray<FShooterHitboxOverlap> RadialOverlaps;
+
+	/** Query params for explosion occlusion tests. The causer is added as the target, so they're only rebuilt when it changes */
+	FShooterCombatQueryParams OcclusionQueryParams;
+
+	/** Scratch list of static geometry overlapping an explosion */
+	TArray<FOverlapResult> OcclusionOverlaps;
+
+	/** Scratch list of the distinct static primitives around an explosion. Only read while the explosion is resolved */
+	TArray<const UPrimitiveComponent*> OcclusionPrimitives;
+
+public:
+
+	/** Subsystem initialization */
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	/** Applies this frame's damage and resolves deaths */
+	virtual void Tick(float DeltaTime) override;
+
+	/** Returns the stat id for the tickable */
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/** Only queue damage in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+public:
+
+	/** Queues a hit to be applied at the end of the frame */
+	void QueueDamage(AActor* Victim, float Damage, AController* Instigator, AActor* Causer, TSubclassOf<UDamageType> DamageType);
+
+	/** Queues a hit with the world's damage subsystem, or applies it right away if the world doesn't have one */
+	static void QueueOrApplyDamage(UWorld* World, AActor* Victim, float Damage, AController* Instigator, AActor* Causer, TSubclassOf<UDamageType> DamageType);
+
+	/**
+	 *  Queues damage for every character around an explosion, scaled by the damage type's falloff
+	 *  Characters come from the hitbox registry's spatial hash. Static world geometry around the blast is gathered with one overlap query,
+	 *  and every victim's occlusion ray is tested against those primitives only
+	 *  Returns the number of characters damaged
+	 */
+	int32 QueueRadialDamage(const FVector& Origin, float BaseDamage, AController* Instigator, AActor* Causer, TSubclassOf<UShooterRadialDamageType> DamageType, const AActor* IgnoreActor = nullptr);
+
+	/** Queues radial damage with the world's damage subsystem, or applies engine radial damage right away if the world doesn't have one */
+	static void QueueOrApplyRadialDamage(UWorld* World, const FVector& Origin, float BaseDamage, AController* Instigator, AActor* Causer, TSubclassOf<UShooterRadialDamageType> DamageType, AActor* IgnoreActor = nullptr);
+
+	/** Runs the victim's death handling once all of this frame's damage has been applied */
+	void QueueDeath(AActor* Victim, FSimpleDelegate OnDeath);
+
+	/** Queues a death with the world's damage subsystem, or runs it right away if the world doesn't have one */
+	static void QueueOrResolveDeath(UWorld* World, AActor* Victim, FSimpleDelegate OnDeath);
+
+protected:
+
+	/** Merges and applies all queued hits */
+	void ApplyQueuedDamage();
+
+	/** Runs all pending death handling */
+	void ResolveDeaths();
+
+	/** Collects the static primitives within an explosion's radius for its occlusion tests */
+	void GatherOcclusionPrimitives(const FVector& Origin, double Radius, const FCollisionQueryParams& QueryParams);
+
+	/** Returns true if any gathered primitive blocks the segment from the explosion to a victim */
+	bool IsOccluded(const FVector& Origin, const FVector& Target, const FCollisionQueryParams& QueryParams) const;
+};
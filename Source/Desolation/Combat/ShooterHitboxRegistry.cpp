@@ -0,0 +1,699 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "Combat/ShooterHitboxRegistry.h"
+#include "GameFramework/Character.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/World.h"
+#include "Engine/HitResult.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Algo/BinarySearch.h"
+
+DEFINE_LOG_CATEGORY(LogShooterHitboxRegistry);
+
+DECLARE_CYCLE_STAT(TEXT("Shooter Hitbox Refresh"), STAT_ShooterHitboxRefresh, STATGROUP_Game);
+DECLARE_CYCLE_STAT(TEXT("Shooter Hitbox Raycast"), STAT_ShooterHitboxRaycast, STATGROUP_Game);
+DECLARE_CYCLE_STAT(TEXT("Shooter Hitbox Overlap"), STAT_ShooterHitboxOverlap, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hitbox Rays"), STAT_ShooterHitboxRays, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hitbox Overlaps"), STAT_ShooterHitboxOverlaps, STATGROUP_Game);
+
+static float GShooterHitboxCellSize = 1000.0f;
+static FAutoConsoleVariableRef CVarShooterHitboxCellSize(
+	TEXT("Shooter.Hitboxes.CellSize"),
+	GShooterHitboxCellSize,
+	TEXT("Size in cm of the spatial hash cells characters are bucketed into for area queries"));
+
+/** Smallest squared ray length worth testing */
+static constexpr double ShooterHitboxMinRayLengthSquared = 1.e-4;
+
+/** Relative threshold below which a ray is treated as parallel to a capsule axis */
+static constexpr double ShooterHitboxParallelThreshold = 1.e-9;
+
+/** Packs 2D spatial hash cell coordinates into a sortable key */
+static uint64 ShooterHitboxCellKey(int32 CellX, int32 CellY)
+{
+	return (static_cast<uint64>(static_cast<uint32>(CellX)) << 32) | static_cast<uint32>(CellY);
+}
+
+/** Approximates the distance along a ray where it enters a capsule, given the closest approach between them */
+static double ShooterHitboxEntryDistance(double RayParam, double RayLength, double DistSquared, double RadiusSquared)
+{
+	return FMath::Max(0.0, RayParam * RayLength - FMath::Sqrt(FMath::Max(RadiusSquared - DistSquared, 0.0)));
+}
+
+/** Tests random rays against random character capsules with the vectorized and scalar kernels and compares them */
+static void RunShooterHitboxBenchmark(const TArray<FString>& Args)
+{
+	const int32 NumRays = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 1000;
+	const int32 NumCharacters = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 256;
+	const int32 NumIterations = Args.Num() > 2 ? FMath::Max(1, FCString::Atoi(*Args[2])) : 20;
+
+	FRandomStream Random(1337);
+
+	// scatter mannequin sized capsules over a 50m square
+	FShooterHitboxCapsuleBuffers BenchCapsules;
+	TArray<FVector> Positions;
+
+	for (int32 Character = 0; Character < NumCharacters; ++Character)
+	{
+		const FVector Center(Random.FRandRange(-2500.0, 2500.0), Random.FRandRange(-2500.0, 2500.0), 96.0);
+
+		BenchCapsules.Add(Center - FVector(0.0, 0.0, 62.0), Center + FVector(0.0, 0.0, 62.0), 34.0, Character);
+		Positions.Add(Center);
+	}
+
+	BenchCapsules.Finalize();
+
+	// aim each ray roughly at a random character from the edge of the square, so about half of them connect
+	TArray<FShooterHitboxRay> Rays;
+	Rays.SetNum(NumRays);
+
+	for (FShooterHitboxRay& Ray : Rays)
+	{
+		const int32 Target = Random.RandHelper(NumCharacters);
+
+		Ray.Start = FVector(Random.FRandRange(-3000.0, 3000.0), -3000.0, 150.0);
+		Ray.End = Ray.Start + (Positions[Target] + Random.VRand() * 80.0 - Ray.Start).GetSafeNormal() * 8000.0;
+		Ray.IgnoreOwner = Random.RandHelper(NumCharacters);
+	}
+
+	TArray<FShooterHitboxRayHit> VectorHits;
+	TArray<FShooterHitboxRayHit> ScalarHits;
+	VectorHits.SetNum(NumRays);
+	ScalarHits.SetNum(NumRays);
+
+	double StartSeconds = FPlatformTime::Seconds();
+
+	for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+	{
+		BenchCapsules.Raycast(Rays, VectorHits);
+	}
+
+	const double VectorSeconds = (FPlatformTime::Seconds() - StartSeconds) / NumIterations;
+
+	StartSeconds = FPlatformTime::Seconds();
+
+	for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+	{
+		BenchCapsules.RaycastScalar(Rays, ScalarHits);
+	}
+
+	const double ScalarSeconds = (FPlatformTime::Seconds() - StartSeconds) / NumIterations;
+
+	// both kernels should agree on what each ray hit
+	int32 NumHits = 0;
+	int32 NumMismatches = 0;
+
+	for (int32 Index = 0; Index < NumRays; ++Index)
+	{
+		NumHits += VectorHits[Index].Owner != INDEX_NONE ? 1 : 0;
+
+		if (VectorHits[Index].Owner != ScalarHits[Index].Owner || FMath::Abs(VectorHits[Index].Distance - ScalarHits[Index].Distance) > 0.1)
+		{
+			++NumMismatches;
+		}
+	}
+
+	const double NumTests = double(NumRays) * NumCharacters;
+
+	UE_LOG(LogShooterHitboxRegistry, Display, TEXT("Hitbox benchmark: %d rays x %d characters. Vectorized %.3f ms (%.2f ns per test), scalar %.3f ms (%.2f ns per test), %.2fx. %d hits, %d mismatches"),
+		NumRays, NumCharacters,
+		VectorSeconds * 1000.0, VectorSeconds * 1000000000.0 / NumTests,
+		ScalarSeconds * 1000.0, ScalarSeconds * 1000000000.0 / NumTests,
+		VectorSeconds > 0.0 ? ScalarSeconds / VectorSeconds : 0.0, NumHits, NumMismatches);
+}
+
+static FAutoConsoleCommand GShooterHitboxBenchmarkCommand(
+	TEXT("Shooter.Hitboxes.Benchmark"),
+	TEXT("Compares the vectorized and scalar ray versus capsule kernels on synthetic characters. Args: [NumRays=1000] [NumCharacters=256] [Iterations=20]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunShooterHitboxBenchmark));
+
+/** Runs random sphere overlaps against a level full of characters through the spatial hash and by brute force */
+static void RunShooterHitboxOverlapBenchmark(const TArray<FString>& Args)
+{
+	const int32 NumCharacters = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 300;
+	const int32 NumQueries = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 1000;
+	const double Radius = Args.Num() > 2 ? FMath::Max(1.0f, FCString::Atof(*Args[2])) : 500.0;
+
+	FRandomStream Random(1337);
+
+	// scatter characters over a 100m square
+	FShooterHitboxCapsuleBuffers BenchCapsules;
+
+	for (int32 Character = 0; Character < NumCharacters; ++Character)
+	{
+		const FVector Center(Random.FRandRange(-5000.0, 5000.0), Random.FRandRange(-5000.0, 5000.0), 96.0);
+		BenchCapsules.Add(Center - FVector(0.0, 0.0, 62.0), Center + FVector(0.0, 0.0, 62.0), 34.0, Character);
+	}
+
+	BenchCapsules.Finalize();
+
+	double StartSeconds = FPlatformTime::Seconds();
+	BenchCapsules.BuildSpatialHash(GShooterHitboxCellSize);
+	const double BuildSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+	TArray<FVector> Centers;
+
+	for (int32 Query = 0; Query < NumQueries; ++Query)
+	{
+		Centers.Add(FVector(Random.FRandRange(-5000.0, 5000.0), Random.FRandRange(-5000.0, 5000.0), Random.FRandRange(0.0, 200.0)));
+	}
+
+	TArray<FShooterHitboxOverlap> Overlaps;
+	int32 NumHashOverlaps = 0;
+	int32 NumBruteForceOverlaps = 0;
+
+	StartSeconds = FPlatformTime::Seconds();
+
+	for (const FVector& Center : Centers)
+	{
+		BenchCapsules.OverlapSphere(Center, Radius, Overlaps);
+		NumHashOverlaps += Overlaps.Num();
+	}
+
+	const double HashSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+	StartSeconds = FPlatformTime::Seconds();
+
+	for (const FVector& Center : Centers)
+	{
+		BenchCapsules.OverlapSphereBruteForce(Center, Radius, Overlaps);
+		NumBruteForceOverlaps += Overlaps.Num();
+	}
+
+	const double BruteForceSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+	UE_LOG(LogShooterHitboxRegistry, Display, TEXT("Overlap benchmark: %d characters, %d queries of radius %.0f. Hash build %.3f us, hashed %.3f us per query, brute force %.3f us per query. %d / %d overlaps [%s]"),
+		NumCharacters, NumQueries, Radius, BuildSeconds * 1000000.0,
+		HashSeconds * 1000000.0 / NumQueries, BruteForceSeconds * 1000000.0 / NumQueries,
+		NumHashOverlaps, NumBruteForceOverlaps, NumHashOverlaps == NumBruteForceOverlaps ? TEXT("PASS") : TEXT("FAIL"));
+}
+
+static FAutoConsoleCommand GShooterHitboxOverlapBenchmarkCommand(
+	TEXT("Shooter.Hitboxes.OverlapBenchmark"),
+	TEXT("Compares spatial hash and brute force sphere overlaps against synthetic characters. Args: [NumCharacters=300] [NumQueries=1000] [Radius=500]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunShooterHitboxOverlapBenchmark));
+
+////////////////////////////////////////////////////////////////////
+
+void FShooterHitboxCapsuleBuffers::Reset()
+{
+	StartX.Reset();
+	StartY.Reset();
+	StartZ.Reset();
+
+	AxisX.Reset();
+	AxisY.Reset();
+	AxisZ.Reset();
+
+	InvAxisLengthSquared.Reset();
+	RadiusSquared.Reset();
+	Owner.Reset();
+	CellEntries.Reset();
+
+	NumCapsules = 0;
+	MaxCapsuleExtent = 0.0;
+}
+
+void FShooterHitboxCapsuleBuffers::Add(const FVector& Start, const FVector& End, double Radius, int32 InOwner)
+{
+	// drop any padding from the last finalize
+	if (StartX.Num() != NumCapsules)
+	{
+		StartX.SetNum(NumCapsules, EAllowShrinking::No);
+		StartY.SetNum(NumCapsules, EAllowShrinking::No);
+		StartZ.SetNum(NumCapsules, EAllowShrinking::No);
+
+		AxisX.SetNum(NumCapsules, EAllowShrinking::No);
+		AxisY.SetNum(NumCapsules, EAllowShrinking::No);
+		AxisZ.SetNum(NumCapsules, EAllowShrinking::No);
+
+		InvAxisLengthSquared.SetNum(NumCapsules, EAllowShrinking::No);
+		RadiusSquared.SetNum(NumCapsules, EAllowShrinking::No);
+		Owner.SetNum(NumCapsules, EAllowShrinking::No);
+	}
+
+	const FVector Axis = End - Start;
+	const double AxisLengthSquared = Axis.SizeSquared();
+
+	StartX.Add(Start.X);
+	StartY.Add(Start.Y);
+	StartZ.Add(Start.Z);
+
+	AxisX.Add(Axis.X);
+	AxisY.Add(Axis.Y);
+	AxisZ.Add(Axis.Z);
+
+	InvAxisLengthSquared.Add(AxisLengthSquared > UE_SMALL_NUMBER ? 1.0 / AxisLengthSquared : 0.0);
+	RadiusSquared.Add(Radius * Radius);
+	Owner.Add(InOwner);
+
+	++NumCapsules;
+}
+
+void FShooterHitboxCapsuleBuffers::Finalize()
+{
+	const int32 PaddedCount = Align(NumCapsules, 4);
+
+	// padding capsules have a negative squared radius, so nothing is ever close enough to hit them
+	StartX.SetNumZeroed(PaddedCount);
+	StartY.SetNumZeroed(PaddedCount);
+	StartZ.SetNumZeroed(PaddedCount);
+
+	AxisX.SetNumZeroed(PaddedCount);
+	AxisY.SetNumZeroed(PaddedCount);
+	AxisZ.SetNumZeroed(PaddedCount);
+
+	InvAxisLengthSquared.SetNumZeroed(PaddedCount);
+	RadiusSquared.SetNum(PaddedCount);
+	Owner.SetNum(PaddedCount);
+
+	for (int32 Index = NumCapsules; Index < PaddedCount; ++Index)
+	{
+		RadiusSquared[Index] = -1.0;
+		Owner[Index] = INDEX_NONE;
+	}
+}
+
+void FShooterHitboxCapsuleBuffers::Raycast(TConstArrayView<FShooterHitboxRay> Rays, TArrayView<FShooterHitboxRayHit> OutHits) const
+{
+	check(Rays.Num() == OutHits.Num());
+	checkSlow(StartX.Num() == Align(NumCapsules, 4));
+
+	const int32 PaddedCount = StartX.Num();
+
+	const VectorRegister4Double Zero = MakeVectorRegisterDouble(0.0, 0.0, 0.0, 0.0);
+	const VectorRegister4Double One = MakeVectorRegisterDouble(1.0, 1.0, 1.0, 1.0);
+
+	const double* RESTRICT Sx = StartX.GetData();
+	const double* RESTRICT Sy = StartY.GetData();
+	const double* RESTRICT Sz = StartZ.GetData();
+	const double* RESTRICT Ax = AxisX.GetData();
+	const double* RESTRICT Ay = AxisY.GetData();
+	const double* RESTRICT Az = AxisZ.GetData();
+	const double* RESTRICT InvE = InvAxisLengthSquared.GetData();
+	const double* RESTRICT RadSq = RadiusSquared.GetData();
+
+	for (int32 RayIndex = 0; RayIndex < Rays.Num(); ++RayIndex)
+	{
+		const FShooterHitboxRay& Ray = Rays[RayIndex];
+		FShooterHitboxRayHit& Hit = OutHits[RayIndex];
+
+		Hit.Owner = INDEX_NONE;
+		Hit.Distance = TNumericLimits<double>::Max();
+
+		const FVector Dir = Ray.End - Ray.Start;
+		const double RayLengthSquared = Dir.SizeSquared();
+
+		if (RayLengthSquared < ShooterHitboxMinRayLengthSquared)
+		{
+			continue;
+		}
+
+		const double RayLength = FMath::Sqrt(RayLengthSquared);
+
+		// broadcast the ray to every lane
+		const VectorRegister4Double OriginX = MakeVectorRegisterDouble(Ray.Start.X, Ray.Start.X, Ray.Start.X, Ray.Start.X);
+		const VectorRegister4Double OriginY = MakeVectorRegisterDouble(Ray.Start.Y, Ray.Start.Y, Ray.Start.Y, Ray.Start.Y);
+		const VectorRegister4Double OriginZ = MakeVectorRegisterDouble(Ray.Start.Z, Ray.Start.Z, Ray.Start.Z, Ray.Start.Z);
+		const VectorRegister4Double DirX = MakeVectorRegisterDouble(Dir.X, Dir.X, Dir.X, Dir.X);
+		const VectorRegister4Double DirY = MakeVectorRegisterDouble(Dir.Y, Dir.Y, Dir.Y, Dir.Y);
+		const VectorRegister4Double DirZ = MakeVectorRegisterDouble(Dir.Z, Dir.Z, Dir.Z, Dir.Z);
+		const VectorRegister4Double A = MakeVectorRegisterDouble(RayLengthSquared, RayLengthSquared, RayLengthSquared, RayLengthSquared);
+		const double InvRayLengthSquared = 1.0 / RayLengthSquared;
+		const VectorRegister4Double InvA = MakeVectorRegisterDouble(InvRayLengthSquared, InvRayLengthSquared, InvRayLengthSquared, InvRayLengthSquared);
+		const double ParallelScale = RayLengthSquared * ShooterHitboxParallelThreshold;
+		const VectorRegister4Double ParallelEpsilon = MakeVectorRegisterDouble(ParallelScale, ParallelScale, ParallelScale, ParallelScale);
+
+		for (int32 Index = 0; Index < PaddedCount; Index += 4)
+		{
+			// offset from the capsule start to the ray start
+			const VectorRegister4Double RX = VectorSubtract(OriginX, VectorLoad(Sx + Index));
+			const VectorRegister4Double RY = VectorSubtract(OriginY, VectorLoad(Sy + Index));
+			const VectorRegister4Double RZ = VectorSubtract(OriginZ, VectorLoad(Sz + Index));
+
+			const VectorRegister4Double EX = VectorLoad(Ax + Index);
+			const VectorRegister4Double EY = VectorLoad(Ay + Index);
+			const VectorRegister4Double EZ = VectorLoad(Az + Index);
+
+			const VectorRegister4Double E = VectorMultiplyAdd(EZ, EZ, VectorMultiplyAdd(EY, EY, VectorMultiply(EX, EX)));
+			const VectorRegister4Double B = VectorMultiplyAdd(DirZ, EZ, VectorMultiplyAdd(DirY, EY, VectorMultiply(DirX, EX)));
+			const VectorRegister4Double C = VectorMultiplyAdd(DirZ, RZ, VectorMultiplyAdd(DirY, RY, VectorMultiply(DirX, RX)));
+			const VectorRegister4Double F = VectorMultiplyAdd(EZ, RZ, VectorMultiplyAdd(EY, RY, VectorMultiply(EX, RX)));
+
+			// closest approach between the two segments. Parallel lanes start from the ray origin
+			const VectorRegister4Double Denom = VectorSubtract(VectorMultiply(A, E), VectorMultiply(B, B));
+			const VectorRegister4Double FreeT = VectorDivide(VectorSubtract(VectorMultiply(B, F), VectorMultiply(C, E)), Denom);
+			VectorRegister4Double T = VectorSelect(VectorCompareGT(Denom, VectorMultiply(ParallelEpsilon, E)), VectorMin(VectorMax(FreeT, Zero), One), Zero);
+
+			// clamp the capsule parameter, then move the ray parameter to the point closest to it
+			const VectorRegister4Double S = VectorMin(VectorMax(VectorMultiply(VectorMultiplyAdd(B, T, F), VectorLoad(InvE + Index)), Zero), One);
+			T = VectorMin(VectorMax(VectorMultiply(VectorSubtract(VectorMultiply(B, S), C), InvA), Zero), One);
+
+			const VectorRegister4Double DeltaX = VectorSubtract(VectorMultiplyAdd(DirX, T, RX), VectorMultiply(EX, S));
+			const VectorRegister4Double DeltaY = VectorSubtract(VectorMultiplyAdd(DirY, T, RY), VectorMultiply(EY, S));
+			const VectorRegister4Double DeltaZ = VectorSubtract(VectorMultiplyAdd(DirZ, T, RZ), VectorMultiply(EZ, S));
+			const VectorRegister4Double DistSquared = VectorMultiplyAdd(DeltaZ, DeltaZ, VectorMultiplyAdd(DeltaY, DeltaY, VectorMultiply(DeltaX, DeltaX)));
+
+			const int32 HitMask = VectorMaskBits(VectorCompareLE(DistSquared, VectorLoad(RadSq + Index)));
+
+			// most blocks miss, so only resolve distances for lanes that hit
+			if (HitMask == 0)
+			{
+				continue;
+			}
+
+			double LaneT[4];
+			double LaneDistSquared[4];
+			VectorStore(T, LaneT);
+			VectorStore(DistSquared, LaneDistSquared);
+
+			for (int32 Lane = 0; Lane < 4; ++Lane)
+			{
+				const int32 Capsule = Index + Lane;
+
+				if ((HitMask & (1 << Lane)) == 0 || Owner[Capsule] == Ray.IgnoreOwner)
+				{
+					continue;
+				}
+
+				const double Distance = ShooterHitboxEntryDistance(LaneT[Lane], RayLength, LaneDistSquared[Lane], RadSq[Capsule]);
+
+				if (Distance < Hit.Distance)
+				{
+					Hit.Distance = Distance;
+					Hit.Owner = Owner[Capsule];
+				}
+			}
+		}
+	}
+}
+
+void FShooterHitboxCapsuleBuffers::RaycastScalar(TConstArrayView<FShooterHitboxRay> Rays, TArrayView<FShooterHitboxRayHit> OutHits) const
+{
+	check(Rays.Num() == OutHits.Num());
+
+	for (int32 RayIndex = 0; RayIndex < Rays.Num(); ++RayIndex)
+	{
+		const FShooterHitboxRay& Ray = Rays[RayIndex];
+		FShooterHitboxRayHit& Hit = OutHits[RayIndex];
+
+		Hit.Owner = INDEX_NONE;
+		Hit.Distance = TNumericLimits<double>::Max();
+
+		const double RayLengthSquared = FVector::DistSquared(Ray.Start, Ray.End);
+
+		if (RayLengthSquared < ShooterHitboxMinRayLengthSquared)
+		{
+			continue;
+		}
+
+		const double RayLength = FMath::Sqrt(RayLengthSquared);
+
+		for (int32 Capsule = 0; Capsule < NumCapsules; ++Capsule)
+		{
+			if (Owner[Capsule] == Ray.IgnoreOwner)
+			{
+				continue;
+			}
+
+			const FVector Start(StartX[Capsule], StartY[Capsule], StartZ[Capsule]);
+			const FVector End = Start + FVector(AxisX[Capsule], AxisY[Capsule], AxisZ[Capsule]);
+
+			FVector OnRay, OnCapsule;
+			FMath::SegmentDistToSegmentSafe(Ray.Start, Ray.End, Start, End, OnRay, OnCapsule);
+
+			const double DistSquared = FVector::DistSquared(OnRay, OnCapsule);
+
+			if (DistSquared > RadiusSquared[Capsule])
+			{
+				continue;
+			}
+
+			const double Distance = ShooterHitboxEntryDistance(FVector::Dist(Ray.Start, OnRay) / RayLength, RayLength, DistSquared, RadiusSquared[Capsule]);
+
+			if (Distance < Hit.Distance)
+			{
+				Hit.Distance = Distance;
+				Hit.Owner = Owner[Capsule];
+			}
+		}
+	}
+}
+
+void FShooterHitboxCapsuleBuffers::BuildSpatialHash(double InCellSize)
+{
+	CellSize = FMath::Max(InCellSize, 1.0);
+	CellEntries.Reset();
+	MaxCapsuleExtent = 0.0;
+
+	for (int32 Capsule = 0; Capsule < NumCapsules; ++Capsule)
+	{
+		const FVector Axis(AxisX[Capsule], AxisY[Capsule], AxisZ[Capsule]);
+		const FVector Center = FVector(StartX[Capsule], StartY[Capsule], StartZ[Capsule]) + Axis * 0.5;
+
+		MaxCapsuleExtent = FMath::Max(MaxCapsuleExtent, Axis.Size() * 0.5 + FMath::Sqrt(RadiusSquared[Capsule]));
+
+		const int32 CellX = FMath::FloorToInt32(Center.X / CellSize);
+		const int32 CellY = FMath::FloorToInt32(Center.Y / CellSize);
+
+		CellEntries.Emplace(ShooterHitboxCellKey(CellX, CellY), Capsule);
+	}
+
+	// sort by cell so each cell's capsules can be found with a binary search
+	CellEntries.Sort([](const TPair<uint64, int32>& A, const TPair<uint64, int32>& B) { return A.Key < B.Key; });
+}
+
+void FShooterHitboxCapsuleBuffers::OverlapSphere(const FVector& Center, double Radius, TArray<FShooterHitboxOverlap>& OutOverlaps) const
+{
+	OutOverlaps.Reset();
+
+	if (CellEntries.Num() == 0)
+	{
+		return;
+	}
+
+	// widen the lookup so capsules centered in a neighboring cell can still reach the sphere
+	const double Reach = Radius + MaxCapsuleExtent;
+
+	const int32 MinX = FMath::FloorToInt32((Center.X - Reach) / CellSize);
+	const int32 MaxX = FMath::FloorToInt32((Center.X + Reach) / CellSize);
+	const int32 MinY = FMath::FloorToInt32((Center.Y - Reach) / CellSize);
+	const int32 MaxY = FMath::FloorToInt32((Center.Y + Reach) / CellSize);
+
+	// huge spheres touch more cells than there are capsules, so just test them all
+	if (int64(MaxX - MinX + 1) * int64(MaxY - MinY + 1) > NumCapsules)
+	{
+		OverlapSphereBruteForce(Center, Radius, OutOverlaps);
+		return;
+	}
+
+	for (int32 CellX = MinX; CellX <= MaxX; ++CellX)
+	{
+		for (int32 CellY = MinY; CellY <= MaxY; ++CellY)
+		{
+			const uint64 Key = ShooterHitboxCellKey(CellX, CellY);
+
+			for (int32 Entry = Algo::LowerBoundBy(CellEntries, Key, [](const TPair<uint64, int32>& CellEntry) { return CellEntry.Key; });
+				Entry < CellEntries.Num() && CellEntries[Entry].Key == Key; ++Entry)
+			{
+				OverlapCapsule(CellEntries[Entry].Value, Center, Radius, OutOverlaps);
+			}
+		}
+	}
+}
+
+void FShooterHitboxCapsuleBuffers::OverlapSphereBruteForce(const FVector& Center, double Radius, TArray<FShooterHitboxOverlap>& OutOverlaps) const
+{
+	OutOverlaps.Reset();
+
+	for (int32 Capsule = 0; Capsule < NumCapsules; ++Capsule)
+	{
+		OverlapCapsule(Capsule, Center, Radius, OutOverlaps);
+	}
+}
+
+void FShooterHitboxCapsuleBuffers::OverlapCapsule(int32 Capsule, const FVector& Center, double Radius, TArray<FShooterHitboxOverlap>& OutOverlaps) const
+{
+	const FVector Start(StartX[Capsule], StartY[Capsule], StartZ[Capsule]);
+	const FVector End = Start + FVector(AxisX[Capsule], AxisY[Capsule], AxisZ[Capsule]);
+
+	const FVector ClosestPoint = FMath::ClosestPointOnSegment(Center, Start, End);
+	const double Distance = FVector::Dist(Center, ClosestPoint) - FMath::Sqrt(RadiusSquared[Capsule]);
+
+	if (Distance <= Radius)
+	{
+		FShooterHitboxOverlap& Overlap = OutOverlaps.AddDefaulted_GetRef();
+		Overlap.Owner = Owner[Capsule];
+		Overlap.Distance = FMath::Max(Distance, 0.0);
+		Overlap.ClosestPoint = ClosestPoint;
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+void UShooterHitboxRegistrySubsystem::Tick(float DeltaTime)
+{
+	RefreshCapsules();
+}
+
+TStatId UShooterHitboxRegistrySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterHitboxRegistrySubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterHitboxRegistrySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterHitboxRegistrySubsystem::RegisterCharacter(ACharacter* Character)
+{
+	if (!Character || FindOwnerIndex(Character) != INDEX_NONE)
+	{
+		return;
+	}
+
+	// reuse a free slot so owner indices stay stable
+	const int32 FreeSlot = Characters.IndexOfByPredicate([](const TWeakObjectPtr<ACharacter>& Slot) { return !Slot.IsValid(); });
+
+	if (FreeSlot != INDEX_NONE)
+	{
+		Characters[FreeSlot] = Character;
+
+	} else {
+
+		Characters.Add(Character);
+	}
+
+	// make the character hittable right away instead of on the next frame
+	RefreshCapsules();
+}
+
+void UShooterHitboxRegistrySubsystem::UnregisterCharacter(ACharacter* Character)
+{
+	const int32 OwnerIndex = FindOwnerIndex(Character);
+
+	if (OwnerIndex != INDEX_NONE)
+	{
+		Characters[OwnerIndex].Reset();
+		RefreshCapsules();
+	}
+}
+
+void UShooterHitboxRegistrySubsystem::RaycastCharacters(TConstArrayView<FShooterHitboxRay> Rays, TArrayView<FShooterHitboxRayHit> OutHits) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterHitboxRaycast);
+	INC_DWORD_STAT_BY(STAT_ShooterHitboxRays, Rays.Num());
+
+	Capsules.Raycast(Rays, OutHits);
+}
+
+void UShooterHitboxRegistrySubsystem::OverlapCharacters(const FVector& Center, double Radius, TArray<FShooterHitboxOverlap>& OutOverlaps) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterHitboxOverlap);
+
+	Capsules.OverlapSphere(Center, Radius, OutOverlaps);
+
+	INC_DWORD_STAT_BY(STAT_ShooterHitboxOverlaps, OutOverlaps.Num());
+}
+
+int32 UShooterHitboxRegistrySubsystem::FindOwnerIndex(const AActor* Actor) const
+{
+	if (!Actor)
+	{
+		return INDEX_NONE;
+	}
+
+	return Characters.IndexOfByPredicate([Actor](const TWeakObjectPtr<ACharacter>& Slot) { return Slot.Get() == Actor; });
+}
+
+ACharacter* UShooterHitboxRegistrySubsystem::GetCharacter(int32 OwnerIndex) const
+{
+	return Characters.IsValidIndex(OwnerIndex) ? Characters[OwnerIndex].Get() : nullptr;
+}
+
+bool UShooterHitboxRegistrySubsystem::Trace(const FVector& Start, const FVector& End, const AActor* IgnoreActor, const FCollisionQueryParams& QueryParams, FHitResult& OutHit) const
+{
+	// test the characters first so the world trace can stop at the closest one
+	FShooterHitboxRay Ray;
+	Ray.Start = Start;
+	Ray.End = End;
+	Ray.IgnoreOwner = FindOwnerIndex(IgnoreActor);
+
+	FShooterHitboxRayHit CharacterHit;
+	RaycastCharacters(MakeArrayView(&Ray, 1), MakeArrayView(&CharacterHit, 1));
+
+	const FVector CharacterHitLocation = CharacterHit.Owner != INDEX_NONE ? Start + (End - Start).GetSafeNormal() * CharacterHit.Distance : End;
+
+	// only static and dynamic world objects go through the physics scene
+	if (GetWorld()->LineTraceSingleByObjectType(OutHit, Start, CharacterHitLocation, GetWorldObjectParams(), QueryParams))
+	{
+		return true;
+	}
+
+	return MakeCharacterHit(Start, End, CharacterHit, OutHit);
+}
+
+bool UShooterHitboxRegistrySubsystem::MakeCharacterHit(const FVector& Start, const FVector& End, const FShooterHitboxRayHit& CharacterHit, FHitResult& OutHit) const
+{
+	OutHit = FHitResult(Start, End);
+
+	ACharacter* HitCharacter = GetCharacter(CharacterHit.Owner);
+
+	if (!HitCharacter)
+	{
+		return false;
+	}
+
+	const FVector Dir = (End - Start).GetSafeNormal();
+	const FVector HitLocation = Start + Dir * CharacterHit.Distance;
+
+	// report the character hit like a blocking trace against its capsule
+	OutHit.bBlockingHit = true;
+	OutHit.Distance = CharacterHit.Distance;
+	OutHit.Time = CharacterHit.Distance / FMath::Max(FVector::Dist(Start, End), UE_SMALL_NUMBER);
+	OutHit.Location = HitLocation;
+	OutHit.ImpactPoint = HitLocation;
+	OutHit.Normal = -Dir;
+	OutHit.ImpactNormal = -Dir;
+	OutHit.HitObjectHandle = FActorInstanceHandle(HitCharacter);
+	OutHit.Component = HitCharacter->GetCapsuleComponent();
+
+	return true;
+}
+
+const FCollisionObjectQueryParams& UShooterHitboxRegistrySubsystem::GetWorldObjectParams()
+{
+	static const FCollisionObjectQueryParams ObjectParams(ECC_TO_BITFIELD(ECC_WorldStatic) | ECC_TO_BITFIELD(ECC_WorldDynamic));
+	return ObjectParams;
+}
+
+void UShooterHitboxRegistrySubsystem::RefreshCapsules()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterHitboxRefresh);
+
+	Capsules.Reset();
+
+	for (int32 OwnerIndex = 0; OwnerIndex < Characters.Num(); ++OwnerIndex)
+	{
+		const ACharacter* Character = Characters[OwnerIndex].Get();
+		const UCapsuleComponent* Capsule = Character ? Character->GetCapsuleComponent() : nullptr;
+
+		// skip characters that can't be hit, like dead NPCs
+		if (!Capsule || !Capsule->IsCollisionEnabled())
+		{
+			continue;
+		}
+
+		// collapse the collision capsule into a segment between its hemisphere centers
+		const FVector Center = Capsule->GetComponentLocation();
+		const FVector HalfAxis = Capsule->GetUpVector() * Capsule->GetScaledCapsuleHalfHeight_WithoutHemisphere();
+
+		Capsules.Add(Center - HalfAxis, Center + HalfAxis, Capsule->GetScaledCapsuleRadius(), OwnerIndex);
+	}
+
+	Capsules.Finalize();
+	Capsules.BuildSpatialHash(GShooterHitboxCellSize);
+}
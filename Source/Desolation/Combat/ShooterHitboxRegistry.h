@@ -0,0 +1,189 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterHitboxRegistry.generated.h"
+
+class ACharacter;
+struct FHitResult;
+struct FCollisionQueryParams;
+struct FCollisionObjectQueryParams;
+
+DECLARE_LOG_CATEGORY_EXTERN(LogShooterHitboxRegistry, Log, All);
+
+/**
+ *  A segment to test against the registered hitboxes
+ */
+struct FShooterHitboxRay
+{
+	/** Segment start */
+	FVector Start = FVector::ZeroVector;
+
+	/** Segment end */
+	FVector End = FVector::ZeroVector;
+
+	/** Capsule owner the ray can't hit, usually the shooter. INDEX_NONE tests every capsule */
+	int32 IgnoreOwner = INDEX_NONE;
+};
+
+/**
+ *  Result of testing a ray against the registered hitboxes
+ */
+struct FShooterHitboxRayHit
+{
+	/** Owner of the closest capsule hit, or INDEX_NONE */
+	int32 Owner = INDEX_NONE;
+
+	/** Distance along the ray to where it enters the capsule */
+	double Distance = 0.0;
+};
+
+/**
+ *  A capsule found by a sphere overlap
+ */
+struct FShooterHitboxOverlap
+{
+	/** Owner of the capsule */
+	int32 Owner = INDEX_NONE;
+
+	/** Distance from the sphere center to the capsule surface. Zero if the center is inside the capsule */
+	double Distance = 0.0;
+
+	/** Point on the capsule segment closest to the sphere center */
+	FVector ClosestPoint = FVector::ZeroVector;
+};
+
+/**
+ *  Structure-of-arrays storage for hitbox capsules
+ *  Arrays are padded to a multiple of four with capsules that can't be hit, so rays are tested against four capsules per instruction
+ */
+struct DESOLATION_API FShooterHitboxCapsuleBuffers
+{
+	/** Capsule segment starts */
+	TArray<double> StartX, StartY, StartZ;
+
+	/** Capsule segment axes, from start to end */
+	TArray<double> AxisX, AxisY, AxisZ;
+
+	/** Reciprocal of each axis' squared length, or zero for spheres */
+	TArray<double> InvAxisLengthSquared;
+
+	/** Squared capsule radius. Negative for padding */
+	TArray<double> RadiusSquared;
+
+	/** Caller defined owner of each capsule */
+	TArray<int32> Owner;
+
+	/** Number of real capsules */
+	int32 NumCapsules = 0;
+
+	/** Spatial hash of capsule centers on a 2D grid, as packed cell keys paired with capsule indices, sorted by cell */
+	TArray<TPair<uint64, int32>> CellEntries;
+
+	/** Size of a spatial hash cell */
+	double CellSize = 0.0;
+
+	/** Farthest any capsule surface reaches from its center. Widens hash lookups so capsules straddling cells aren't missed */
+	double MaxCapsuleExtent = 0.0;
+
+	/** Returns the number of real capsules */
+	int32 Num() const { return NumCapsules; }
+
+	/** Removes every capsule, keeping the memory */
+	void Reset();
+
+	/** Adds a capsule */
+	void Add(const FVector& Start, const FVector& End, double Radius, int32 InOwner);
+
+	/** Pads the arrays to a multiple of four. Call after the last capsule is added and before tracing */
+	void Finalize();
+
+	/** Tests every ray against every capsule, four capsules at a time, and writes the closest hit per ray */
+	void Raycast(TConstArrayView<FShooterHitboxRay> Rays, TArrayView<FShooterHitboxRayHit> OutHits) const;
+
+	/** Reference implementation of Raycast that tests one capsule at a time */
+	void RaycastScalar(TConstArrayView<FShooterHitboxRay> Rays, TArrayView<FShooterHitboxRayHit> OutHits) const;
+
+	/** Buckets every capsule into a spatial hash with the given cell size. Call after Finalize and before overlapping */
+	void BuildSpatialHash(double InCellSize);
+
+	/** Finds every capsule within the radius of a point, looking up only the hash cells the sphere touches */
+	void OverlapSphere(const FVector& Center, double Radius, TArray<FShooterHitboxOverlap>& OutOverlaps) const;
+
+	/** Reference implementation of OverlapSphere that tests every capsule */
+	void OverlapSphereBruteForce(const FVector& Center, double Radius, TArray<FShooterHitboxOverlap>& OutOverlaps) const;
+
+protected:
+
+	/** Tests one capsule against a sphere and adds it to the overlaps if it's within the radius */
+	void OverlapCapsule(int32 Capsule, const FVector& Center, double Radius, TArray<FShooterHitboxOverlap>& OutOverlaps) const;
+};
+
+/**
+ *  Keeps a simplified capsule per registered character, refreshed once per frame, and tests rays against them
+ *  with a vectorized kernel instead of the physics scene. Only world geometry is still traced through physics
+ *  Capsules are also bucketed into a spatial hash so area queries only visit nearby characters
+ */
+UCLASS()
+class DESOLATION_API UShooterHitboxRegistrySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+	/** Registered characters. Capsule owners index into this list */
+	TArray<TWeakObjectPtr<ACharacter>> Characters;
+
+	/** This frame's character capsules */
+	FShooterHitboxCapsuleBuffers Capsules;
+
+public:
+
+	/** Refreshes the character capsules */
+	virtual void Tick(float DeltaTime) override;
+
+	/** Returns the stat id for the tickable */
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/** Only track characters in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+public:
+
+	/** Adds the character's capsule to the registry */
+	void RegisterCharacter(ACharacter* Character);
+
+	/** Removes the character's capsule from the registry */
+	void UnregisterCharacter(ACharacter* Character);
+
+	/** Tests a batch of rays against this frame's character capsules */
+	void RaycastCharacters(TConstArrayView<FShooterHitboxRay> Rays, TArrayView<FShooterHitboxRayHit> OutHits) const;
+
+	/** Finds every character whose capsule is within the radius of a point, using the spatial hash */
+	void OverlapCharacters(const FVector& Center, double Radius, TArray<FShooterHitboxOverlap>& OutOverlaps) const;
+
+	/** Returns the capsule owner index for a character, or INDEX_NONE if it isn't registered */
+	int32 FindOwnerIndex(const AActor* Actor) const;
+
+	/** Returns the character for a capsule owner index */
+	ACharacter* GetCharacter(int32 OwnerIndex) const;
+
+	/**
+	 *  Traces a segment against characters and world geometry and returns the closest blocking hit
+	 *  Characters are tested against the registry; physics is only queried for static and dynamic world objects, using the given params
+	 */
+	bool Trace(const FVector& Start, const FVector& End, const AActor* IgnoreActor, const FCollisionQueryParams& QueryParams, FHitResult& OutHit) const;
+
+	/** Fills in a character hit from a raycast result, the way a blocking trace against the character's capsule would report it. Returns false if the ray missed or the character is gone */
+	bool MakeCharacterHit(const FVector& Start, const FVector& End, const FShooterHitboxRayHit& CharacterHit, FHitResult& OutHit) const;
+
+	/** Returns the object types physics is queried for once characters come from the registry: static and dynamic world objects */
+	static const FCollisionObjectQueryParams& GetWorldObjectParams();
+
+protected:
+
+	/** Rebuilds the capsule buffers from the registered characters */
+	void RefreshCapsules();
+};
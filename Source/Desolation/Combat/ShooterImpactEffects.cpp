@@ -0,0 +1,415 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "Combat/ShooterImpactEffects.h"
+#include "NiagaraFunctionLibrary.h"
+#include "NiagaraSystem.h"
+#include "Components/DecalComponent.h"
+#include "Materials/Material.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Engine/World.h"
+#include "Engine/HitResult.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogShooterImpactEffects, Log, All);
+DEFINE_LOG_CATEGORY(LogShooterImpactEffects);
+
+DECLARE_CYCLE_STAT(TEXT("Shooter Impact Effects"), STAT_ShooterImpactEffects, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impacts Requested"), STAT_ShooterImpactsRequested, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impacts Culled"), STAT_ShooterImpactsCulled, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impacts Spawned"), STAT_ShooterImpactsSpawned, STATGROUP_Game);
+
+static float GShooterImpactDedupRadius = 25.0f;
+static FAutoConsoleVariableRef CVarShooterImpactDedupRadius(
+	TEXT("Shooter.Impacts.DedupRadius"),
+	GShooterImpactDedupRadius,
+	TEXT("Impacts closer than this in cm to a recent impact with the same effects are merged into it"));
+
+static float GShooterImpactDedupWindow = 0.1f;
+static FAutoConsoleVariableRef CVarShooterImpactDedupWindow(
+	TEXT("Shooter.Impacts.DedupWindow"),
+	GShooterImpactDedupWindow,
+	TEXT("Time in seconds an impact keeps suppressing nearby duplicates"));
+
+static int32 GShooterImpactMaxPerFrame = 16;
+static FAutoConsoleVariableRef CVarShooterImpactMaxPerFrame(
+	TEXT("Shooter.Impacts.MaxPerFrame"),
+	GShooterImpactMaxPerFrame,
+	TEXT("Max impact effects spawned per frame. The impacts closest to a view are kept"));
+
+static float GShooterImpactCullDistance = 6000.0f;
+static FAutoConsoleVariableRef CVarShooterImpactCullDistance(
+	TEXT("Shooter.Impacts.CullDistance"),
+	GShooterImpactCullDistance,
+	TEXT("Impacts further than this in cm from every local view are skipped, unless the effect sets its own distance"));
+
+static int32 GShooterImpactMaxDecals = 64;
+static FAutoConsoleVariableRef CVarShooterImpactMaxDecals(
+	TEXT("Shooter.Impacts.MaxDecals"),
+	GShooterImpactMaxDecals,
+	TEXT("Size of the impact decal pool. The oldest decal is moved once the pool is full"));
+
+static FAutoConsoleCommandWithWorld GShooterImpactDumpCommand(
+	TEXT("Shooter.Impacts.Dump"),
+	TEXT("Logs requested, culled and spawned impact counters for the world"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (const UShooterImpactEffectsSubsystem* ImpactEffects = World ? World->GetSubsystem<UShooterImpactEffectsSubsystem>() : nullptr)
+		{
+			ImpactEffects->DumpStats();
+		}
+	}));
+
+/** Returns the object impacts are deduplicated by: the particle system, or the decal material if there's none */
+static const UObject* GetImpactEffectKey(const FShooterImpactEffectSettings& Settings)
+{
+	if (Settings.ImpactSystem)
+	{
+		return Settings.ImpactSystem.Get();
+	}
+
+	return Settings.DecalMaterial.Get();
+}
+
+/** Feeds synthetic shotgun and rifle impacts through the filter without a world and checks its guarantees */
+static void RunShooterImpactFilterTest(const TArray<FString>& Args)
+{
+	const int32 ImpactsPerFrame = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 64;
+	const int32 NumFrames = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : 120;
+
+	FShooterImpactFilter TestFilter;
+	TestFilter.DedupRadius = GShooterImpactDedupRadius;
+	TestFilter.DedupWindow = GShooterImpactDedupWindow;
+	TestFilter.MaxPerFrame = GShooterImpactMaxPerFrame;
+	TestFilter.CullDistance = GShooterImpactCullDistance;
+
+	FRandomStream Random(1337);
+	const FVector ViewLocations[] = { FVector::ZeroVector };
+
+	// the filter only compares effects, so any material works
+	FShooterImpactEffectSettings Settings;
+	Settings.DecalMaterial = UMaterial::GetDefaultMaterial(MD_DeferredDecal);
+
+	TArray<FShooterImpactRequest> Requests;
+	TArray<FShooterImpactRequest> History;
+	TArray<double> HistoryTimes;
+
+	bool bPassed = true;
+	int32 MaxAccepted = 0;
+
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		const double Now = Frame / 60.0;
+
+		// clusters of pellets spread around a random point out to twice the cull distance
+		Requests.Reset();
+
+		while (Requests.Num() < ImpactsPerFrame)
+		{
+			const FVector Center = Random.VRand() * Random.FRandRange(100.0, TestFilter.CullDistance * 2.0);
+			const int32 ClusterSize = Random.RandRange(1, 8);
+
+			for (int32 Pellet = 0; Pellet < ClusterSize && Requests.Num() < ImpactsPerFrame; ++Pellet)
+			{
+				FShooterImpactRequest& Request = Requests.AddDefaulted_GetRef();
+				Request.Location = Center + Random.VRand() * Random.FRandRange(0.0, TestFilter.DedupRadius * 2.0);
+				Request.Settings = Settings;
+			}
+		}
+
+		TestFilter.Filter(Requests, ViewLocations, Now);
+		MaxAccepted = FMath::Max(MaxAccepted, Requests.Num());
+
+		// accepted impacts must fit the budget, be close enough to be seen and never repeat a recent one
+		bPassed &= Requests.Num() <= TestFilter.MaxPerFrame;
+
+		for (const FShooterImpactRequest& Accepted : Requests)
+		{
+			bPassed &= Accepted.Location.SizeSquared() <= FMath::Square(TestFilter.CullDistance);
+
+			for (int32 Index = 0; Index < History.Num(); ++Index)
+			{
+				if (Now - HistoryTimes[Index] < TestFilter.DedupWindow && FVector::DistSquared(History[Index].Location, Accepted.Location) < FMath::Square(TestFilter.DedupRadius))
+				{
+					bPassed = false;
+				}
+			}
+		}
+
+		for (const FShooterImpactRequest& Accepted : Requests)
+		{
+			History.Add(Accepted);
+			HistoryTimes.Add(Now);
+		}
+	}
+
+	const int32 NumCulled = TestFilter.NumDeduplicated + TestFilter.NumCulledByDistance + TestFilter.NumCulledByBudget;
+
+	UE_LOG(LogShooterImpactEffects, Log, TEXT("Impact filter test: %d impacts over %d frames. Requested %d, deduplicated %d, culled by distance %d, culled by budget %d, spawned %d (max %d per frame) [%s]"),
+		ImpactsPerFrame * NumFrames, NumFrames, TestFilter.NumRequested, TestFilter.NumDeduplicated, TestFilter.NumCulledByDistance, TestFilter.NumCulledByBudget,
+		TestFilter.NumAccepted, MaxAccepted, bPassed && TestFilter.NumRequested == NumCulled + TestFilter.NumAccepted ? TEXT("PASS") : TEXT("FAIL"));
+}
+
+static FAutoConsoleCommand GShooterImpactTestCommand(
+	TEXT("Shooter.Impacts.Test"),
+	TEXT("Runs synthetic impacts through the impact filter without a world and checks the budget, distance and dedup rules. Args: [ImpactsPerFrame=64] [Frames=120]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunShooterImpactFilterTest));
+
+////////////////////////////////////////////////////////////////////
+
+void FShooterImpactFilter::Filter(TArray<FShooterImpactRequest>& InOutRequests, TConstArrayView<FVector> ViewLocations, double Now)
+{
+	// forget impacts that no longer suppress duplicates
+	RecentImpacts.RemoveAll([this, Now](const FRecentImpact& Recent) { return Now - Recent.Time >= DedupWindow; });
+
+	NumRequested += InOutRequests.Num();
+
+	const double DedupRadiusSquared = FMath::Square(DedupRadius);
+	int32 NumKept = 0;
+
+	for (int32 Index = 0; Index < InOutRequests.Num(); ++Index)
+	{
+		FShooterImpactRequest& Request = InOutRequests[Index];
+		const UObject* EffectKey = GetImpactEffectKey(Request.Settings);
+
+		// significance: skip impacts no view is close enough to see
+		Request.ViewDistanceSquared = TNumericLimits<double>::Max();
+
+		for (const FVector& ViewLocation : ViewLocations)
+		{
+			Request.ViewDistanceSquared = FMath::Min(Request.ViewDistanceSquared, FVector::DistSquared(ViewLocation, Request.Location));
+		}
+
+		const float Cull = Request.Settings.CullDistance > 0.0f ? Request.Settings.CullDistance : CullDistance;
+
+		if (Request.ViewDistanceSquared > FMath::Square(Cull))
+		{
+			++NumCulledByDistance;
+			continue;
+		}
+
+		// merge into a recent impact, or one already kept this frame
+		bool bDuplicate = IsDuplicate(Request, EffectKey);
+
+		for (int32 Kept = 0; Kept < NumKept && !bDuplicate; ++Kept)
+		{
+			const FShooterImpactRequest& Other = InOutRequests[Kept];
+			const UObject* OtherKey = GetImpactEffectKey(Other.Settings);
+
+			bDuplicate = OtherKey == EffectKey && FVector::DistSquared(Other.Location, Request.Location) < DedupRadiusSquared;
+		}
+
+		if (bDuplicate)
+		{
+			++NumDeduplicated;
+			continue;
+		}
+
+		if (NumKept != Index)
+		{
+			InOutRequests[NumKept] = MoveTemp(Request);
+		}
+
+		++NumKept;
+	}
+
+	InOutRequests.SetNum(NumKept, EAllowShrinking::No);
+
+	// keep the impacts closest to a view within the budget
+	if (InOutRequests.Num() > MaxPerFrame)
+	{
+		InOutRequests.Sort([](const FShooterImpactRequest& A, const FShooterImpactRequest& B) { return A.ViewDistanceSquared < B.ViewDistanceSquared; });
+
+		NumCulledByBudget += InOutRequests.Num() - MaxPerFrame;
+		InOutRequests.SetNum(FMath::Max(MaxPerFrame, 0), EAllowShrinking::No);
+	}
+
+	// accepted impacts suppress duplicates for the next few frames
+	for (const FShooterImpactRequest& Accepted : InOutRequests)
+	{
+		const UObject* EffectKey = GetImpactEffectKey(Accepted.Settings);
+		RecentImpacts.Add({ Accepted.Location, Now, EffectKey });
+	}
+
+	NumAccepted += InOutRequests.Num();
+}
+
+void FShooterImpactFilter::Reset()
+{
+	RecentImpacts.Reset();
+
+	NumRequested = 0;
+	NumDeduplicated = 0;
+	NumCulledByDistance = 0;
+	NumCulledByBudget = 0;
+	NumAccepted = 0;
+}
+
+bool FShooterImpactFilter::IsDuplicate(const FShooterImpactRequest& Request, const UObject* EffectKey) const
+{
+	const double DedupRadiusSquared = FMath::Square(DedupRadius);
+
+	for (const FRecentImpact& Recent : RecentImpacts)
+	{
+		if (Recent.EffectKey == EffectKey && FVector::DistSquared(Recent.Location, Request.Location) < DedupRadiusSquared)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void UShooterImpactEffectsSubsystem::Deinitialize()
+{
+	// pooled decals are owned by the world, so remove them ourselves
+	for (UDecalComponent* Decal : DecalPool)
+	{
+		if (IsValid(Decal))
+		{
+			Decal->DestroyComponent();
+		}
+	}
+
+	DecalPool.Reset();
+	PendingImpacts.Reset();
+
+	Super::Deinitialize();
+}
+
+void UShooterImpactEffectsSubsystem::Tick(float DeltaTime)
+{
+	if (PendingImpacts.Num() == 0)
+	{
+		return;
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_ShooterImpactEffects);
+
+	UWorld* World = GetWorld();
+
+	// pick up tuning changes
+	Filter.DedupRadius = GShooterImpactDedupRadius;
+	Filter.DedupWindow = GShooterImpactDedupWindow;
+	Filter.MaxPerFrame = GShooterImpactMaxPerFrame;
+	Filter.CullDistance = GShooterImpactCullDistance;
+
+	// measure significance from every local view
+	TArray<FVector, TInlineAllocator<4>> ViewLocations;
+
+	for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+
+		if (PlayerController && PlayerController->IsLocalController() && PlayerController->PlayerCameraManager)
+		{
+			ViewLocations.Add(PlayerController->PlayerCameraManager->GetCameraLocation());
+		}
+	}
+
+	const int32 NumRequested = PendingImpacts.Num();
+
+	Filter.Filter(PendingImpacts, ViewLocations, World->GetTimeSeconds());
+
+	INC_DWORD_STAT_BY(STAT_ShooterImpactsRequested, NumRequested);
+	INC_DWORD_STAT_BY(STAT_ShooterImpactsCulled, NumRequested - PendingImpacts.Num());
+	INC_DWORD_STAT_BY(STAT_ShooterImpactsSpawned, PendingImpacts.Num());
+
+	for (const FShooterImpactRequest& Impact : PendingImpacts)
+	{
+		SpawnImpact(Impact);
+	}
+
+	PendingImpacts.Reset();
+}
+
+TStatId UShooterImpactEffectsSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterImpactEffectsSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterImpactEffectsSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterImpactEffectsSubsystem::QueueImpact(const FHitResult& Hit, const FShooterImpactEffectSettings& Settings)
+{
+	FShooterImpactRequest& Request = PendingImpacts.AddDefaulted_GetRef();
+	Request.Location = Hit.ImpactPoint;
+	Request.Normal = Hit.ImpactNormal;
+	Request.Settings = Settings;
+}
+
+void UShooterImpactEffectsSubsystem::QueueImpact(const UWorld* World, const FHitResult& Hit, const FShooterImpactEffectSettings& Settings)
+{
+	// dedicated servers have nobody to show effects to
+	if (!World || !Settings.HasEffects() || World->GetNetMode() == NM_DedicatedServer)
+	{
+		return;
+	}
+
+	if (UShooterImpactEffectsSubsystem* ImpactEffects = World->GetSubsystem<UShooterImpactEffectsSubsystem>())
+	{
+		ImpactEffects->QueueImpact(Hit, Settings);
+	}
+}
+
+void UShooterImpactEffectsSubsystem::DumpStats() const
+{
+	UE_LOG(LogShooterImpactEffects, Log, TEXT("Impact effects: requested %d, deduplicated %d, culled by distance %d, culled by budget %d, spawned %d (%d systems, %d decals, %d pooled decals)"),
+		Filter.NumRequested, Filter.NumDeduplicated, Filter.NumCulledByDistance, Filter.NumCulledByBudget, Filter.NumAccepted,
+		NumSystemsSpawned, NumDecalsPlaced, DecalPool.Num());
+}
+
+void UShooterImpactEffectsSubsystem::SpawnImpact(const FShooterImpactRequest& Impact)
+{
+	const FRotator SurfaceRotation = Impact.Normal.Rotation();
+
+	// Niagara returns auto released components to its world pool once they finish
+	if (Impact.Settings.ImpactSystem)
+	{
+		UNiagaraFunctionLibrary::SpawnSystemAtLocation(this, Impact.Settings.ImpactSystem, Impact.Location, SurfaceRotation, FVector::OneVector, true, true, ENCPoolMethod::AutoRelease);
+		++NumSystemsSpawned;
+	}
+
+	if (Impact.Settings.DecalMaterial)
+	{
+		if (UDecalComponent* Decal = AcquireDecal())
+		{
+			Decal->SetDecalMaterial(Impact.Settings.DecalMaterial);
+			Decal->DecalSize = Impact.Settings.DecalSize;
+			Decal->SetWorldLocationAndRotation(Impact.Location, SurfaceRotation);
+			Decal->SetVisibility(true);
+			Decal->MarkRenderStateDirty();
+
+			++NumDecalsPlaced;
+		}
+	}
+}
+
+UDecalComponent* UShooterImpactEffectsSubsystem::AcquireDecal()
+{
+	// grow the pool until it reaches its size
+	if (DecalPool.Num() < GShooterImpactMaxDecals)
+	{
+		UDecalComponent* Decal = NewObject<UDecalComponent>(GetWorld());
+		Decal->bAllowAnyoneToDestroyMe = true;
+		Decal->RegisterComponentWithWorld(GetWorld());
+
+		DecalPool.Add(Decal);
+		return Decal;
+	}
+
+	if (DecalPool.Num() == 0)
+	{
+		return nullptr;
+	}
+
+	// move the oldest decal
+	NextDecal %= DecalPool.Num();
+	return DecalPool[NextDecal++];
+}
@@ -0,0 +1,180 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterImpactEffects.generated.h"
+
+class UNiagaraSystem;
+class UMaterialInterface;
+class UDecalComponent;
+struct FHitResult;
+
+/**
+ *  Visual effects spawned where a shot hits a surface
+ */
+USTRUCT(BlueprintType)
+struct FShooterImpactEffectSettings
+{
+	GENERATED_BODY()
+
+	/** Particle system to spawn at the impact. Taken from the Niagara component pool */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Impact")
+	TObjectPtr<UNiagaraSystem> ImpactSystem;
+
+	/** Decal material to project onto the hit surface. Taken from the world decal pool */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Impact")
+	TObjectPtr<UMaterialInterface> DecalMaterial;
+
+	/** Size of the impact decal */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Impact", meta = (EditCondition = "DecalMaterial != nullptr"))
+	FVector DecalSize = FVector(5.0f, 10.0f, 10.0f);
+
+	/** Impacts further than this from every local view are skipped. Zero uses Shooter.Impacts.CullDistance */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category="Impact", meta = (ClampMin = 0, Units = "cm"))
+	float CullDistance = 0.0f;
+
+	/** Returns true if there's anything to spawn */
+	bool HasEffects() const { return ImpactSystem != nullptr || DecalMaterial != nullptr; }
+};
+
+/**
+ *  An impact waiting to be filtered and spawned
+ */
+struct FShooterImpactRequest
+{
+	/** Impact location */
+	FVector Location = FVector::ZeroVector;
+
+	/** Surface normal at the impact */
+	FVector Normal = FVector::UpVector;
+
+	/** Effects to spawn */
+	FShooterImpactEffectSettings Settings;
+
+	/** Squared distance to the closest local view. Filled in while filtering */
+	double ViewDistanceSquared = 0.0;
+};
+
+/**
+ *  Game thread side of the impact pipeline: drops impacts that repeat a recent one nearby, that are too far from every view,
+ *  or that don't fit the per-frame budget. Has no world dependency so it can be exercised headless
+ */
+struct DESOLATION_API FShooterImpactFilter
+{
+	/** Impacts closer than this to a recent impact with the same effects are merged into it */
+	float DedupRadius = 25.0f;
+
+	/** Time in seconds an accepted impact keeps suppressing nearby duplicates */
+	float DedupWindow = 0.1f;
+
+	/** Max impacts accepted per frame. The closest to a view win */
+	int32 MaxPerFrame = 16;
+
+	/** Default significance cutoff for effects that don't set their own */
+	float CullDistance = 6000.0f;
+
+	/** Number of impacts submitted */
+	int32 NumRequested = 0;
+
+	/** Number of impacts merged into a recent one */
+	int32 NumDeduplicated = 0;
+
+	/** Number of impacts too far from every view */
+	int32 NumCulledByDistance = 0;
+
+	/** Number of impacts over the per-frame budget */
+	int32 NumCulledByBudget = 0;
+
+	/** Number of impacts accepted */
+	int32 NumAccepted = 0;
+
+	/** Filters a frame's impacts in place, keeping only the ones that should be spawned */
+	void Filter(TArray<FShooterImpactRequest>& InOutRequests, TConstArrayView<FVector> ViewLocations, double Now);
+
+	/** Clears the recent impact history and the counters */
+	void Reset();
+
+protected:
+
+	/**
+	 *  An accepted impact that still suppresses duplicates
+	 */
+	struct FRecentImpact
+	{
+		FVector Location;
+		double Time;
+		const UObject* EffectKey;
+	};
+
+	/** Impacts accepted within the dedup window */
+	TArray<FRecentImpact> RecentImpacts;
+
+	/** Returns true if an impact repeats a recent one */
+	bool IsDuplicate(const FShooterImpactRequest& Request, const UObject* EffectKey) const;
+};
+
+/**
+ *  Collects impact effects requested during the frame, filters them once per frame and spawns the survivors from pooled components.
+ *  Replaces spawning new emitter and decal components for every hit
+ */
+UCLASS()
+class DESOLATION_API UShooterImpactEffectsSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+	/** Impacts requested this frame */
+	TArray<FShooterImpactRequest> PendingImpacts;
+
+	/** Dedup, significance and budget filter */
+	FShooterImpactFilter Filter;
+
+	/** Decal components recycled oldest first */
+	UPROPERTY()
+	TArray<TObjectPtr<UDecalComponent>> DecalPool;
+
+	/** Next decal to recycle */
+	int32 NextDecal = 0;
+
+	/** Number of particle systems spawned */
+	int32 NumSystemsSpawned = 0;
+
+	/** Number of decals placed */
+	int32 NumDecalsPlaced = 0;
+
+public:
+
+	/** Subsystem cleanup */
+	virtual void Deinitialize() override;
+
+	/** Filters and spawns this frame's impacts */
+	virtual void Tick(float DeltaTime) override;
+
+	/** Returns the stat id for the tickable */
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/** Only spawn effects in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+public:
+
+	/** Queues an impact's effects to be spawned at the end of the frame */
+	void QueueImpact(const FHitResult& Hit, const FShooterImpactEffectSettings& Settings);
+
+	/** Queues an impact's effects on the world's impact subsystem, if there's anything to spawn and anyone to see it */
+	static void QueueImpact(const UWorld* World, const FHitResult& Hit, const FShooterImpactEffectSettings& Settings);
+
+	/** Logs the pipeline counters */
+	void DumpStats() const;
+
+protected:
+
+	/** Spawns the effects of an accepted impact */
+	void SpawnImpact(const FShooterImpactRequest& Impact);
+
+	/** Returns the next pooled decal component, creating it the first time round the pool */
+	UDecalComponent* AcquireDecal();
+};
@@ -0,0 +1,691 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "Combat/ShooterLagCompensation.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/PlayerState.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+
+DEFINE_LOG_CATEGORY(LogShooterLagCompensation);
+
+DECLARE_CYCLE_STAT(TEXT("Shooter Lag Compensation Record"), STAT_ShooterLagCompensationRecord, STATGROUP_Game);
+
+/** Number of characters that can be recorded at once */
+static constexpr int32 ShooterLagCompensationMaxTracks = 128;
+
+/** Size of a quantization step for capsule offsets, in cm */
+static constexpr float ShooterHitboxQuantizationStep = 0.1f;
+
+static float GShooterLagCompensationMaxRewind = 0.25f;
+static FAutoConsoleVariableRef CVarShooterLagCompensationMaxRewind(
+	TEXT("Shooter.LagCompensation.MaxRewind"),
+	GShooterLagCompensationMaxRewind,
+	TEXT("Max time in seconds a shot can be rewound to compensate for the shooter's latency"));
+
+static float GShooterLagCompensationRecordRate = 60.0f;
+static FAutoConsoleVariableRef CVarShooterLagCompensationRecordRate(
+	TEXT("Shooter.LagCompensation.RecordRate"),
+	GShooterLagCompensationRecordRate,
+	TEXT("Hitbox history frames recorded per second, independent of the server tick rate. The history is sized to cover MaxRewind at this rate"));
+
+/** Returns the number of history frames needed to cover the max rewind at the record rate */
+static int32 GetShooterLagCompensationHistoryFrames()
+{
+	// one extra frame on each end so the oldest rewindable time can still be interpolated
+	const float RecordRate = FMath::Max(GShooterLagCompensationRecordRate, 1.0f);
+	return FMath::Max(FMath::CeilToInt(GShooterLagCompensationMaxRewind * RecordRate) + 2, 2);
+}
+
+/**
+ *  Bones and radius used to build each hitbox group capsule
+ *  Matches the UE5 mannequin skeleton
+ */
+struct FShooterHitboxGroupDefinition
+{
+	const TCHAR* StartBone;
+	const TCHAR* EndBone;
+	float Radius;
+};
+
+static const FShooterHitboxGroupDefinition ShooterHitboxGroups[ShooterHitboxGroupCount] =
+{
+	{ TEXT("head"), TEXT("neck_01"), 12.0f },
+	{ TEXT("spine_05"), TEXT("pelvis"), 20.0f },
+	{ TEXT("thigh_l"), TEXT("foot_l"), 9.0f },
+	{ TEXT("thigh_r"), TEXT("foot_r"), 9.0f },
+};
+
+/** Tests a segment against a capsule and approximates the distance along the segment where it enters */
+static bool ShooterSegmentHitsCapsule(const FVector& Start, const FVector& End, const FShooterHitboxCapsule& Capsule, float Inflate, double& OutDistance)
+{
+	if (Capsule.Radius <= 0.0f)
+	{
+		return false;
+	}
+
+	FVector OnSegment, OnCapsule;
+	FMath::SegmentDistToSegmentSafe(Start, End, Capsule.Start, Capsule.End, OnSegment, OnCapsule);
+
+	const double Radius = Capsule.Radius + Inflate;
+	const double DistSquared = FVector::DistSquared(OnSegment, OnCapsule);
+
+	if (DistSquared > Radius * Radius)
+	{
+		return false;
+	}
+
+	// back off from the closest point by the chord half-length to estimate the entry point
+	OutDistance = FMath::Max(0.0, FVector::Dist(Start, OnSegment) - FMath::Sqrt(Radius * Radius - DistSquared));
+	return true;
+}
+
+/** Records synthetic characters and measures the cost of rewound traces against them */
+static void RunShooterLagCompensationBenchmark(const TArray<FString>& Args)
+{
+	const int32 NumCharacters = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 64;
+	const float HistoryMs = Args.Num() > 1 ? FMath::Max(1.0f, FCString::Atof(*Args[1])) : 200.0f;
+	const int32 NumTraces = Args.Num() > 2 ? FMath::Max(1, FCString::Atoi(*Args[2])) : 10000;
+
+	// record the history at a typical server rate
+	const double FrameRate = 60.0;
+	const int32 NumFrames = FMath::Max(2, FMath::CeilToInt(HistoryMs * 0.001 * FrameRate) + 1);
+
+	FShooterHitboxHistory BenchHistory;
+	BenchHistory.Initialize(NumCharacters, NumFrames);
+
+	FRandomStream Random(1337);
+
+	TArray<FVector> Positions;
+	TArray<FVector> Velocities;
+
+	for (int32 Track = 0; Track < NumCharacters; ++Track)
+	{
+		BenchHistory.ActivateTrack(Track);
+		Positions.Add(FVector(Random.FRandRange(-2500.0, 2500.0), Random.FRandRange(-2500.0, 2500.0), 100.0));
+		Velocities.Add(FVector(Random.FRandRange(-600.0, 600.0), Random.FRandRange(-600.0, 600.0), 0.0));
+	}
+
+	// record characters running around a 50m square
+	for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+	{
+		const int32 Slot = BenchHistory.AddFrame(Frame / FrameRate);
+
+		for (int32 Track = 0; Track < NumCharacters; ++Track)
+		{
+			Positions[Track] += Velocities[Track] / FrameRate;
+
+			const FVector& Origin = Positions[Track];
+
+			FShooterHitboxCapsule Capsules[ShooterHitboxGroupCount];
+			Capsules[0] = { Origin + FVector(0, 0, 80), Origin + FVector(0, 0, 65), 12.0f };
+			Capsules[1] = { Origin + FVector(0, 0, 55), Origin + FVector(0, 0, 5), 20.0f };
+			Capsules[2] = { Origin + FVector(0, -12, 0), Origin + FVector(0, -12, -90), 9.0f };
+			Capsules[3] = { Origin + FVector(0, 12, 0), Origin + FVector(0, 12, -90), 9.0f };
+
+			BenchHistory.StoreSnapshot(Track, Slot, Origin, Capsules);
+		}
+	}
+
+	// fire traces across the square at random moments in the history
+	const double NewestTime = (NumFrames - 1) / FrameRate;
+	int32 NumHits = 0;
+
+	const double StartSeconds = FPlatformTime::Seconds();
+
+	for (int32 Trace = 0; Trace < NumTraces; ++Trace)
+	{
+		const FVector Start(Random.FRandRange(-3000.0, 3000.0), -3000.0, Random.FRandRange(0.0, 200.0));
+		const FVector End(Random.FRandRange(-3000.0, 3000.0), 3000.0, Random.FRandRange(0.0, 200.0));
+
+		double Distance;
+		FVector RewoundOrigin;
+
+		if (BenchHistory.Raycast(Start, End, Random.FRandRange(0.0, NewestTime), INDEX_NONE, Distance, RewoundOrigin) != INDEX_NONE)
+		{
+			++NumHits;
+		}
+	}
+
+	const double ElapsedSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+	UE_LOG(LogShooterLagCompensation, Display, TEXT("Lag compensation benchmark: %d characters, %.0f ms history (%d frames), %d rewound traces in %.3f ms. %.3f us per trace, %.1f ns per character, %d hits"),
+		NumCharacters, HistoryMs, NumFrames, NumTraces, ElapsedSeconds * 1000.0,
+		ElapsedSeconds * 1000000.0 / NumTraces, ElapsedSeconds * 1000000000.0 / (double(NumTraces) * NumCharacters), NumHits);
+}
+
+static FAutoConsoleCommand GShooterLagCompensationBenchmarkCommand(
+	TEXT("Shooter.LagCompensation.Benchmark"),
+	TEXT("Measures rewound trace cost against synthetic hitbox history. Args: [NumCharacters=64] [HistoryMs=200] [NumTraces=10000]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunShooterLagCompensationBenchmark));
+
+////////////////////////////////////////////////////////////////////
+
+void FShooterHitboxSnapshot::Store(const FVector& InOrigin, const FShooterHitboxCapsule (&InCapsules)[ShooterHitboxGroupCount])
+{
+	Origin = InOrigin;
+
+	const auto Quantize = [](double Value)
+	{
+		return static_cast<int16>(FMath::Clamp(FMath::RoundToInt(Value / ShooterHitboxQuantizationStep), MIN_int16, MAX_int16));
+	};
+
+	for (int32 Group = 0; Group < ShooterHitboxGroupCount; ++Group)
+	{
+		const FVector StartOffset = InCapsules[Group].Start - InOrigin;
+		const FVector EndOffset = InCapsules[Group].End - InOrigin;
+
+		FShooterQuantizedCapsule& Capsule = Capsules[Group];
+
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			Capsule.Start[Axis] = Quantize(StartOffset[Axis]);
+			Capsule.End[Axis] = Quantize(EndOffset[Axis]);
+		}
+
+		Capsule.Radius = static_cast<uint16>(FMath::Clamp(FMath::RoundToInt(InCapsules[Group].Radius / ShooterHitboxQuantizationStep), 0, MAX_uint16));
+	}
+}
+
+void FShooterHitboxSnapshot::Load(FShooterHitboxCapsule (&OutCapsules)[ShooterHitboxGroupCount]) const
+{
+	for (int32 Group = 0; Group < ShooterHitboxGroupCount; ++Group)
+	{
+		const FShooterQuantizedCapsule& Capsule = Capsules[Group];
+
+		OutCapsules[Group].Start = Origin + FVector(Capsule.Start[0], Capsule.Start[1], Capsule.Start[2]) * ShooterHitboxQuantizationStep;
+		OutCapsules[Group].End = Origin + FVector(Capsule.End[0], Capsule.End[1], Capsule.End[2]) * ShooterHitboxQuantizationStep;
+		OutCapsules[Group].Radius = Capsule.Radius * ShooterHitboxQuantizationStep;
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+void FShooterHitboxHistory::Initialize(int32 InMaxTracks, int32 InMaxFrames)
+{
+	MaxTracks = InMaxTracks;
+	MaxFrames = InMaxFrames;
+	NumFrames = 0;
+	NextFrame = 0;
+	FrameCounter = 0;
+
+	FrameTimes.SetNumZeroed(MaxFrames);
+	FrameNumbers.SetNumZeroed(MaxFrames);
+	TrackFirstFrame.Init(MAX_uint64, MaxTracks);
+	Snapshots.SetNumZeroed(MaxTracks * MaxFrames);
+}
+
+void FShooterHitboxHistory::SetMaxFrames(int32 InMaxFrames)
+{
+	// keep the tracks in use, but only trust frames recorded from now on
+	TArray<uint64> ActiveTracks = MoveTemp(TrackFirstFrame);
+
+	Initialize(MaxTracks, InMaxFrames);
+
+	for (int32 Track = 0; Track < MaxTracks; ++Track)
+	{
+		if (ActiveTracks[Track] != MAX_uint64)
+		{
+			ActivateTrack(Track);
+		}
+	}
+}
+
+int32 FShooterHitboxHistory::AddFrame(double Time)
+{
+	const int32 Slot = NextFrame;
+
+	FrameTimes[Slot] = Time;
+	FrameNumbers[Slot] = ++FrameCounter;
+
+	// advance the ring
+	NextFrame = (NextFrame + 1) % MaxFrames;
+	NumFrames = FMath::Min(NumFrames + 1, MaxFrames);
+
+	return Slot;
+}
+
+void FShooterHitboxHistory::StoreSnapshot(int32 Track, int32 FrameSlot, const FVector& Origin, const FShooterHitboxCapsule (&Capsules)[ShooterHitboxGroupCount])
+{
+	Snapshots[Track * MaxFrames + FrameSlot].Store(Origin, Capsules);
+}
+
+void FShooterHitboxHistory::ActivateTrack(int32 Track)
+{
+	// frames recorded before now hold another character's data
+	TrackFirstFrame[Track] = FrameCounter + 1;
+}
+
+void FShooterHitboxHistory::DeactivateTrack(int32 Track)
+{
+	TrackFirstFrame[Track] = MAX_uint64;
+}
+
+bool FShooterHitboxHistory::GetTimeRange(double& OutOldest, double& OutNewest) const
+{
+	if (NumFrames == 0)
+	{
+		return false;
+	}
+
+	OutOldest = FrameTimes[GetSlot(0)];
+	OutNewest = FrameTimes[GetSlot(NumFrames - 1)];
+	return true;
+}
+
+bool FShooterHitboxHistory::FindFramePair(double Time, int32& OutOlderSlot, int32& OutNewerSlot, float& OutAlpha) const
+{
+	if (NumFrames == 0)
+	{
+		return false;
+	}
+
+	const int32 OldestSlot = GetSlot(0);
+	const int32 NewestSlot = GetSlot(NumFrames - 1);
+
+	// clamp to the recorded range
+	if (Time <= FrameTimes[OldestSlot])
+	{
+		OutOlderSlot = OutNewerSlot = OldestSlot;
+		OutAlpha = 0.0f;
+		return true;
+	}
+
+	if (Time >= FrameTimes[NewestSlot])
+	{
+		OutOlderSlot = OutNewerSlot = NewestSlot;
+		OutAlpha = 0.0f;
+		return true;
+	}
+
+	// binary search for the frames around the requested time
+	int32 Low = 0;
+	int32 High = NumFrames - 1;
+
+	while (High - Low > 1)
+	{
+		const int32 Mid = (Low + High) / 2;
+
+		if (FrameTimes[GetSlot(Mid)] <= Time)
+		{
+			Low = Mid;
+
+		} else {
+
+			High = Mid;
+		}
+	}
+
+	OutOlderSlot = GetSlot(Low);
+	OutNewerSlot = GetSlot(High);
+
+	const double FrameSpan = FrameTimes[OutNewerSlot] - FrameTimes[OutOlderSlot];
+	OutAlpha = FrameSpan > 0.0 ? static_cast<float>((Time - FrameTimes[OutOlderSlot]) / FrameSpan) : 0.0f;
+
+	return true;
+}
+
+bool FShooterHitboxHistory::GetRewoundCapsules(int32 Track, double Time, FVector& OutOrigin, FShooterHitboxCapsule (&OutCapsules)[ShooterHitboxGroupCount]) const
+{
+	if (!IsTrackActive(Track))
+	{
+		return false;
+	}
+
+	int32 OlderSlot, NewerSlot;
+	float Alpha;
+
+	if (!FindFramePair(Time, OlderSlot, NewerSlot, Alpha))
+	{
+		return false;
+	}
+
+	const uint64 FirstFrame = TrackFirstFrame[Track];
+
+	// the track didn't exist yet at the requested time
+	if (FrameNumbers[NewerSlot] < FirstFrame)
+	{
+		return false;
+	}
+
+	// don't blend with data from before the track existed
+	if (FrameNumbers[OlderSlot] < FirstFrame)
+	{
+		OlderSlot = NewerSlot;
+		Alpha = 0.0f;
+	}
+
+	const FShooterHitboxSnapshot& Older = Snapshots[Track * MaxFrames + OlderSlot];
+	Older.Load(OutCapsules);
+	OutOrigin = Older.Origin;
+
+	if (Alpha > 0.0f)
+	{
+		const FShooterHitboxSnapshot& Newer = Snapshots[Track * MaxFrames + NewerSlot];
+
+		FShooterHitboxCapsule NewerCapsules[ShooterHitboxGroupCount];
+		Newer.Load(NewerCapsules);
+
+		for (int32 Group = 0; Group < ShooterHitboxGroupCount; ++Group)
+		{
+			OutCapsules[Group].Start = FMath::Lerp(OutCapsules[Group].Start, NewerCapsules[Group].Start, Alpha);
+			OutCapsules[Group].End = FMath::Lerp(OutCapsules[Group].End, NewerCapsules[Group].End, Alpha);
+			OutCapsules[Group].Radius = FMath::Lerp(OutCapsules[Group].Radius, NewerCapsules[Group].Radius, Alpha);
+		}
+
+		OutOrigin = FMath::Lerp(Older.Origin, Newer.Origin, Alpha);
+	}
+
+	return true;
+}
+
+bool FShooterHitboxHistory::RaycastTrack(int32 Track, const FVector& Start, const FVector& End, double Time, float Inflate, double& OutDistance, FVector& OutRewoundOrigin) const
+{
+	FShooterHitboxCapsule Capsules[ShooterHitboxGroupCount];
+
+	if (!GetRewoundCapsules(Track, Time, OutRewoundOrigin, Capsules))
+	{
+		return false;
+	}
+
+	bool bHit = false;
+	OutDistance = TNumericLimits<double>::Max();
+
+	for (const FShooterHitboxCapsule& Capsule : Capsules)
+	{
+		double Distance;
+
+		if (ShooterSegmentHitsCapsule(Start, End, Capsule, Inflate, Distance) && Distance < OutDistance)
+		{
+			OutDistance = Distance;
+			bHit = true;
+		}
+	}
+
+	return bHit;
+}
+
+int32 FShooterHitboxHistory::Raycast(const FVector& Start, const FVector& End, double Time, int32 IgnoreTrack, double& OutDistance, FVector& OutRewoundOrigin) const
+{
+	int32 HitTrack = INDEX_NONE;
+	OutDistance = TNumericLimits<double>::Max();
+
+	for (int32 Track = 0; Track < MaxTracks; ++Track)
+	{
+		if (Track == IgnoreTrack)
+		{
+			continue;
+		}
+
+		double Distance;
+		FVector RewoundOrigin;
+
+		if (RaycastTrack(Track, Start, End, Time, 0.0f, Distance, RewoundOrigin) && Distance < OutDistance)
+		{
+			OutDistance = Distance;
+			OutRewoundOrigin = RewoundOrigin;
+			HitTrack = Track;
+		}
+	}
+
+	return HitTrack;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void UShooterLagCompensationSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// allocate the whole history up front, sized to cover the max rewind
+	History.Initialize(ShooterLagCompensationMaxTracks, GetShooterLagCompensationHistoryFrames());
+	Tracks.SetNum(ShooterLagCompensationMaxTracks);
+}
+
+void UShooterLagCompensationSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterLagCompensationRecord);
+
+	// only the server validates shots
+	if (GetWorld()->GetNetMode() == NM_Client || TrackLookup.Num() == 0)
+	{
+		return;
+	}
+
+	// follow changes to the rewind window or record rate
+	const int32 HistoryFrames = GetShooterLagCompensationHistoryFrames();
+
+	if (History.GetMaxFrames() != HistoryFrames)
+	{
+		History.SetMaxFrames(HistoryFrames);
+	}
+
+	// record at a fixed interval, so the history covers the same time at any tick rate
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	if (Now < NextRecordTime)
+	{
+		return;
+	}
+
+	const double RecordInterval = 1.0 / FMath::Max(GShooterLagCompensationRecordRate, 1.0f);
+
+	// don't try to catch up after a hitch
+	NextRecordTime = FMath::Max(NextRecordTime + RecordInterval, Now);
+
+	const int32 FrameSlot = History.AddFrame(Now);
+
+	for (int32 Track = 0; Track < Tracks.Num(); ++Track)
+	{
+		if (!History.IsTrackActive(Track))
+		{
+			continue;
+		}
+
+		FVector Origin;
+		FShooterHitboxCapsule Capsules[ShooterHitboxGroupCount];
+
+		CaptureHitboxes(Tracks[Track], Origin, Capsules);
+		History.StoreSnapshot(Track, FrameSlot, Origin, Capsules);
+	}
+}
+
+TStatId UShooterLagCompensationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterLagCompensationSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterLagCompensationSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterLagCompensationSubsystem::RegisterCharacter(ACharacter* Character)
+{
+	if (!Character || TrackLookup.Contains(Character))
+	{
+		return;
+	}
+
+	// find a free track
+	int32 Track = INDEX_NONE;
+
+	for (int32 Index = 0; Index < Tracks.Num(); ++Index)
+	{
+		if (!History.IsTrackActive(Index))
+		{
+			Track = Index;
+			break;
+		}
+	}
+
+	if (Track == INDEX_NONE)
+	{
+		UE_LOG(LogShooterLagCompensation, Warning, TEXT("No free lag compensation track for %s. Raise ShooterLagCompensationMaxTracks"), *GetNameSafe(Character));
+		return;
+	}
+
+	FShooterLagCompensatedCharacter& Tracked = Tracks[Track];
+	Tracked.Character = Character;
+	Tracked.bUseBones = true;
+
+	// resolve the hitbox bones once
+	USkeletalMeshComponent* Mesh = Character->GetMesh();
+
+	for (int32 Group = 0; Group < ShooterHitboxGroupCount; ++Group)
+	{
+		Tracked.BoneIndices[Group * 2] = Mesh ? Mesh->GetBoneIndex(ShooterHitboxGroups[Group].StartBone) : INDEX_NONE;
+		Tracked.BoneIndices[Group * 2 + 1] = Mesh ? Mesh->GetBoneIndex(ShooterHitboxGroups[Group].EndBone) : INDEX_NONE;
+
+		if (Tracked.BoneIndices[Group * 2] == INDEX_NONE || Tracked.BoneIndices[Group * 2 + 1] == INDEX_NONE)
+		{
+			Tracked.bUseBones = false;
+		}
+	}
+
+	History.ActivateTrack(Track);
+	TrackLookup.Add(Character, Track);
+}
+
+void UShooterLagCompensationSubsystem::UnregisterCharacter(ACharacter* Character)
+{
+	int32 Track;
+
+	if (TrackLookup.RemoveAndCopyValue(Character, Track))
+	{
+		History.DeactivateTrack(Track);
+		Tracks[Track] = FShooterLagCompensatedCharacter();
+	}
+}
+
+double UShooterLagCompensationSubsystem::GetShooterViewTime(const APawn* Shooter) const
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	// local and AI shooters see the present
+	const APlayerState* PlayerState = Shooter ? Shooter->GetPlayerState() : nullptr;
+
+	if (!PlayerState || Shooter->IsLocallyControlled())
+	{
+		return Now;
+	}
+
+	// remote players see the world roughly one round trip behind
+	return ClampRewindTime(Now - PlayerState->GetPingInMilliseconds() * 0.001);
+}
+
+double UShooterLagCompensationSubsystem::ClampRewindTime(double ClientTime) const
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+	return FMath::Clamp(ClientTime, Now - GShooterLagCompensationMaxRewind, Now);
+}
+
+float UShooterLagCompensationSubsystem::GetMaxRewind()
+{
+	return GShooterLagCompensationMaxRewind;
+}
+
+FVector UShooterLagCompensationSubsystem::CompensateAimTarget(const APawn* Shooter, const FVector& AimStart, const FVector& AimTarget) const
+{
+	return CompensateAimTarget(Shooter, AimStart, AimTarget, GetShooterViewTime(Shooter));
+}
+
+FVector UShooterLagCompensationSubsystem::CompensateAimTarget(const APawn* Shooter, const FVector& AimStart, const FVector& AimTarget, double ViewTime) const
+{
+	// nothing to compensate when the shooter sees the present
+	if (ViewTime >= GetWorld()->GetTimeSeconds())
+	{
+		return AimTarget;
+	}
+
+	const int32* ShooterTrack = TrackLookup.Find(const_cast<ACharacter*>(Cast<ACharacter>(Shooter)));
+
+	double Distance;
+	FVector RewoundOrigin;
+
+	const int32 HitTrack = History.Raycast(AimStart, AimTarget, ViewTime, ShooterTrack ? *ShooterTrack : INDEX_NONE, Distance, RewoundOrigin);
+
+	const ACharacter* HitCharacter = GetTrackCharacter(HitTrack);
+
+	if (!HitCharacter)
+	{
+		return AimTarget;
+	}
+
+	// aim at the same spot on the target, shifted by how far it has moved since the shooter saw it
+	const FVector RewoundHitPoint = AimStart + (AimTarget - AimStart).GetSafeNormal() * Distance;
+
+	return RewoundHitPoint + (HitCharacter->GetActorLocation() - RewoundOrigin);
+}
+
+bool UShooterLagCompensationSubsystem::ConfirmHit(const ACharacter* Victim, const FVector& Start, const FVector& End, double ClientTime, float Tolerance) const
+{
+	const int32* Track = TrackLookup.Find(const_cast<ACharacter*>(Victim));
+
+	if (!Track)
+	{
+		return false;
+	}
+
+	double Distance;
+	FVector RewoundOrigin;
+
+	return History.RaycastTrack(*Track, Start, End, ClampRewindTime(ClientTime), Tolerance, Distance, RewoundOrigin);
+}
+
+ACharacter* UShooterLagCompensationSubsystem::GetTrackCharacter(int32 Track) const
+{
+	return Tracks.IsValidIndex(Track) ? Tracks[Track].Character.Get() : nullptr;
+}
+
+void UShooterLagCompensationSubsystem::CaptureHitboxes(const FShooterLagCompensatedCharacter& Tracked, FVector& OutOrigin, FShooterHitboxCapsule (&OutCapsules)[ShooterHitboxGroupCount]) const
+{
+	const ACharacter* Character = Tracked.Character.Get();
+
+	if (!Character)
+	{
+		// keep the slot harmless until the track is released
+		OutOrigin = FVector::ZeroVector;
+
+		for (FShooterHitboxCapsule& Capsule : OutCapsules)
+		{
+			Capsule = FShooterHitboxCapsule();
+		}
+
+		return;
+	}
+
+	OutOrigin = Character->GetActorLocation();
+
+	const USkeletalMeshComponent* Mesh = Character->GetMesh();
+
+	if (Tracked.bUseBones && Mesh)
+	{
+		// build each capsule between its two bones
+		for (int32 Group = 0; Group < ShooterHitboxGroupCount; ++Group)
+		{
+			OutCapsules[Group].Start = Mesh->GetBoneTransform(Tracked.BoneIndices[Group * 2]).GetLocation();
+			OutCapsules[Group].End = Mesh->GetBoneTransform(Tracked.BoneIndices[Group * 2 + 1]).GetLocation();
+			OutCapsules[Group].Radius = ShooterHitboxGroups[Group].Radius;
+		}
+
+		return;
+	}
+
+	// no usable skeleton, so record the collision capsule as the torso
+	const UCapsuleComponent* Capsule = Character->GetCapsuleComponent();
+	const FVector Up = Capsule->GetUpVector() * Capsule->GetScaledCapsuleHalfHeight_WithoutHemisphere();
+
+	for (FShooterHitboxCapsule& OutCapsule : OutCapsules)
+	{
+		OutCapsule = FShooterHitboxCapsule();
+	}
+
+	FShooterHitboxCapsule& Torso = OutCapsules[static_cast<int32>(EShooterHitboxGroup::Torso)];
+	Torso.Start = Capsule->GetComponentLocation() + Up;
+	Torso.End = Capsule->GetComponentLocation() - Up;
+	Torso.Radius = Capsule->GetScaledCapsuleRadius();
+}
@@ -0,0 +1,247 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterLagCompensation.generated.h"
+
+class ACharacter;
+class APawn;
+
+DECLARE_LOG_CATEGORY_EXTERN(LogShooterLagCompensation, Log, All);
+
+/**
+ *  Body regions recorded for every lag compensated character
+ */
+enum class EShooterHitboxGroup : uint8
+{
+	Head,
+	Torso,
+	LeftLeg,
+	RightLeg,
+
+	Count
+};
+
+/** Number of capsules recorded per character */
+static constexpr int32 ShooterHitboxGroupCount = static_cast<int32>(EShooterHitboxGroup::Count);
+
+/**
+ *  A hitbox capsule in world space
+ */
+struct FShooterHitboxCapsule
+{
+	/** Start of the capsule segment */
+	FVector Start = FVector::ZeroVector;
+
+	/** End of the capsule segment */
+	FVector End = FVector::ZeroVector;
+
+	/** Capsule radius. Zero disables the capsule */
+	float Radius = 0.0f;
+};
+
+/**
+ *  A hitbox capsule quantized relative to its snapshot origin
+ */
+struct FShooterQuantizedCapsule
+{
+	/** Segment start offset, in quantization steps */
+	int16 Start[3];
+
+	/** Segment end offset, in quantization steps */
+	int16 End[3];
+
+	/** Capsule radius, in quantization steps */
+	uint16 Radius;
+};
+
+/**
+ *  Fixed-size record of one character's hitboxes at one point in time
+ */
+struct FShooterHitboxSnapshot
+{
+	/** World location the capsules are quantized against */
+	FVector Origin;
+
+	/** One quantized capsule per hitbox group */
+	FShooterQuantizedCapsule Capsules[ShooterHitboxGroupCount];
+
+	/** Quantizes and stores the given world space capsules */
+	void Store(const FVector& InOrigin, const FShooterHitboxCapsule (&InCapsules)[ShooterHitboxGroupCount]);
+
+	/** Restores the world space capsules */
+	void Load(FShooterHitboxCapsule (&OutCapsules)[ShooterHitboxGroupCount]) const;
+};
+
+/**
+ *  Ring buffer of hitbox snapshots for a fixed number of tracked characters
+ *  All memory is allocated up front, so recording and rewinding never allocate
+ */
+struct DESOLATION_API FShooterHitboxHistory
+{
+	/** Allocates room for the given number of tracks and frames */
+	void Initialize(int32 InMaxTracks, int32 InMaxFrames);
+
+	/** Starts a new frame at the given time and returns its ring slot */
+	int32 AddFrame(double Time);
+
+	/** Stores a track's hitboxes for the given frame slot */
+	void StoreSnapshot(int32 Track, int32 FrameSlot, const FVector& Origin, const FShooterHitboxCapsule (&Capsules)[ShooterHitboxGroupCount]);
+
+	/** Marks a track as valid starting with the next recorded frame */
+	void ActivateTrack(int32 Track);
+
+	/** Marks a track as unused */
+	void DeactivateTrack(int32 Track);
+
+	/** Returns true if the track is in use */
+	bool IsTrackActive(int32 Track) const { return TrackFirstFrame[Track] != MAX_uint64; }
+
+	/** Reallocates the ring for a new number of frames. Recorded frames are dropped, active tracks stay active */
+	void SetMaxFrames(int32 InMaxFrames);
+
+	/** Returns the number of tracks */
+	int32 GetMaxTracks() const { return MaxTracks; }
+
+	/** Returns the number of frames in the ring */
+	int32 GetMaxFrames() const { return MaxFrames; }
+
+	/** Returns the time of the oldest and newest recorded frames */
+	bool GetTimeRange(double& OutOldest, double& OutNewest) const;
+
+	/** Interpolates a track's hitboxes at the given time. Returns false if the track has no data for that time */
+	bool GetRewoundCapsules(int32 Track, double Time, FVector& OutOrigin, FShooterHitboxCapsule (&OutCapsules)[ShooterHitboxGroupCount]) const;
+
+	/** Tests a segment against one track's rewound hitboxes. Returns the distance along the segment to the hit */
+	bool RaycastTrack(int32 Track, const FVector& Start, const FVector& End, double Time, float Inflate, double& OutDistance, FVector& OutRewoundOrigin) const;
+
+	/** Tests a segment against every active track's rewound hitboxes and returns the closest hit track, or INDEX_NONE */
+	int32 Raycast(const FVector& Start, const FVector& End, double Time, int32 IgnoreTrack, double& OutDistance, FVector& OutRewoundOrigin) const;
+
+protected:
+
+	/** Converts a logical frame index, oldest first, into a ring slot */
+	int32 GetSlot(int32 LogicalIndex) const { return (NextFrame - NumFrames + LogicalIndex + MaxFrames) % MaxFrames; }
+
+	/** Finds the two frames around the given time and the blend between them */
+	bool FindFramePair(double Time, int32& OutOlderSlot, int32& OutNewerSlot, float& OutAlpha) const;
+
+	/** Number of tracks */
+	int32 MaxTracks = 0;
+
+	/** Number of frames in the ring */
+	int32 MaxFrames = 0;
+
+	/** Number of frames recorded so far, up to MaxFrames */
+	int32 NumFrames = 0;
+
+	/** Slot the next frame will be written to */
+	int32 NextFrame = 0;
+
+	/** Number of frames ever recorded */
+	uint64 FrameCounter = 0;
+
+	/** Time of each frame slot */
+	TArray<double> FrameTimes;
+
+	/** Frame counter value of each frame slot */
+	TArray<uint64> FrameNumbers;
+
+	/** First frame counter value each track has valid data for */
+	TArray<uint64> TrackFirstFrame;
+
+	/** Snapshots laid out per track, then per frame slot */
+	TArray<FShooterHitboxSnapshot> Snapshots;
+};
+
+/**
+ *  A character whose hitboxes are recorded for lag compensation
+ */
+struct FShooterLagCompensatedCharacter
+{
+	/** Recorded character */
+	TWeakObjectPtr<ACharacter> Character;
+
+	/** Mesh bone index for the start and end of each hitbox group. INDEX_NONE falls back to the collision capsule */
+	int32 BoneIndices[ShooterHitboxGroupCount * 2];
+
+	/** If true, all hitbox bones were found on the mesh */
+	bool bUseBones = false;
+};
+
+/**
+ *  Records per-character hitbox history on the server and rewinds it to validate shots
+ *  against what a remote shooter saw on their screen
+ */
+UCLASS()
+class DESOLATION_API UShooterLagCompensationSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+	/** Recorded hitbox history */
+	FShooterHitboxHistory History;
+
+	/** World time the next history frame is due */
+	double NextRecordTime = 0.0;
+
+	/** Tracked characters, indexed by history track */
+	TArray<FShooterLagCompensatedCharacter> Tracks;
+
+	/** Maps characters to their track index */
+	TMap<TObjectKey<ACharacter>, int32> TrackLookup;
+
+public:
+
+	/** Subsystem initialization */
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	/** Records the tracked hitboxes whenever a history frame is due */
+	virtual void Tick(float DeltaTime) override;
+
+	/** Returns the stat id for the tickable */
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/** Only record in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+public:
+
+	/** Starts recording the character's hitboxes */
+	void RegisterCharacter(ACharacter* Character);
+
+	/** Stops recording the character's hitboxes */
+	void UnregisterCharacter(ACharacter* Character);
+
+	/** Returns the world time the shooter was seeing when they fired, based on their ping */
+	double GetShooterViewTime(const APawn* Shooter) const;
+
+	/** Clamps a client supplied timestamp to the rewindable range */
+	double ClampRewindTime(double ClientTime) const;
+
+	/** Returns the max time in seconds a shot can be rewound */
+	static float GetMaxRewind();
+
+	/**
+	 *  Retargets a remote shooter's aim so it hits where a rewound target was on their screen
+	 *  Returns the aim point shifted by how far the rewound target has moved since then, or the original target if nothing was hit
+	 */
+	FVector CompensateAimTarget(const APawn* Shooter, const FVector& AimStart, const FVector& AimTarget) const;
+
+	/** Retargets a shooter's aim as seen at an explicit, already clamped view time, such as a confirmed shot's timestamp */
+	FVector CompensateAimTarget(const APawn* Shooter, const FVector& AimStart, const FVector& AimTarget, double ViewTime) const;
+
+	/** Returns true if the segment hits the victim's hitboxes as they were at the given time */
+	bool ConfirmHit(const ACharacter* Victim, const FVector& Start, const FVector& End, double ClientTime, float Tolerance) const;
+
+	/** Returns the character recorded on a history track */
+	ACharacter* GetTrackCharacter(int32 Track) const;
+
+protected:
+
+	/** Samples the current world space hitboxes of a tracked character */
+	void CaptureHitboxes(const FShooterLagCompensatedCharacter& Tracked, FVector& OutOrigin, FShooterHitboxCapsule (&OutCapsules)[ShooterHitboxGroupCount]) const;
+};
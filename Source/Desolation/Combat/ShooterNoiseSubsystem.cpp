@@ -0,0 +1,159 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "Combat/ShooterNoiseSubsystem.h"
+#include "GameFramework/Pawn.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Shooter Noise Aggregation"), STAT_ShooterNoiseAggregation, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Raw Noise Events"), STAT_ShooterRawNoiseEvents, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Emitted Noise Events"), STAT_ShooterEmittedNoiseEvents, STATGROUP_Game);
+
+static float GShooterNoiseWindow = 0.25f;
+static FAutoConsoleVariableRef CVarShooterNoiseWindow(
+	TEXT("Shooter.Noise.Window"),
+	GShooterNoiseWindow,
+	TEXT("Time in seconds that similar noise events are merged for before being reported to AI perception. Zero disables merging"));
+
+static float GShooterNoiseCellSize = 500.0f;
+static FAutoConsoleVariableRef CVarShooterNoiseCellSize(
+	TEXT("Shooter.Noise.CellSize"),
+	GShooterNoiseCellSize,
+	TEXT("Size in cm of the spatial cells noise events are merged within"));
+
+static FAutoConsoleCommandWithWorld GShooterNoiseDumpCommand(
+	TEXT("Shooter.Noise.Dump"),
+	TEXT("Logs raw and emitted noise event counters for the world"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (const UShooterNoiseSubsystem* NoiseSubsystem = World ? World->GetSubsystem<UShooterNoiseSubsystem>() : nullptr)
+		{
+			NoiseSubsystem->DumpStats();
+		}
+	}));
+
+void UShooterNoiseSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterNoiseAggregation);
+
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	for (auto It = Buckets.CreateIterator(); It; ++It)
+	{
+		const FShooterNoiseBucket& Bucket = It.Value();
+
+		if (Bucket.WindowEnd > Now)
+		{
+			continue;
+		}
+
+		// report whatever was merged since the window opened
+		if (Bucket.NumSuppressed > 0)
+		{
+			EmitNoise(Bucket, It.Key().Tag);
+		}
+
+		It.RemoveCurrent();
+	}
+}
+
+TStatId UShooterNoiseSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterNoiseSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterNoiseSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterNoiseSubsystem::ReportNoise(AActor* NoiseMaker, float Loudness, APawn* Instigator, const FVector& Location, float MaxRange, FName Tag)
+{
+	++NumRawEvents;
+	INC_DWORD_STAT(STAT_ShooterRawNoiseEvents);
+
+	const float CellSize = FMath::Max(GShooterNoiseCellSize, 1.0f);
+
+	FShooterNoiseKey Key;
+	Key.Instigator = Instigator;
+	Key.Tag = Tag;
+	Key.Cell = FIntVector(
+		FMath::FloorToInt32(Location.X / CellSize),
+		FMath::FloorToInt32(Location.Y / CellSize),
+		FMath::FloorToInt32(Location.Z / CellSize));
+
+	// merge into an open window
+	if (FShooterNoiseBucket* Bucket = Buckets.Find(Key))
+	{
+		Bucket->Location = Location;
+		Bucket->Loudness = FMath::Max(Bucket->Loudness, Loudness);
+		Bucket->MaxRange = FMath::Max(Bucket->MaxRange, MaxRange);
+		Bucket->NoiseMaker = NoiseMaker;
+		++Bucket->NumSuppressed;
+		return;
+	}
+
+	FShooterNoiseBucket NewBucket;
+	NewBucket.WindowEnd = GetWorld()->GetTimeSeconds() + GShooterNoiseWindow;
+	NewBucket.Location = Location;
+	NewBucket.Loudness = Loudness;
+	NewBucket.MaxRange = MaxRange;
+	NewBucket.NoiseMaker = NoiseMaker;
+	NewBucket.Instigator = Instigator;
+
+	// report the first event right away so AI reacts without waiting for the window
+	EmitNoise(NewBucket, Tag);
+
+	// open a window for the events that follow
+	if (GShooterNoiseWindow > 0.0f)
+	{
+		Buckets.Add(Key, NewBucket);
+	}
+}
+
+void UShooterNoiseSubsystem::ReportOrMakeNoise(AActor* NoiseMaker, float Loudness, APawn* Instigator, const FVector& Location, float MaxRange, FName Tag)
+{
+	if (!NoiseMaker)
+	{
+		return;
+	}
+
+	if (UShooterNoiseSubsystem* NoiseSubsystem = NoiseMaker->GetWorld()->GetSubsystem<UShooterNoiseSubsystem>())
+	{
+		NoiseSubsystem->ReportNoise(NoiseMaker, Loudness, Instigator, Location, MaxRange, Tag);
+
+	} else {
+
+		NoiseMaker->MakeNoise(Loudness, Instigator, Location, MaxRange, Tag);
+	}
+}
+
+void UShooterNoiseSubsystem::DumpStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("Noise aggregation: raw %d, emitted %d (%.1f%% suppressed), open windows %d, window %.2fs, cell %.0fcm"),
+		NumRawEvents, NumEmittedEvents, NumRawEvents > 0 ? 100.0f * (NumRawEvents - NumEmittedEvents) / NumRawEvents : 0.0f,
+		Buckets.Num(), GShooterNoiseWindow, GShooterNoiseCellSize);
+}
+
+void UShooterNoiseSubsystem::EmitNoise(const FShooterNoiseBucket& Bucket, FName Tag)
+{
+	// the noise maker may be gone by the time the window closes, so fall back to the instigator
+	AActor* NoiseMaker = Bucket.NoiseMaker.Get();
+
+	if (!NoiseMaker)
+	{
+		NoiseMaker = Bucket.Instigator.Get();
+	}
+
+	if (!NoiseMaker)
+	{
+		return;
+	}
+
+	// MakeNoise forwards to the AI perception system and any pawn noise emitter
+	NoiseMaker->MakeNoise(Bucket.Loudness, Bucket.Instigator.Get(), Bucket.Location, Bucket.MaxRange, Tag);
+
+	++NumEmittedEvents;
+	INC_DWORD_STAT(STAT_ShooterEmittedNoiseEvents);
+}
@@ -0,0 +1,117 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "ShooterNoiseSubsystem.generated.h"
+
+class APawn;
+
+/**
+ *  Identifies noise events that can be merged together
+ */
+struct FShooterNoiseKey
+{
+	/** Pawn responsible for the noise */
+	TObjectKey<APawn> Instigator;
+
+	/** Noise tag */
+	FName Tag;
+
+	/** Spatial cell the noise happened in */
+	FIntVector Cell;
+
+	bool operator==(const FShooterNoiseKey& Other) const
+	{
+		return Instigator == Other.Instigator && Tag == Other.Tag && Cell == Other.Cell;
+	}
+
+	friend uint32 GetTypeHash(const FShooterNoiseKey& Key)
+	{
+		return HashCombineFast(HashCombineFast(GetTypeHash(Key.Instigator), GetTypeHash(Key.Tag)), GetTypeHash(Key.Cell));
+	}
+};
+
+/**
+ *  Noise events merged within the current window
+ */
+struct FShooterNoiseBucket
+{
+	/** World time the merge window closes */
+	double WindowEnd = 0.0;
+
+	/** Location of the latest merged event */
+	FVector Location = FVector::ZeroVector;
+
+	/** Loudest merged event */
+	float Loudness = 0.0f;
+
+	/** Largest merged range */
+	float MaxRange = 0.0f;
+
+	/** Actor that made the latest merged event */
+	TWeakObjectPtr<AActor> NoiseMaker;
+
+	/** Pawn responsible for the noise */
+	TWeakObjectPtr<APawn> Instigator;
+
+	/** Number of events merged since the last one was reported */
+	int32 NumSuppressed = 0;
+};
+
+/**
+ *  Merges gunfire and impact noise before it reaches AI perception
+ *  The first event for an instigator, tag and cell is reported right away. Further events in the same window are merged
+ *  and reported once as the window closes, using the loudest loudness and range and the latest location
+ */
+UCLASS()
+class DESOLATION_API UShooterNoiseSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+	/** Open merge windows */
+	TMap<FShooterNoiseKey, FShooterNoiseBucket> Buckets;
+
+	/** Number of noise events received */
+	int32 NumRawEvents = 0;
+
+	/** Number of noise events reported to perception */
+	int32 NumEmittedEvents = 0;
+
+public:
+
+	/** Closes expired merge windows */
+	virtual void Tick(float DeltaTime) override;
+
+	/** Returns the stat id for the tickable */
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/** Only merge noise in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+public:
+
+	/** Reports a noise event, merging it with recent similar events */
+	void ReportNoise(AActor* NoiseMaker, float Loudness, APawn* Instigator, const FVector& Location, float MaxRange, FName Tag);
+
+	/** Reports a noise event through the world's noise subsystem, or makes the noise right away if the world doesn't have one */
+	static void ReportOrMakeNoise(AActor* NoiseMaker, float Loudness, APawn* Instigator, const FVector& Location, float MaxRange, FName Tag);
+
+	/** Returns the number of noise events received */
+	int32 GetNumRawEvents() const { return NumRawEvents; }
+
+	/** Returns the number of noise events reported to perception */
+	int32 GetNumEmittedEvents() const { return NumEmittedEvents; }
+
+	/** Logs the event counters */
+	void DumpStats() const;
+
+protected:
+
+	/** Reports the bucket's merged noise to perception */
+	void EmitNoise(const FShooterNoiseBucket& Bucket, FName Tag);
+};
@@ -0,0 +1,100 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "Combat/ShooterQueryScratch.h"
+#include "Combat/ShooterCombatQueryParams.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/LowLevelMemTracker.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogShooterQueryScratch, Log, All);
+DEFINE_LOG_CATEGORY(LogShooterQueryScratch);
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Frame Arena Bytes"), STAT_ShooterFrameArenaBytes, STATGROUP_Game);
+
+static FAutoConsoleCommandWithWorld GShooterQueryDumpCommand(
+	TEXT("Shooter.Queries.Dump"),
+	TEXT("Logs the frame arena and combat query counters for the world"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (const UShooterQueryScratchSubsystem* QueryScratch = World ? World->GetSubsystem<UShooterQueryScratchSubsystem>() : nullptr)
+		{
+			QueryScratch->DumpStats();
+		}
+	}));
+
+////////////////////////////////////////////////////////////////////
+
+FShooterFrameArena::~FShooterFrameArena()
+{
+	for (const FBlock& Block : Blocks)
+	{
+		FMemory::Free(Block.Data);
+	}
+}
+
+void* FShooterFrameArena::Allocate(SIZE_T Size, SIZE_T Alignment)
+{
+	while (CurrentBlock < Blocks.Num())
+	{
+		const FBlock& Block = Blocks[CurrentBlock];
+
+		// align the address, not just the offset, so alignments above the block's own are honored
+		uint8* Aligned = Align(Block.Data + Offset, Alignment);
+		const SIZE_T NewOffset = (Aligned - Block.Data) + Size;
+
+		if (NewOffset <= Block.Size)
+		{
+			BytesUsed += NewOffset - Offset;
+			PeakBytesUsed = FMath::Max(PeakBytesUsed, BytesUsed);
+			Offset = NewOffset;
+
+			return Aligned;
+		}
+
+		// this block is full, so move on to the next one
+		++CurrentBlock;
+		Offset = 0;
+	}
+
+	// out of blocks. Grow the arena with a block big enough for this allocation
+	LLM_SCOPE_BYNAME(TEXT("Shooter/FrameArena"));
+
+	FBlock& NewBlock = Blocks.AddDefaulted_GetRef();
+	NewBlock.Size = FMath::Max(BlockSize, Size + Alignment);
+	NewBlock.Data = static_cast<uint8*>(FMemory::Malloc(NewBlock.Size, 16));
+
+	return Allocate(Size, Alignment);
+}
+
+void FShooterFrameArena::Reset()
+{
+	CurrentBlock = 0;
+	Offset = 0;
+	BytesUsed = 0;
+}
+
+////////////////////////////////////////////////////////////////////
+
+void UShooterQueryScratchSubsystem::Tick(float DeltaTime)
+{
+	SET_DWORD_STAT(STAT_ShooterFrameArenaBytes, FrameArena.GetBytesUsed());
+
+	// everything handed out this frame is done with
+	FrameArena.Reset();
+}
+
+TStatId UShooterQueryScratchSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterQueryScratchSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterQueryScratchSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterQueryScratchSubsystem::DumpStats() const
+{
+	UE_LOG(LogShooterQueryScratch, Log, TEXT("Query scratch: %lld combat queries, %lld params built, frame arena %d blocks, %llu bytes peak per frame"),
+		FShooterCombatQueryScope::GetNumQueries(), FShooterCombatQueryParams::GetNumParamsBuilt(), FrameArena.GetNumBlocks(), static_cast<uint64>(FrameArena.GetPeakBytesUsed()));
+}
@@ -0,0 +1,132 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/World.h"
+#include "ShooterQueryScratch.generated.h"
+
+/**
+ *  Linear allocator for scratch data that only needs to live until the end of the frame
+ *  Memory is handed out by bumping an offset and released all at once on reset. Blocks are kept between frames,
+ *  so once the arena has grown to a frame's worth of scratch data it stops touching the heap
+ *  Only trivially destructible types can be placed in it, since nothing is destroyed on reset
+ */
+struct DESOLATION_API FShooterFrameArena
+{
+	/** Constructor */
+	explicit FShooterFrameArena(SIZE_T InBlockSize = 64 * 1024) : BlockSize(InBlockSize) {}
+
+	/** Frees every block */
+	~FShooterFrameArena();
+
+	FShooterFrameArena(const FShooterFrameArena&) = delete;
+	FShooterFrameArena& operator=(const FShooterFrameArena&) = delete;
+
+	/** Returns uninitialized memory that stays valid until the next reset */
+	void* Allocate(SIZE_T Size, SIZE_T Alignment);
+
+	/** Returns a default constructed array that stays valid until the next reset */
+	template<typename T>
+	TArrayView<T> AllocateArray(int32 Num)
+	{
+		static_assert(std::is_trivially_destructible_v<T>, "Frame arena memory is released without running destructors");
+
+		if (Num <= 0)
+		{
+			return TArrayView<T>();
+		}
+
+		T* Data = static_cast<T*>(Allocate(sizeof(T) * Num, alignof(T)));
+
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			new (Data + Index) T();
+		}
+
+		return TArrayView<T>(Data, Num);
+	}
+
+	/** Releases everything handed out since the last reset. Keeps the blocks for the next frame */
+	void Reset();
+
+	/** Returns the bytes handed out since the last reset */
+	SIZE_T GetBytesUsed() const { return BytesUsed; }
+
+	/** Returns the most bytes handed out in a single frame */
+	SIZE_T GetPeakBytesUsed() const { return PeakBytesUsed; }
+
+	/** Returns the number of blocks the arena has allocated from the heap */
+	int32 GetNumBlocks() const { return Blocks.Num(); }
+
+protected:
+
+	/**
+	 *  A chunk of heap memory the arena carves allocations out of
+	 */
+	struct FBlock
+	{
+		uint8* Data = nullptr;
+		SIZE_T Size = 0;
+	};
+
+	/** Blocks owned by the arena, in the order they're filled */
+	TArray<FBlock> Blocks;
+
+	/** Block currently being filled */
+	int32 CurrentBlock = 0;
+
+	/** Offset of the next free byte in the current block */
+	SIZE_T Offset = 0;
+
+	/** Size of each new block. Larger allocations get a block of their own size */
+	SIZE_T BlockSize;
+
+	/** Bytes handed out since the last reset */
+	SIZE_T BytesUsed = 0;
+
+	/** Most bytes handed out in a single frame */
+	SIZE_T PeakBytesUsed = 0;
+};
+
+/**
+ *  Owns the frame arena combat traces lay out their scratch data in, and resets it once per frame
+ */
+UCLASS()
+class DESOLATION_API UShooterQueryScratchSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+	/** Scratch memory for the current frame */
+	FShooterFrameArena FrameArena;
+
+public:
+
+	/** Releases the frame's scratch memory */
+	virtual void Tick(float DeltaTime) override;
+
+	/** Returns the stat id for the tickable */
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/** Only run in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+public:
+
+	/** Returns this frame's scratch arena */
+	FShooterFrameArena& GetFrameArena() { return FrameArena; }
+
+	/** Returns a default constructed array from the world's frame arena, or an empty view if the world has no arena */
+	template<typename T>
+	static TArrayView<T> AllocateFrameArray(const UWorld* World, int32 Num)
+	{
+		UShooterQueryScratchSubsystem* Subsystem = World ? World->GetSubsystem<UShooterQueryScratchSubsystem>() : nullptr;
+		return Subsystem ? Subsystem->FrameArena.AllocateArray<T>(Num) : TArrayView<T>();
+	}
+
+	/** Logs the arena and combat query counters */
+	void DumpStats() const;
+};
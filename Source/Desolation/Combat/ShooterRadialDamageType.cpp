@@ -0,0 +1,21 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "Combat/ShooterRadialDamageType.h"
+
+float UShooterRadialDamageType::GetDamageScale(float Distance) const
+{
+	if (Distance <= InnerRadius)
+	{
+		return 1.0f;
+	}
+
+	if (Distance > OuterRadius)
+	{
+		return 0.0f;
+	}
+
+	// blend from full damage at the inner radius down to the minimum at the outer radius
+	const float Alpha = (Distance - InnerRadius) / FMath::Max(OuterRadius - InnerRadius, UE_KINDA_SMALL_NUMBER);
+	return FMath::Lerp(1.0f, MinDamageScale, FMath::Pow(Alpha, 1.0f / DamageFalloff));
+}
@@ -0,0 +1,42 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/DamageType.h"
+#include "ShooterRadialDamageType.generated.h"
+
+/**
+ *  Damage type that makes a hit explode, damaging every character around the impact with distance falloff
+ *  Characters are found through the hitbox registry's spatial hash instead of overlap queries against the physics scene
+ */
+UCLASS()
+class DESOLATION_API UShooterRadialDamageType : public UDamageType
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Characters within this distance of the explosion take full damage */
+	UPROPERTY(EditDefaultsOnly, Category="Radial Damage", meta = (ClampMin = 0, Units = "cm"))
+	float InnerRadius = 100.0f;
+
+	/** Characters beyond this distance of the explosion take no damage */
+	UPROPERTY(EditDefaultsOnly, Category="Radial Damage", meta = (ClampMin = 0, Units = "cm"))
+	float OuterRadius = 500.0f;
+
+	/** Fraction of the damage still applied at the outer radius */
+	UPROPERTY(EditDefaultsOnly, Category="Radial Damage", meta = (ClampMin = 0, ClampMax = 1))
+	float MinDamageScale = 0.1f;
+
+	/** Shape of the falloff between the inner and outer radius. 1 is linear, higher values drop off faster near the center */
+	UPROPERTY(EditDefaultsOnly, Category="Radial Damage", meta = (ClampMin = 0.1))
+	float DamageFalloff = 1.0f;
+
+	/** If true, characters behind world geometry are shielded from the explosion */
+	UPROPERTY(EditDefaultsOnly, Category="Radial Damage")
+	bool bCheckOcclusion = true;
+
+	/** Returns the fraction of damage applied at the given distance from the explosion */
+	float GetDamageScale(float Distance) const;
+};
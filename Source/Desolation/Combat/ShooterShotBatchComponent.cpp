@@ -0,0 +1,437 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "Combat/ShooterShotBatchComponent.h"
+#include "Combat/ShooterLagCompensation.h"
+#include "Character/ShooterCharacter.h"
+#include "Character/ShooterAimTraceComponent.h"
+#include "ShooterWeapon/ShooterWeapon.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/CoreNet.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Shot Batches Sent"), STAT_ShooterShotBatchesSent, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Predicted Shots Sent"), STAT_ShooterPredictedShotsSent, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Shot Events Sent"), STAT_ShooterShotEventsSent, STATGROUP_Game);
+
+/** Most shots a single batch may carry before the client is considered to be cheating */
+static constexpr int32 ShooterMaxShotsPerBatch = 64;
+
+static FAutoConsoleCommandWithWorld GShooterShotBatchDumpCommand(
+	TEXT("Shooter.Net.DumpShotBatches"),
+	TEXT("Logs predicted shot batching and confirmation counters for every player pawn in the world"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+		{
+			const APawn* Pawn = It->IsValid() ? (*It)->GetPawn() : nullptr;
+
+			if (const UShooterShotBatchComponent* ShotBatch = Pawn ? Pawn->FindComponentByClass<UShooterShotBatchComponent>() : nullptr)
+			{
+				ShotBatch->DumpStats();
+			}
+		}
+	}));
+
+/** Returns the bits the parameters of an RPC take when serialized the way the net driver sends them */
+static int64 MeasureRpcParameterBits(const UFunction* Function, const void* Params)
+{
+	FNetBitWriter Writer(1024);
+
+	for (TFieldIterator<FProperty> It(Function); It && (It->PropertyFlags & (CPF_Parm | CPF_ReturnParm)) == CPF_Parm; ++It)
+	{
+		It->NetSerializeItem(Writer, nullptr, const_cast<void*>(It->ContainerPtrToValuePtr<void>(Params)));
+	}
+
+	return Writer.GetNumBits();
+}
+
+static void DumpShotBandwidth()
+{
+	// build a representative shot event
+	FShooterShotEvent ShotEvent;
+	ShotEvent.MuzzleOrigin = FVector(12345.6, -7890.1, 234.5);
+	ShotEvent.AimDirection = FVector(0.8, 0.5, 0.1).GetSafeNormal();
+	ShotEvent.SpreadSeed = 0x1234567;
+	ShotEvent.WeaponIndex = 1;
+
+	// measure it as the parameters of the real multicast RPC
+	const UFunction* ShotEventFunction = UShooterShotBatchComponent::StaticClass()->FindFunctionByName(FName(TEXT("MulticastShotEvent")));
+
+	if (!ShotEventFunction)
+	{
+		return;
+	}
+
+	uint8* Params = static_cast<uint8*>(FMemory_Alloca(ShotEventFunction->ParmsSize));
+	ShotEventFunction->InitializeStruct(Params);
+
+	if (const FStructProperty* ShotEventProperty = CastField<FStructProperty>(ShotEventFunction->PropertyLink))
+	{
+		ShotEventProperty->CopyCompleteValue(ShotEventProperty->ContainerPtrToValuePtr<void>(Params), &ShotEvent);
+	}
+
+	const int64 EventBits = MeasureRpcParameterBits(ShotEventFunction, Params);
+
+	ShotEventFunction->DestroyStruct(Params);
+
+	// measure what a spawned projectile actor sends: its spawn info, written like the package map writes a new actor, and its replicated movement
+	bool bSuccess = false;
+
+	FNetBitWriter SpawnWriter(1024);
+	FVector_NetQuantize10 SpawnLocation = ShotEvent.MuzzleOrigin;
+	FRotator SpawnRotation = ShotEvent.AimDirection.Rotation();
+	FVector_NetQuantize10 SpawnVelocity = ShotEvent.AimDirection * 3000.0;
+	uint8 bSerializeFlag = 1;
+
+	SpawnWriter.SerializeBits(&bSerializeFlag, 1);
+	SpawnLocation.NetSerialize(SpawnWriter, nullptr, bSuccess);
+	SpawnWriter.SerializeBits(&bSerializeFlag, 1);
+	SpawnRotation.SerializeCompressedShort(SpawnWriter);
+	SpawnWriter.SerializeBits(&bSerializeFlag, 1);
+	SpawnVelocity.NetSerialize(SpawnWriter, nullptr, bSuccess);
+
+	FRepMovement Movement;
+	Movement.Location = ShotEvent.MuzzleOrigin;
+	Movement.Rotation = SpawnRotation;
+	Movement.LinearVelocity = SpawnVelocity;
+
+	FNetBitWriter MovementWriter(1024);
+	Movement.NetSerialize(MovementWriter, nullptr, bSuccess);
+
+	const int64 ActorBits = SpawnWriter.GetNumBits() + MovementWriter.GetNumBits();
+
+	UE_LOG(LogTemp, Log, TEXT("Shot event RPC parameters: %lld bits per shot. Projectile actor spawn info and replicated movement: %lld bits per shot"), EventBits, ActorBits);
+	UE_LOG(LogTemp, Log, TEXT("  Payloads only. Bunch, function and actor channel headers aren't included: capture a session with -NetTrace=1 and compare them in Network Insights"));
+
+	for (const int32 ShotsPerSecond : { 10, 50, 200 })
+	{
+		UE_LOG(LogTemp, Log, TEXT("  %3d shots/s: shot events %.2f kbps, projectile actors %.2f kbps per client (%.1fx)"),
+			ShotsPerSecond, EventBits * ShotsPerSecond / 1000.0, ActorBits * ShotsPerSecond / 1000.0, static_cast<double>(ActorBits) / FMath::Max<int64>(EventBits, 1));
+	}
+}
+
+static FAutoConsoleCommand GShooterShotBandwidthCommand(
+	TEXT("Shooter.Net.ShotBandwidth"),
+	TEXT("Measures the serialized payload of a shot event RPC against a replicated projectile actor's spawn info and movement at 10, 50 and 200 shots per second"),
+	FConsoleCommandDelegate::CreateStatic(&DumpShotBandwidth));
+
+/** Returns true if the weapon has been idle longer than a shot could be held back, so its next shot opens a new firing window */
+static bool IsNewFiringWindow(const FShooterConfirmedShots& Confirmed, const AShooterWeapon* Weapon, double ServerTime)
+{
+	return Confirmed.NumConfirmed == 0 || ServerTime - Confirmed.LastConfirmedServerTime > UShooterLagCompensationSubsystem::GetMaxRewind() + Weapon->GetRefireRate();
+}
+
+bool FShooterShotEvent::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	// muzzle origin to a tenth of a centimeter
+	bOutSuccess = SerializePackedVector<10, 24>(MuzzleOrigin, Ar);
+
+	// aim direction as a 16 bit pitch and yaw. Shots never roll
+	uint16 Pitch = 0;
+	uint16 Yaw = 0;
+
+	if (Ar.IsSaving())
+	{
+		const FRotator AimRotation = AimDirection.Rotation();
+
+		Pitch = FRotator::CompressAxisToShort(AimRotation.Pitch);
+		Yaw = FRotator::CompressAxisToShort(AimRotation.Yaw);
+	}
+
+	Ar << Pitch;
+	Ar << Yaw;
+
+	if (Ar.IsLoading())
+	{
+		AimDirection = FRotator(FRotator::DecompressAxisFromShort(Pitch), FRotator::DecompressAxisFromShort(Yaw), 0.0f).Vector();
+	}
+
+	Ar << WeaponIndex;
+
+	// projectile shots don't need a seed, so it costs a single bit for them
+	uint8 bHasSeed = SpreadSeed != 0 ? 1 : 0;
+	Ar.SerializeBits(&bHasSeed, 1);
+
+	if (bHasSeed)
+	{
+		Ar << SpreadSeed;
+
+	} else {
+
+		SpreadSeed = 0;
+	}
+
+	return true;
+}
+
+UShooterShotBatchComponent::UShooterShotBatchComponent()
+{
+	// send batches after every weapon has fired this frame. We only tick while shots are pending
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	PrimaryComponentTick.TickGroup = TG_PostUpdateWork;
+
+	SetIsReplicatedByDefault(true);
+}
+
+void UShooterShotBatchComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	TimeSinceFlush += DeltaTime;
+
+	// send at most one batch per network update, no matter how fast the weapon fires
+	const float NetUpdateFrequency = GetOwner()->GetNetUpdateFrequency();
+	const float FlushInterval = NetUpdateFrequency > 0.0f ? 1.0f / NetUpdateFrequency : 0.0f;
+
+	if (TimeSinceFlush >= FlushInterval)
+	{
+		FlushShots();
+	}
+}
+
+bool UShooterShotBatchComponent::ShouldRecordShots() const
+{
+	// only remote clients predict their shots. The server fires with authority already
+	const APawn* PawnOwner = Cast<APawn>(GetOwner());
+
+	return PawnOwner && !PawnOwner->HasAuthority() && PawnOwner->IsLocallyControlled();
+}
+
+void UShooterShotBatchComponent::RecordShot(uint32 ShotIndex, const FVector& AimTarget, double ShotAge)
+{
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+
+	FShooterShotRecord& Shot = PendingBatch.Shots.AddDefaulted_GetRef();
+	// stamp the shot with its sub-frame time, so shots fired in the same frame keep their refire spacing
+	Shot.Timestamp = (GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds()) - ShotAge;
+	Shot.ShotIndex = ShotIndex;
+	Shot.AimTarget = AimTarget;
+
+	// aim from the same trace the weapon took its target from, and claim whoever it hit
+	if (const UShooterAimTraceComponent* AimTrace = GetOwner()->FindComponentByClass<UShooterAimTraceComponent>())
+	{
+		const FHitResult& AimHit = AimTrace->GetLatestResult().Hit;
+
+		Shot.AimStart = AimHit.TraceStart;
+		Shot.AimVictim = Cast<ACharacter>(AimHit.GetActor());
+
+	} else {
+
+		Shot.AimStart = GetOwner()->GetActorLocation();
+	}
+
+	// start ticking so the batch goes out with the next network update
+	SetComponentTickEnabled(true);
+}
+
+void UShooterShotBatchComponent::FlushShots()
+{
+	if (PendingBatch.Shots.Num() > 0)
+	{
+		++NumBatchesSent;
+		NumShotsSent += PendingBatch.Shots.Num();
+
+		INC_DWORD_STAT(STAT_ShooterShotBatchesSent);
+		INC_DWORD_STAT_BY(STAT_ShooterPredictedShotsSent, PendingBatch.Shots.Num());
+
+		ServerConfirmShots(PendingBatch);
+
+		PendingBatch.Shots.Reset();
+	}
+
+	// nothing left to send, so stop ticking until the next shot
+	TimeSinceFlush = 0.0f;
+	SetComponentTickEnabled(false);
+}
+
+bool UShooterShotBatchComponent::ServerConfirmShots_Validate(const FShooterShotBatch& Batch)
+{
+	// no weapon can fire this many shots in a single network update
+	return Batch.Shots.Num() <= ShooterMaxShotsPerBatch;
+}
+
+void UShooterShotBatchComponent::ServerConfirmShots_Implementation(const FShooterShotBatch& Batch)
+{
+	const AShooterCharacter* Shooter = Cast<AShooterCharacter>(GetOwner());
+	AShooterWeapon* Weapon = Shooter ? Shooter->GetCurrentWeapon() : nullptr;
+
+	if (!Weapon)
+	{
+		NumShotsRejected += Batch.Shots.Num();
+		return;
+	}
+
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	const double ServerTime = GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+
+	// a weapon can't fire more than a magazine's worth of shots in one batch
+	const int32 NumShots = FMath::Min(Batch.Shots.Num(), Weapon->GetMagazineSize());
+	NumShotsRejected += Batch.Shots.Num() - NumShots;
+
+	for (int32 ShotIndex = 0; ShotIndex < NumShots; ++ShotIndex)
+	{
+		const FShooterShotRecord& Shot = Batch.Shots[ShotIndex];
+
+		// each weapon keeps its own sequence across weapon switches
+		FShooterConfirmedShots* Confirmed = ConfirmedShots.Find(Weapon);
+
+		if (!ValidateShot(Weapon, Confirmed, Shot, ServerTime))
+		{
+			++NumShotsRejected;
+			continue;
+		}
+
+		// indices the server never confirmed still cost a round each, so skipping ahead to a tighter spread isn't free
+		const uint32 NumSkipped = Shot.ShotIndex - (Confirmed ? Confirmed->LastIndex + 1 : 0);
+
+		// fire the shot with authority, replaying the client's spread
+		Weapon->FireConfirmedShot(Shot.ShotIndex, ResolveShotTarget(Shot), NumSkipped);
+
+		if (!Confirmed)
+		{
+			Confirmed = &ConfirmedShots.Add(Weapon);
+		}
+
+		// start a new firing window if the weapon has been idle
+		if (IsNewFiringWindow(*Confirmed, Weapon, ServerTime))
+		{
+			Confirmed->FirstConfirmedServerTime = FMath::Clamp(Shot.Timestamp, ServerTime - UShooterLagCompensationSubsystem::GetMaxRewind(), ServerTime);
+			Confirmed->NumConfirmed = 0;
+		}
+
+		Confirmed->LastTime = Shot.Timestamp;
+		Confirmed->LastIndex = Shot.ShotIndex;
+		Confirmed->LastConfirmedServerTime = ServerTime;
+
+		// skipped rounds count against the refire budget too, so the shots after a skip are held back until the clock catches up
+		Confirmed->NumConfirmed += 1 + static_cast<int32>(FMath::Min<uint32>(NumSkipped, Weapon->GetMagazineSize()));
+
+		++NumShotsConfirmed;
+	}
+}
+
+bool UShooterShotBatchComponent::ValidateShot(const AShooterWeapon* Weapon, const FShooterConfirmedShots* Confirmed, const FShooterShotRecord& Shot, double ServerTime) const
+{
+	// shots can't be fired in the future
+	if (Shot.Timestamp > ServerTime + FutureTolerance)
+	{
+		return false;
+	}
+
+	// shots older than the rewind window can't be compensated, so they're not trusted either
+	const float MaxRewind = UShooterLagCompensationSubsystem::GetMaxRewind();
+
+	if (Shot.Timestamp < ServerTime - MaxRewind)
+	{
+		return false;
+	}
+
+	// the weapon's first shot has nothing to compare against
+	if (!Confirmed)
+	{
+		return true;
+	}
+
+	// shots are confirmed in order and only once. Indices may be skipped, since the server can reject a shot the client fired,
+	// but the caller charges every skipped index as a fired round
+	if (Shot.ShotIndex <= Confirmed->LastIndex)
+	{
+		return false;
+	}
+
+	// shots can't come faster than the weapon refires, counting every skipped index as a shot in between
+	const double MinRefireTime = Weapon->GetRefireRate() * (1.0f - RefireTolerance);
+	const uint32 NumRounds = Shot.ShotIndex - Confirmed->LastIndex;
+
+	if (Shot.Timestamp - Confirmed->LastTime < MinRefireTime * NumRounds)
+	{
+		return false;
+	}
+
+	// a fresh firing window starts over, so there's nothing to count against
+	if (IsNewFiringWindow(*Confirmed, Weapon, ServerTime))
+	{
+		return true;
+	}
+
+	// and the weapon can't have confirmed more shots than the server clock allows since its window opened,
+	// however the client spaced its timestamps
+	const double ElapsedTime = ServerTime - Confirmed->FirstConfirmedServerTime;
+
+	return Confirmed->NumConfirmed < FMath::FloorToInt(ElapsedTime / FMath::Max(MinRefireTime, UE_KINDA_SMALL_NUMBER)) + 1;
+}
+
+FVector UShooterShotBatchComponent::ResolveShotTarget(const FShooterShotRecord& Shot) const
+{
+	const UShooterLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UShooterLagCompensationSubsystem>();
+
+	if (!Shot.AimVictim || !LagCompensation)
+	{
+		return Shot.AimTarget;
+	}
+
+	// extend the aim segment a little past the claimed impact so it reaches into the rewound hitboxes
+	const FVector AimDirection = (Shot.AimTarget - Shot.AimStart).GetSafeNormal();
+	const FVector AimEnd = Shot.AimTarget + AimDirection * HitTolerance;
+
+	// rewind to the moment the client fired, for both the hit check and the retargeting
+	const double ShotTime = LagCompensation->ClampRewindTime(Shot.Timestamp);
+
+	// the victim really was under the crosshair when the client fired, so aim where it is now
+	if (LagCompensation->ConfirmHit(Shot.AimVictim, Shot.AimStart, AimEnd, ShotTime, HitTolerance))
+	{
+		return LagCompensation->CompensateAimTarget(Cast<APawn>(GetOwner()), Shot.AimStart, Shot.AimTarget, ShotTime);
+	}
+
+	// otherwise the shot goes where the client aimed, against the present world
+	return Shot.AimTarget;
+}
+
+void UShooterShotBatchComponent::BroadcastShot(AShooterWeapon* Weapon, const FVector& Origin, const FVector& AimDirection, int32 SpreadSeed)
+{
+	const AShooterCharacter* Shooter = Cast<AShooterCharacter>(GetOwner());
+	const int32 WeaponIndex = Shooter ? Shooter->GetOwnedWeaponIndex(Weapon) : INDEX_NONE;
+
+	if (WeaponIndex == INDEX_NONE || WeaponIndex > MAX_uint8)
+	{
+		return;
+	}
+
+	FShooterShotEvent ShotEvent;
+	ShotEvent.MuzzleOrigin = Origin;
+	ShotEvent.AimDirection = AimDirection;
+	ShotEvent.SpreadSeed = SpreadSeed;
+	ShotEvent.WeaponIndex = static_cast<uint8>(WeaponIndex);
+
+	MulticastShotEvent(ShotEvent);
+
+	++NumShotEventsSent;
+	INC_DWORD_STAT(STAT_ShooterShotEventsSent);
+}
+
+void UShooterShotBatchComponent::MulticastShotEvent_Implementation(const FShooterShotEvent& ShotEvent)
+{
+	const AShooterCharacter* Shooter = Cast<AShooterCharacter>(GetOwner());
+
+	// the server fired the shot, and the owning client already predicted it
+	if (!Shooter || Shooter->HasAuthority() || Shooter->IsLocallyControlled())
+	{
+		return;
+	}
+
+	if (AShooterWeapon* Weapon = Shooter->GetOwnedWeapon(ShotEvent.WeaponIndex))
+	{
+		Weapon->FireCosmeticShot(ShotEvent.MuzzleOrigin, ShotEvent.AimDirection, ShotEvent.SpreadSeed);
+	}
+}
+
+void UShooterShotBatchComponent::DumpStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("%s shot batches: sent %d batches with %d shots (%.2f shots per batch), confirmed %d, rejected %d, shot events sent %d"),
+		*GetNameSafe(GetOwner()), NumBatchesSent, NumShotsSent, NumBatchesSent > 0 ? static_cast<float>(NumShotsSent) / NumBatchesSent : 0.0f,
+		NumShotsConfirmed, NumShotsRejected, NumShotEventsSent);
+}
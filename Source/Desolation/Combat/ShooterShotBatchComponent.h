@@ -0,0 +1,203 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Engine/NetSerialization.h"
+#include "ShooterShotBatchComponent.generated.h"
+
+class ACharacter;
+class AShooterWeapon;
+
+/**
+ *  A shot fired by a client ahead of the server
+ */
+USTRUCT()
+struct FShooterShotRecord
+{
+	GENERATED_BODY()
+
+	/** Server world time the client fired at */
+	UPROPERTY()
+	double Timestamp = 0.0;
+
+	/** Index of the shot on the weapon's spread stream */
+	UPROPERTY()
+	uint32 ShotIndex = 0;
+
+	/** View location the client aimed from */
+	UPROPERTY()
+	FVector_NetQuantize AimStart;
+
+	/** Location the client aimed at */
+	UPROPERTY()
+	FVector_NetQuantize AimTarget;
+
+	/** Character under the client's crosshair when it fired, if any */
+	UPROPERTY()
+	TObjectPtr<ACharacter> AimVictim;
+};
+
+/**
+ *  Shots fired by a client since its last batch
+ */
+USTRUCT()
+struct FShooterShotBatch
+{
+	GENERATED_BODY()
+
+	/** Shots in the order they were fired */
+	UPROPERTY()
+	TArray<FShooterShotRecord> Shots;
+};
+
+/**
+ *  A shot fired on the server, sent to remote clients so they can show it
+ *  Bit packed by NetSerialize into a quantized origin, two 16 bit aim angles, the owner's weapon index and the spread seed
+ */
+USTRUCT()
+struct FShooterShotEvent
+{
+	GENERATED_BODY()
+
+	/** Muzzle location the shot was fired from. Quantized to a tenth of a centimeter */
+	FVector MuzzleOrigin = FVector::ZeroVector;
+
+	/** Shot direction. Compressed to a 16 bit pitch and yaw */
+	FVector AimDirection = FVector::ForwardVector;
+
+	/** Seed for the pellet spread, or zero for projectile shots, which carry their final direction */
+	int32 SpreadSeed = 0;
+
+	/** Index of the weapon in the shooter's owned weapons */
+	uint8 WeaponIndex = 0;
+
+	/** Serializes the event for replication */
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FShooterShotEvent> : public TStructOpsTypeTraitsBase2<FShooterShotEvent>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
+/**
+ *  Server side record of the shots confirmed for one weapon
+ */
+struct FShooterConfirmedShots
+{
+	/** Timestamp of the last confirmed shot */
+	double LastTime = 0.0;
+
+	/** Shot index of the last confirmed shot */
+	uint32 LastIndex = 0;
+
+	/** Earliest time the first shot of the current firing window could have been fired, clamped to the rewind window */
+	double FirstConfirmedServerTime = 0.0;
+
+	/** Server time the last shot was confirmed at */
+	double LastConfirmedServerTime = 0.0;
+
+	/** Shots confirmed since the start of the current firing window */
+	int32 NumConfirmed = 0;
+};
+
+/**
+ *  Confirms client predicted shots on the server
+ *  Remote clients fire their weapons right away and record each shot here. Recorded shots are sent to the server
+ *  in one RPC per network update, where they're validated against the weapon's refire rate and magazine
+ *  before being fired again with authority. Authoritative shots are sent on to the other clients as compact shot events,
+ *  so they spawn cosmetic projectiles locally instead of receiving a replicated actor per bullet
+ */
+UCLASS(ClassGroup=(Shooter), meta=(BlueprintSpawnableComponent))
+class DESOLATION_API UShooterShotBatchComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+	/** Shots recorded since the last batch was sent */
+	FShooterShotBatch PendingBatch;
+
+	/** Time since the last batch was sent */
+	float TimeSinceFlush = 0.0f;
+
+	/** Confirmed shot sequence of each weapon, so switching weapons doesn't restart validation */
+	TMap<TObjectKey<AShooterWeapon>, FShooterConfirmedShots> ConfirmedShots;
+
+	/** Number of batches sent */
+	int32 NumBatchesSent = 0;
+
+	/** Number of shots sent */
+	int32 NumShotsSent = 0;
+
+	/** Number of shots confirmed by the server */
+	int32 NumShotsConfirmed = 0;
+
+	/** Number of shots rejected by the server */
+	int32 NumShotsRejected = 0;
+
+	/** Number of shot events sent to clients */
+	int32 NumShotEventsSent = 0;
+
+protected:
+
+	/** Fraction of the refire rate a shot may arrive early by before it's rejected, to absorb client frame timing */
+	UPROPERTY(EditAnywhere, Category="Shot Confirmation", meta = (ClampMin = 0, ClampMax = 1))
+	float RefireTolerance = 0.1f;
+
+	/** Time in seconds a shot may be timestamped ahead of the server clock before it's rejected */
+	UPROPERTY(EditAnywhere, Category="Shot Confirmation", meta = (ClampMin = 0, Units = "s"))
+	float FutureTolerance = 0.05f;
+
+	/** Distance the server allows between a claimed hit and the rewound victim hitboxes */
+	UPROPERTY(EditAnywhere, Category="Shot Confirmation", meta = (ClampMin = 0, Units = "cm"))
+	float HitTolerance = 15.0f;
+
+public:
+
+	/** Constructor */
+	UShooterShotBatchComponent();
+
+	/** Sends the pending batch once per network update */
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+public:
+
+	/** Returns true if shots fired by the owner need to be confirmed by the server */
+	bool ShouldRecordShots() const;
+
+	/** Records a predicted shot fired the given time ago. The aim origin and victim come from the owner's aim trace */
+	void RecordShot(uint32 ShotIndex, const FVector& AimTarget, double ShotAge = 0.0);
+
+	/** Sends the pending batch right away. Called before the owner switches weapons */
+	void FlushShots();
+
+	/** Sends an authoritative shot to the other clients */
+	void BroadcastShot(AShooterWeapon* Weapon, const FVector& Origin, const FVector& AimDirection, int32 SpreadSeed);
+
+	/** Logs the batching and confirmation counters */
+	void DumpStats() const;
+
+protected:
+
+	/** Validates and fires a client's shots on the server */
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerConfirmShots(const FShooterShotBatch& Batch);
+
+	/** Shows a shot fired on the server on clients that didn't predict it */
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastShotEvent(const FShooterShotEvent& ShotEvent);
+
+	/**
+	 *  Returns true if a shot falls inside the rewind window, follows the weapon's last confirmed shot by at least the refire rate
+	 *  and keeps the weapon's confirmed shots within what the refire rate allows in real server time
+	 */
+	bool ValidateShot(const AShooterWeapon* Weapon, const FShooterConfirmedShots* Confirmed, const FShooterShotRecord& Shot, double ServerTime) const;
+
+	/** Returns the location to fire a confirmed shot at */
+	FVector ResolveShotTarget(const FShooterShotRecord& Shot) const;
+};
@@ -21,6 +21,7 @@ public class Desolation : ModuleRules
 			"GameplayAbilities",
 			"GameplayTasks",
 			"GameplayTags",
+			"Niagara",
 		});
 
 		PrivateDependencyModuleNames.AddRange(new string[] { });
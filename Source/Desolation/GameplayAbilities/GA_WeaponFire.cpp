@@ -4,18 +4,43 @@
 #include "GA_WeaponFire.h"
 #include "Abilities/GameplayAbility.h"
 #include "Character/ShooterCharacter.h"
+#include "ShooterWeapon/ShooterWeapon.h"
 #include "Abilities/Tasks/AbilityTask_WaitGameplayEvent.h"
+#include "AbilitySystemComponent.h"
+#include "ShooterGameplayTags.h"
 
 UGA_WeaponFire::UGA_WeaponFire()
 {
 	InstancingPolicy = EGameplayAbilityInstancingPolicy::InstancedPerActor;
 
-	StartFiringTag = FGameplayTag::RequestGameplayTag(FName("Survival.Ability.Weapon.StartFiring"));
-	EndFiringTag = FGameplayTag::RequestGameplayTag(FName("Survival.Ability.Weapon.StopFiring"));
+	// fire on the owning client right away. The server confirms the shots through the shot batch component
+	NetExecutionPolicy = EGameplayAbilityNetExecutionPolicy::LocalPredicted;
+
+	StartFiringTag = ShooterGameplayTags::Ability_Weapon_StartFiring;
+	EndFiringTag = ShooterGameplayTags::Ability_Weapon_StopFiring;
 
 	// FireWeapon tag
 	SetAssetTags(FGameplayTagContainer(StartFiringTag));
 	ActivationOwnedTags.AddTag(StartFiringTag); // Test to see if this works better
+
+	// every owned weapon keeps its fire ability granted, so only fire while a weapon is equipped
+	ActivationRequiredTags.AddTag(ShooterGameplayTags::Weapon_Equipped);
+}
+
+bool UGA_WeaponFire::CanActivateAbility(const FGameplayAbilitySpecHandle Handle, const FGameplayAbilityActorInfo* ActorInfo,
+	const FGameplayTagContainer* SourceTags, const FGameplayTagContainer* TargetTags, FGameplayTagContainer* OptionalRelevantTags) const
+{
+	if (!Super::CanActivateAbility(Handle, ActorInfo, SourceTags, TargetTags, OptionalRelevantTags))
+	{
+		return false;
+	}
+
+	// the weapon class is the spec's source object, which replicates to the owning client. Skip the specs of weapons that are owned but holstered
+	const AShooterCharacter* Shooter = ActorInfo ? Cast<AShooterCharacter>(ActorInfo->AvatarActor.Get()) : nullptr;
+	const AShooterWeapon* CurrentWeapon = Shooter ? Shooter->GetCurrentWeapon() : nullptr;
+	const FGameplayAbilitySpec* Spec = ActorInfo && ActorInfo->AbilitySystemComponent.IsValid() ? ActorInfo->AbilitySystemComponent->FindAbilitySpecFromHandle(Handle) : nullptr;
+
+	return CurrentWeapon && Spec && Spec->SourceObject.Get() == CurrentWeapon->GetClass();
 }
 
 void UGA_WeaponFire::ActivateAbility(const FGameplayAbilitySpecHandle Handle,
@@ -43,6 +68,12 @@ void UGA_WeaponFire::ActivateAbility(const FGameplayAbilitySpecHandle Handle,
 
 void UGA_WeaponFire::FireWeapon()
 {
+	// only the controlling side runs the weapon. Remote shooters' shots reach the server in confirmed batches instead
+	if (!IsLocallyControlled())
+	{
+		return;
+	}
+
 	if (AShooterCharacter* Shooter = Cast<AShooterCharacter>(GetActorInfo().AvatarActor))
 	{
 		Shooter->DoStartFiring();
@@ -0,0 +1,26 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "GameplayAbilities/ShooterAbilitySystemComponent.h"
+
+void UShooterAbilitySystemComponent::OnGiveAbility(FGameplayAbilitySpec& AbilitySpec)
+{
+	Super::OnGiveAbility(AbilitySpec);
+
+	OnAbilityListChanged.Broadcast();
+}
+
+void UShooterAbilitySystemComponent::OnRemoveAbility(FGameplayAbilitySpec& AbilitySpec)
+{
+	Super::OnRemoveAbility(AbilitySpec);
+
+	OnAbilityListChanged.Broadcast();
+}
+
+void UShooterAbilitySystemComponent::OnRep_ActivateAbilities()
+{
+	Super::OnRep_ActivateAbilities();
+
+	// replicated specs can also change in place without a give or remove
+	OnAbilityListChanged.Broadcast();
+}
@@ -0,0 +1,35 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AbilitySystemComponent.h"
+#include "ShooterAbilitySystemComponent.generated.h"
+
+DECLARE_MULTICAST_DELEGATE(FShooterAbilityListChangedDelegate);
+
+/**
+ *  Ability system component that reports changes to its granted ability list
+ *  Fires on the server as abilities are given or removed, and on the owning client as the list replicates in
+ */
+UCLASS()
+class DESOLATION_API UShooterAbilitySystemComponent : public UAbilitySystemComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Called whenever an ability spec is added to or removed from the granted list */
+	FShooterAbilityListChangedDelegate OnAbilityListChanged;
+
+protected:
+
+	/** Reports a newly granted spec */
+	virtual void OnGiveAbility(FGameplayAbilitySpec& AbilitySpec) override;
+
+	/** Reports a removed spec */
+	virtual void OnRemoveAbility(FGameplayAbilitySpec& AbilitySpec) override;
+
+	/** Reports a replicated update of the granted list */
+	virtual void OnRep_ActivateAbilities() override;
+};
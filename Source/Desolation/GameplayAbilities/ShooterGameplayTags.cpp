@@ -0,0 +1,11 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "GameplayAbilities/ShooterGameplayTags.h"
+
+namespace ShooterGameplayTags
+{
+	UE_DEFINE_GAMEPLAY_TAG_COMMENT(Ability_Weapon_StartFiring, "Survival.Ability.Weapon.StartFiring", "Fires Weapon");
+	UE_DEFINE_GAMEPLAY_TAG_COMMENT(Ability_Weapon_StopFiring, "Survival.Ability.Weapon.StopFiring", "Stops firing the weapon");
+	UE_DEFINE_GAMEPLAY_TAG_COMMENT(Weapon_Equipped, "Survival.Weapon.Equipped", "Raised while a weapon is equipped. Gates weapon fire abilities");
+}
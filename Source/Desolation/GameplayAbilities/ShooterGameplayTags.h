@@ -0,0 +1,22 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "NativeGameplayTags.h"
+
+/**
+ *  Native gameplay tags used by the shooter abilities
+ *  Registered with the tag manager when the module loads, so code never has to look them up by name
+ */
+namespace ShooterGameplayTags
+{
+	/** Starts firing the equipped weapon. Also the fire ability's asset tag */
+	DESOLATION_API UE_DECLARE_GAMEPLAY_TAG_EXTERN(Ability_Weapon_StartFiring);
+
+	/** Gameplay event sent when the fire input is released */
+	DESOLATION_API UE_DECLARE_GAMEPLAY_TAG_EXTERN(Ability_Weapon_StopFiring);
+
+	/** Raised while a weapon is equipped. Gates weapon fire abilities */
+	DESOLATION_API UE_DECLARE_GAMEPLAY_TAG_EXTERN(Weapon_Equipped);
+}
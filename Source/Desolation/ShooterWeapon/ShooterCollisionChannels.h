@@ -0,0 +1,14 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+
+/**
+ *  Project specific collision channels
+ *  Must match the channel setup in DefaultEngine.ini
+ */
+
+/** Object channel used by projectiles. Most objects block it by default, triggers ignore it */
+#define Shooter_ObjectChannel_Projectile ECC_GameTraceChannel1
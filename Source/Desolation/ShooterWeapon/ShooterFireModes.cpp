@@ -0,0 +1,355 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterWeapon/ShooterFireModes.h"
+#include "ShooterWeapon.h"
+#include "ShooterFireScheduler.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+
+/**
+ *  Stand-in weapon state for the fire mode benchmark. Mirrors the members the fire pipeline reads on AShooterWeapon
+ */
+struct FShooterFireBenchWeapon
+{
+	TArray<double> DueShotTimes;
+	FShooterFireAccumulator FireCadence;
+	double RefireRate = 0.01;
+	bool bFullAuto = false;
+	bool bRefireWhileHeld = false;
+	int32 BurstCount = 0;
+	int32 BurstShotsLeft = 0;
+	int32 PelletCount = 1;
+	int32 CurrentBullets = 30;
+	int32 MagazineSize = 30;
+	uint32 ShotCounter = 0;
+	double TimeOfLastShot = 0.0;
+	int32 NumScheduled = 0;
+
+	/** Sum of every random draw, so the work can't be optimized away and both paths can be compared */
+	double Checksum = 0.0;
+
+	/** Stand-in for the shot's real work: draws the spread from the shot's stream like the weapon does */
+	FORCENOINLINE void EmitShot(const FVector& TargetLocation, int32 NumDraws, double ShotAge)
+	{
+		FRandomStream Stream = AShooterWeapon::MakeShotStream(1234, ShotCounter);
+
+		for (int32 Draw = 0; Draw < NumDraws; ++Draw)
+		{
+			Checksum += (TargetLocation + Stream.VRand()).X;
+		}
+
+		Checksum += ShotAge;
+	}
+
+	FVector GetShotTargetLocation() const { return FVector(1000.0, 0.0, 0.0); }
+
+	void RecordPredictedShot(uint32 ShotIndex, const FVector& TargetLocation, double ShotAge) {}
+
+	void ScheduleNextShot(double ShotTime, bool bCooldownOnly) { ++NumScheduled; }
+};
+
+/**
+ *  Benchmark weapon driven by the specialized fire pipeline
+ */
+struct FShooterPolicyFireBenchWeapon : public FShooterFireBenchWeapon
+{
+	void FireProjectile(const FVector& TargetLocation, double ShotAge) { EmitShot(TargetLocation, 1, ShotAge); }
+
+	void FirePellets(const FVector& TargetLocation) { EmitShot(TargetLocation, PelletCount, 0.0); }
+
+	void AdvanceShot(double ShotTime)
+	{
+		++ShotCounter;
+		TimeOfLastShot = ShotTime;
+	}
+
+	void FinishShot() {}
+};
+
+/**
+ *  Benchmark weapon reproducing the bool and virtual fire path the pipeline replaced
+ */
+struct FShooterLegacyFireBenchWeapon : public FShooterFireBenchWeapon
+{
+	virtual ~FShooterLegacyFireBenchWeapon() = default;
+
+	void FireDueShots(double Now, int32 MaxShotsPerFrame)
+	{
+		const int32 MaxShots = (bFullAuto || bRefireWhileHeld) ? MaxShotsPerFrame : 1;
+
+		DueShotTimes.Reset();
+		FireCadence.CollectDueShots(Now, RefireRate, DueShotTimes, MaxShots);
+
+		for (const double ShotTime : DueShotTimes)
+		{
+			Fire(ShotTime, Now);
+		}
+
+		ScheduleNextShot(FireCadence.NextShotTime, !(bFullAuto || bRefireWhileHeld));
+	}
+
+	virtual void Fire(double ShotTime, double Now)
+	{
+		const FVector TargetLocation = GetShotTargetLocation();
+		const uint32 ShotIndex = ShotCounter;
+
+		FireShot(TargetLocation, ShotTime, Now);
+
+		RecordPredictedShot(ShotIndex, TargetLocation, Now - ShotTime);
+	}
+
+	void FireShot(const FVector& TargetLocation, double ShotTime, double Now)
+	{
+		if (PelletCount > 1)
+		{
+			FirePellets(TargetLocation);
+
+		} else {
+
+			FireProjectile(TargetLocation, FMath::Max(Now - ShotTime, 0.0));
+		}
+
+		++ShotCounter;
+		TimeOfLastShot = ShotTime;
+	}
+
+	virtual void FireProjectile(const FVector& TargetLocation, double ShotAge)
+	{
+		EmitShot(TargetLocation, 1, ShotAge);
+		FinishShot();
+	}
+
+	virtual void FirePellets(const FVector& TargetLocation)
+	{
+		EmitShot(TargetLocation, PelletCount, 0.0);
+		FinishShot();
+	}
+
+	void FinishShot()
+	{
+		if (--CurrentBullets <= 0)
+		{
+			CurrentBullets = MagazineSize;
+		}
+	}
+};
+
+/** Runs a weapon's fire loop at 60 fps until it has fired the given number of shots. Returns the seconds spent firing */
+template<typename TWeapon, typename TFireFunc>
+static double RunFireBenchmark(TWeapon& Weapon, int32 NumShots, TFireFunc&& FireFunc)
+{
+	constexpr double FrameTime = 1.0 / 60.0;
+	constexpr int32 MaxShotsPerFrame = 32;
+
+	Weapon.FireCadence.Start(0.0);
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	for (double Now = 0.0; Weapon.ShotCounter < static_cast<uint32>(NumShots); Now += FrameTime)
+	{
+		FireFunc(Weapon, Now, MaxShotsPerFrame);
+	}
+
+	return FPlatformTime::Seconds() - StartTime;
+}
+
+static void BenchmarkFireModes(const TArray<FString>& Args)
+{
+	const int32 NumShots = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 200000;
+	const int32 NumPellets = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 2) : 8;
+
+	UE_LOG(LogTemp, Log, TEXT("Fire mode benchmark: %d shots per mode, %d pellets per spread"), NumShots, NumPellets);
+
+	bool bAllPassed = true;
+
+	// the modes the bool and virtual path could express, so the two paths can be compared shot for shot
+	for (const bool bFullAuto : { false, true })
+	{
+		for (const bool bPellets : { false, true })
+		{
+			auto Configure = [&](FShooterFireBenchWeapon& Weapon)
+			{
+				Weapon.bFullAuto = bFullAuto;
+				Weapon.bRefireWhileHeld = !bFullAuto;
+				Weapon.PelletCount = bPellets ? NumPellets : 1;
+			};
+
+			FShooterLegacyFireBenchWeapon LegacyWeapon;
+			Configure(LegacyWeapon);
+
+			const double LegacySeconds = RunFireBenchmark(LegacyWeapon, NumShots, [](FShooterLegacyFireBenchWeapon& Weapon, double Now, int32 MaxShotsPerFrame)
+			{
+				Weapon.FireDueShots(Now, MaxShotsPerFrame);
+			});
+
+			FShooterPolicyFireBenchWeapon PolicyWeapon;
+			Configure(PolicyWeapon);
+
+			const EShooterTriggerMode TriggerMode = bFullAuto ? EShooterTriggerMode::FullAuto : EShooterTriggerMode::SemiAuto;
+			const TShooterFireRoutines<FShooterPolicyFireBenchWeapon> Routines = SelectShooterFireRoutines<FShooterPolicyFireBenchWeapon>(TriggerMode, bPellets, false);
+
+			const double PolicySeconds = RunFireBenchmark(PolicyWeapon, NumShots, [&Routines](FShooterPolicyFireBenchWeapon& Weapon, double Now, int32 MaxShotsPerFrame)
+			{
+				Routines.FireDueShots(Weapon, Now, MaxShotsPerFrame);
+			});
+
+			// both paths must fire the same shots and leave the weapon in the same state
+			const bool bPassed = LegacyWeapon.ShotCounter == PolicyWeapon.ShotCounter
+				&& LegacyWeapon.CurrentBullets == PolicyWeapon.CurrentBullets
+				&& LegacyWeapon.NumScheduled == PolicyWeapon.NumScheduled
+				&& LegacyWeapon.TimeOfLastShot == PolicyWeapon.TimeOfLastShot
+				&& LegacyWeapon.Checksum == PolicyWeapon.Checksum;
+
+			bAllPassed &= bPassed;
+
+			const double LegacyNs = LegacySeconds * 1e9 / LegacyWeapon.ShotCounter;
+			const double PolicyNs = PolicySeconds * 1e9 / PolicyWeapon.ShotCounter;
+
+			UE_LOG(LogTemp, Log, TEXT("  %-9s %-10s virtual %7.1f ns/shot, specialized %7.1f ns/shot (%.2fx) [%s]"),
+				bFullAuto ? TEXT("full auto") : TEXT("semi auto"), bPellets ? TEXT("pellets") : TEXT("projectile"),
+				LegacyNs, PolicyNs, LegacyNs / FMath::Max(PolicyNs, UE_SMALL_NUMBER), bPassed ? TEXT("PASS") : TEXT("FAIL"));
+		}
+	}
+
+	// modes only the policies can express
+	for (const bool bPellets : { false, true })
+	{
+		FShooterPolicyFireBenchWeapon PolicyWeapon;
+		PolicyWeapon.BurstCount = 3;
+		PolicyWeapon.BurstShotsLeft = 3;
+		PolicyWeapon.bRefireWhileHeld = true;
+		PolicyWeapon.PelletCount = bPellets ? NumPellets : 1;
+
+		const TShooterFireRoutines<FShooterPolicyFireBenchWeapon> Routines = SelectShooterFireRoutines<FShooterPolicyFireBenchWeapon>(EShooterTriggerMode::Burst, bPellets, true);
+
+		const double PolicySeconds = RunFireBenchmark(PolicyWeapon, NumShots, [&Routines](FShooterPolicyFireBenchWeapon& Weapon, double Now, int32 MaxShotsPerFrame)
+		{
+			Routines.FireDueShots(Weapon, Now, MaxShotsPerFrame);
+		});
+
+		// infinite ammo never touches the magazine
+		const bool bPassed = PolicyWeapon.CurrentBullets == PolicyWeapon.MagazineSize;
+
+		bAllPassed &= bPassed;
+
+		UE_LOG(LogTemp, Log, TEXT("  %-9s %-10s specialized %7.1f ns/shot, infinite ammo [%s]"),
+			TEXT("burst"), bPellets ? TEXT("pellets") : TEXT("projectile"), PolicySeconds * 1e9 / PolicyWeapon.ShotCounter, bPassed ? TEXT("PASS") : TEXT("FAIL"));
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Fire mode benchmark %s"), bAllPassed ? TEXT("passed") : TEXT("FAILED"));
+}
+
+static FAutoConsoleCommand GShooterBenchmarkFireModesCommand(
+	TEXT("Shooter.Weapons.FireModeBenchmark"),
+	TEXT("Compares the per-shot cost of the specialized fire mode routines with the bool and virtual fire path. Args: [NumShots=200000] [NumPellets=8]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkFireModes));
+
+/**
+ *  Fire rate test weapon. Measures the spacing of every shot the fire pipeline advances
+ */
+struct FShooterFireRateTestWeapon : public FShooterPolicyFireBenchWeapon
+{
+	/** Spacing expected between consecutive shots */
+	double ExpectedSpacing = 0.0;
+
+	/** Largest deviation from the expected spacing between two consecutive shots */
+	double MaxSpacingError = 0.0;
+
+	void AdvanceShot(double ShotTime)
+	{
+		if (ShotCounter > 0)
+		{
+			MaxSpacingError = FMath::Max(MaxSpacingError, FMath::Abs(ShotTime - TimeOfLastShot - ExpectedSpacing));
+		}
+
+		FShooterPolicyFireBenchWeapon::AdvanceShot(ShotTime);
+	}
+};
+
+static void TestFireRate(const TArray<FString>& Args)
+{
+	const double RefireRate = FMath::Max(Args.Num() > 0 ? FCString::Atod(*Args[0]) : 0.01, 0.001);
+	const double Duration = Args.Num() > 1 ? FMath::Max(FCString::Atod(*Args[1]), 1.0) : 10.0;
+	const int32 ShotCap = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 2;
+
+	const double ExpectedRate = 1.0 / RefireRate;
+
+	UE_LOG(LogTemp, Log, TEXT("Fire rate test: refire rate %.4fs (%.1f shots/s expected) over %.1fs, capped runs at %d shots per frame"), RefireRate, ExpectedRate, Duration, ShotCap);
+
+	// drive the same full auto routine the weapons use
+	const TShooterFireRoutines<FShooterFireRateTestWeapon> Routines = SelectShooterFireRoutines<FShooterFireRateTestWeapon>(EShooterTriggerMode::FullAuto, false, true);
+
+	bool bAllPassed = true;
+
+	for (const double FrameRate : { 20.0, 60.0, 144.0 })
+	{
+		for (const bool bCapped : { false, true })
+		{
+			FShooterFireRateTestWeapon Weapon;
+			Weapon.RefireRate = RefireRate;
+			Weapon.ExpectedSpacing = RefireRate;
+			Weapon.FireCadence.Start(0.0);
+
+			const int32 MaxShotsPerFrame = bCapped ? ShotCap : MAX_int32;
+
+			// step the weapon with a little frame time jitter
+			FRandomStream Jitter(1234);
+			double LastFrameTime = 0.0;
+
+			// per frame rescheduling, the way weapons used to refire
+			int32 NumLegacyShots = 0;
+			double LegacyNextShot = 0.0;
+
+			for (double Now = 0.0; Now < Duration; Now += (1.0 / FrameRate) * Jitter.FRandRange(0.9, 1.1))
+			{
+				Routines.FireDueShots(Weapon, Now, MaxShotsPerFrame);
+				LastFrameTime = Now;
+
+				if (LegacyNextShot <= Now)
+				{
+					++NumLegacyShots;
+					LegacyNextShot = Now + RefireRate;
+				}
+			}
+
+			// every shot due by the last frame was either fired or reported as dropped
+			const int32 NumDue = FMath::FloorToInt(LastFrameTime / RefireRate) + 1;
+			const int32 NumFired = static_cast<int32>(Weapon.ShotCounter);
+			const int32 NumDropped = Weapon.FireCadence.NumDroppedShots;
+			const bool bAccounted = FMath::Abs(NumFired + NumDropped - NumDue) <= 1;
+
+			const double MeasuredRate = NumFired / Duration;
+			bool bPassed = bAccounted;
+
+			if (bCapped)
+			{
+				// a cap below what even the shortest frame brings due has to drop shots
+				const bool bMustDrop = ShotCap * RefireRate < 0.9 / FrameRate;
+
+				bPassed &= !bMustDrop || NumDropped > 0;
+
+				UE_LOG(LogTemp, Log, TEXT("  %5.1f fps capped:   %.1f shots/s, %d fired, %d dropped, %d due [%s]"),
+					FrameRate, MeasuredRate, NumFired, NumDropped, NumDue, bPassed ? TEXT("PASS") : TEXT("FAIL"));
+
+			} else {
+
+				bPassed &= NumDropped == 0
+					&& FMath::Abs(MeasuredRate - ExpectedRate) <= ExpectedRate * 0.01 + 1.0 / Duration
+					&& Weapon.MaxSpacingError < 1e-6;
+
+				UE_LOG(LogTemp, Log, TEXT("  %5.1f fps uncapped: %.1f shots/s, max spacing error %.3fus, %d dropped, per frame refire %.1f shots/s [%s]"),
+					FrameRate, MeasuredRate, Weapon.MaxSpacingError * 1000000.0, NumDropped, NumLegacyShots / Duration, bPassed ? TEXT("PASS") : TEXT("FAIL"));
+			}
+
+			bAllPassed &= bPassed;
+		}
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Fire rate test %s"), bAllPassed ? TEXT("passed") : TEXT("FAILED"));
+}
+
+static FAutoConsoleCommand GShooterTestFireRateCommand(
+	TEXT("Shooter.Weapons.TestFireRate"),
+	TEXT("Drives the full auto fire routine at 20, 60 and 144 fps, checking the rate of fire uncapped and the dropped shot count under a per-frame cap. Args: [RefireRate=0.01] [Duration=10] [ShotCap=2]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&TestFireRate));
@@ -0,0 +1,268 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ *  Fire modes are built from three policies: a trigger policy deciding how many shots a trigger pull fires,
+ *  an emission policy deciding what each shot spawns and an ammo policy deciding what each shot costs.
+ *  Every combination compiles into its own fire routine with no virtual calls or mode branches,
+ *  and weapons pick the routine for their configuration once, when they activate.
+ *
+ *  The pipeline is written against any weapon type exposing the same members as AShooterWeapon,
+ *  so the benchmark can drive the exact same routines without a world.
+ */
+
+/**
+ *  How the weapon's trigger fires
+ */
+enum class EShooterTriggerMode : uint8
+{
+	SemiAuto,
+	FullAuto,
+	Burst,
+};
+
+/**
+ *  Trigger policy: one shot per pull, unless the trigger is held to keep refiring
+ */
+struct FShooterSemiAutoTrigger
+{
+	/** Returns the most shots that may fire this frame */
+	static FORCEINLINE int32 GetMaxShots(bool bRefireWhileHeld, int32 BurstShotsLeft, int32 MaxShotsPerFrame)
+	{
+		return bRefireWhileHeld ? MaxShotsPerFrame : 1;
+	}
+
+	/** Updates the trigger state after a shot */
+	static FORCEINLINE void OnShotFired(int32& BurstShotsLeft, int32 BurstCount, bool bRefireWhileHeld)
+	{
+	}
+
+	/** Returns true if the weapon fires again on its own once the refire time passes */
+	static FORCEINLINE bool KeepsFiring(bool bRefireWhileHeld, int32 BurstShotsLeft)
+	{
+		return bRefireWhileHeld;
+	}
+};
+
+/**
+ *  Trigger policy: fires at the refire rate for as long as the trigger is down
+ */
+struct FShooterFullAutoTrigger
+{
+	/** Returns the most shots that may fire this frame */
+	static FORCEINLINE int32 GetMaxShots(bool bRefireWhileHeld, int32 BurstShotsLeft, int32 MaxShotsPerFrame)
+	{
+		return MaxShotsPerFrame;
+	}
+
+	/** Updates the trigger state after a shot */
+	static FORCEINLINE void OnShotFired(int32& BurstShotsLeft, int32 BurstCount, bool bRefireWhileHeld)
+	{
+	}
+
+	/** Returns true if the weapon fires again on its own once the refire time passes */
+	static FORCEINLINE bool KeepsFiring(bool bRefireWhileHeld, int32 BurstShotsLeft)
+	{
+		return true;
+	}
+};
+
+/**
+ *  Trigger policy: a fixed number of shots per pull. Held triggers chain bursts back to back
+ *  A burst that has started always fires all of its shots. Releasing the trigger only stops the next one from following
+ */
+struct FShooterBurstTrigger
+{
+	/** Returns the most shots that may fire this frame */
+	static FORCEINLINE int32 GetMaxShots(bool bRefireWhileHeld, int32 BurstShotsLeft, int32 MaxShotsPerFrame)
+	{
+		return FMath::Min(BurstShotsLeft, MaxShotsPerFrame);
+	}
+
+	/** Updates the trigger state after a shot */
+	static FORCEINLINE void OnShotFired(int32& BurstShotsLeft, int32 BurstCount, bool bRefireWhileHeld)
+	{
+		// start the next burst right away if the trigger is still held
+		if (--BurstShotsLeft <= 0 && bRefireWhileHeld)
+		{
+			BurstShotsLeft = BurstCount;
+		}
+	}
+
+	/** Returns true if the weapon fires again on its own once the refire time passes */
+	static FORCEINLINE bool KeepsFiring(bool bRefireWhileHeld, int32 BurstShotsLeft)
+	{
+		return BurstShotsLeft > 0;
+	}
+};
+
+/**
+ *  Emission policy: each shot spawns or simulates a single projectile
+ */
+struct FShooterProjectileEmission
+{
+	/** Fires one projectile, advanced along its flight by the shot's age */
+	template<typename TWeapon>
+	static FORCEINLINE void Emit(TWeapon& Weapon, const FVector& TargetLocation, double ShotAge)
+	{
+		Weapon.FireProjectile(TargetLocation, ShotAge);
+	}
+};
+
+/**
+ *  Emission policy: each shot traces a spread of hitscan pellets
+ */
+struct FShooterPelletEmission
+{
+	/** Fires one pellet spread. Pellets resolve instantly, so the shot's age is ignored */
+	template<typename TWeapon>
+	static FORCEINLINE void Emit(TWeapon& Weapon, const FVector& TargetLocation, double ShotAge)
+	{
+		Weapon.FirePellets(TargetLocation);
+	}
+};
+
+/**
+ *  Ammo policy: each shot uses a round, and an empty magazine reloads itself
+ */
+struct FShooterMagazineAmmo
+{
+	/** Consumes the ammo for one shot */
+	static FORCEINLINE void Consume(int32& CurrentBullets, int32 MagazineSize)
+	{
+		if (--CurrentBullets <= 0)
+		{
+			CurrentBullets = MagazineSize;
+		}
+	}
+};
+
+/**
+ *  Ammo policy: shots are free
+ */
+struct FShooterInfiniteAmmo
+{
+	/** Consumes the ammo for one shot */
+	static FORCEINLINE void Consume(int32& CurrentBullets, int32 MagazineSize)
+	{
+	}
+};
+
+/**
+ *  Fire routine specialized for one trigger, emission and ammo policy combination
+ */
+template<typename TTrigger, typename TEmission, typename TAmmo>
+struct TShooterFirePipeline
+{
+	/** Fires every shot that has come due since the last frame, then schedules the next one */
+	template<typename TWeapon>
+	static void FireDueShots(TWeapon& Weapon, double Now, int32 MaxShotsPerFrame)
+	{
+		// collect every shot due since the last frame, up to what the trigger allows
+		const int32 MaxShots = TTrigger::GetMaxShots(Weapon.bRefireWhileHeld, Weapon.BurstShotsLeft, MaxShotsPerFrame);
+
+		Weapon.DueShotTimes.Reset();
+		Weapon.FireCadence.CollectDueShots(Now, Weapon.RefireRate, Weapon.DueShotTimes, MaxShots);
+
+		for (const double ShotTime : Weapon.DueShotTimes)
+		{
+			// find the target once, so a predicted shot sends the server the same aim it fired at
+			const FVector TargetLocation = Weapon.GetShotTargetLocation();
+			const uint32 ShotIndex = Weapon.ShotCounter;
+
+			FireShot(Weapon, TargetLocation, ShotTime, Now);
+
+			// remote clients fire right away and send the shot to the server to be confirmed
+			Weapon.RecordPredictedShot(ShotIndex, TargetLocation, Now - ShotTime);
+		}
+
+		// schedule the next shot, or only the cooldown notification if the trigger doesn't refire on its own
+		Weapon.ScheduleNextShot(Weapon.FireCadence.NextShotTime, !TTrigger::KeepsFiring(Weapon.bRefireWhileHeld, Weapon.BurstShotsLeft));
+	}
+
+	/** Fires a single shot at the target and advances the shot counter */
+	template<typename TWeapon>
+	static void FireShot(TWeapon& Weapon, const FVector& TargetLocation, double ShotTime, double Now)
+	{
+		// pay for the shot first, so the HUD shows the ammo left after it
+		TAmmo::Consume(Weapon.CurrentBullets, Weapon.MagazineSize);
+
+		// shots due earlier in the frame spawn as far along as they would have flown by now
+		TEmission::Emit(Weapon, TargetLocation, FMath::Max(Now - ShotTime, 0.0));
+
+		TTrigger::OnShotFired(Weapon.BurstShotsLeft, Weapon.BurstCount, Weapon.bRefireWhileHeld);
+
+		Weapon.AdvanceShot(ShotTime);
+
+		// play the shooter's feedback
+		Weapon.FinishShot();
+	}
+
+	/** Fires a shot the server confirmed for a remote client. Leaves the trigger state and the shooter's feedback to the client that fired it */
+	template<typename TWeapon>
+	static void FireConfirmedShot(TWeapon& Weapon, const FVector& TargetLocation, double ShotTime, double Now)
+	{
+		TAmmo::Consume(Weapon.CurrentBullets, Weapon.MagazineSize);
+
+		TEmission::Emit(Weapon, TargetLocation, FMath::Max(Now - ShotTime, 0.0));
+
+		Weapon.AdvanceShot(ShotTime);
+	}
+};
+
+/**
+ *  The specialized routines for a weapon's fire mode
+ */
+template<typename TWeapon>
+struct TShooterFireRoutines
+{
+	/** Fires every shot due by the given time, up to the per-frame cap */
+	void (*FireDueShots)(TWeapon& Weapon, double Now, int32 MaxShotsPerFrame) = nullptr;
+
+	/** Fires a single shot at the target */
+	void (*FireShot)(TWeapon& Weapon, const FVector& TargetLocation, double ShotTime, double Now) = nullptr;
+
+	/** Fires a single server confirmed shot at the target, without feedback or trigger state */
+	void (*FireConfirmedShot)(TWeapon& Weapon, const FVector& TargetLocation, double ShotTime, double Now) = nullptr;
+};
+
+/** Returns the routines compiled for one policy combination */
+template<typename TTrigger, typename TEmission, typename TAmmo, typename TWeapon>
+TShooterFireRoutines<TWeapon> MakeShooterFireRoutines()
+{
+	using FPipeline = TShooterFirePipeline<TTrigger, TEmission, TAmmo>;
+
+	TShooterFireRoutines<TWeapon> Routines;
+	Routines.FireDueShots = &FPipeline::template FireDueShots<TWeapon>;
+	Routines.FireShot = &FPipeline::template FireShot<TWeapon>;
+	Routines.FireConfirmedShot = &FPipeline::template FireConfirmedShot<TWeapon>;
+
+	return Routines;
+}
+
+/** Returns the routines for a trigger mode, emission and ammo policy combination */
+template<typename TWeapon>
+TShooterFireRoutines<TWeapon> SelectShooterFireRoutines(EShooterTriggerMode TriggerMode, bool bPellets, bool bInfiniteAmmo)
+{
+	// indexed by trigger mode, then pellets, then infinite ammo
+	static const TShooterFireRoutines<TWeapon> Table[3][2][2] =
+	{
+		{
+			{ MakeShooterFireRoutines<FShooterSemiAutoTrigger, FShooterProjectileEmission, FShooterMagazineAmmo, TWeapon>(), MakeShooterFireRoutines<FShooterSemiAutoTrigger, FShooterProjectileEmission, FShooterInfiniteAmmo, TWeapon>() },
+			{ MakeShooterFireRoutines<FShooterSemiAutoTrigger, FShooterPelletEmission, FShooterMagazineAmmo, TWeapon>(), MakeShooterFireRoutines<FShooterSemiAutoTrigger, FShooterPelletEmission, FShooterInfiniteAmmo, TWeapon>() },
+		},
+		{
+			{ MakeShooterFireRoutines<FShooterFullAutoTrigger, FShooterProjectileEmission, FShooterMagazineAmmo, TWeapon>(), MakeShooterFireRoutines<FShooterFullAutoTrigger, FShooterProjectileEmission, FShooterInfiniteAmmo, TWeapon>() },
+			{ MakeShooterFireRoutines<FShooterFullAutoTrigger, FShooterPelletEmission, FShooterMagazineAmmo, TWeapon>(), MakeShooterFireRoutines<FShooterFullAutoTrigger, FShooterPelletEmission, FShooterInfiniteAmmo, TWeapon>() },
+		},
+		{
+			{ MakeShooterFireRoutines<FShooterBurstTrigger, FShooterProjectileEmission, FShooterMagazineAmmo, TWeapon>(), MakeShooterFireRoutines<FShooterBurstTrigger, FShooterProjectileEmission, FShooterInfiniteAmmo, TWeapon>() },
+			{ MakeShooterFireRoutines<FShooterBurstTrigger, FShooterPelletEmission, FShooterMagazineAmmo, TWeapon>(), MakeShooterFireRoutines<FShooterBurstTrigger, FShooterPelletEmission, FShooterInfiniteAmmo, TWeapon>() },
+		},
+	};
+
+	return Table[static_cast<uint8>(TriggerMode)][bPellets ? 1 : 0][bInfiniteAmmo ? 1 : 0];
+}
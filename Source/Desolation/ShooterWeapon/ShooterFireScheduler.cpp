@@ -0,0 +1,116 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterWeapon/ShooterFireScheduler.h"
+#include "ShooterWeapon.h"
+#include "Engine/World.h"
+#include "Algo/BinarySearch.h"
+
+DECLARE_CYCLE_STAT(TEXT("Shooter Fire Scheduler"), STAT_ShooterFireScheduler, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Scheduled Shots Fired"), STAT_ShooterScheduledShotsFired, STATGROUP_Game);
+
+/** Shortest refire rate the accumulator will step by, so a zero refire rate can't stall the frame */
+static constexpr double ShooterMinRefireRate = 0.001;
+
+int32 FShooterFireAccumulator::CollectDueShots(double Now, double RefireRate, TArray<double>& OutShotTimes, int32 MaxShots)
+{
+	const double Step = FMath::Max(RefireRate, ShooterMinRefireRate);
+
+	int32 NumShots = 0;
+
+	while (NextShotTime <= Now && NumShots < MaxShots)
+	{
+		OutShotTimes.Add(NextShotTime);
+		NextShotTime += Step;
+
+		++NumShots;
+	}
+
+	// drop any backlog past the cap so a long hitch doesn't turn into a burst next frame. Skipping whole steps keeps the cadence
+	if (NextShotTime <= Now)
+	{
+		const int32 NumDropped = FMath::FloorToInt((Now - NextShotTime) / Step) + 1;
+
+		NextShotTime += NumDropped * Step;
+		NumDroppedShots += NumDropped;
+	}
+
+	return NumShots;
+}
+
+void UShooterFireScheduler::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterFireScheduler);
+
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	// the schedule is sorted, so every due event is at the front
+	int32 NumDue = 0;
+
+	while (NumDue < Schedule.Num() && Schedule[NumDue].ShotTime <= Now)
+	{
+		++NumDue;
+	}
+
+	if (NumDue == 0)
+	{
+		return;
+	}
+
+	// pull the due events out first, since firing reschedules the weapon
+	DueShots.Reset();
+	DueShots.Append(Schedule.GetData(), NumDue);
+	Schedule.RemoveAt(0, NumDue, EAllowShrinking::No);
+
+	for (const FShooterScheduledShot& Shot : DueShots)
+	{
+		// the weapon may have been destroyed by an earlier shot this frame
+		if (AShooterWeapon* Weapon = Shot.Weapon.Get())
+		{
+			Weapon->OnScheduledShotDue(Shot.bCooldownOnly);
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_ShooterScheduledShotsFired, NumDue);
+}
+
+TStatId UShooterFireScheduler::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterFireScheduler, STATGROUP_Tickables);
+}
+
+bool UShooterFireScheduler::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterFireScheduler::ScheduleShot(AShooterWeapon* Weapon, double ShotTime, bool bCooldownOnly)
+{
+	// a weapon only ever has one pending event
+	CancelShot(Weapon);
+
+	FShooterScheduledShot Shot;
+	Shot.ShotTime = ShotTime;
+	Shot.Weapon = Weapon;
+	Shot.bCooldownOnly = bCooldownOnly;
+
+	// insert after any events due at the same time so equal times fire in scheduling order
+	const int32 InsertIndex = Algo::UpperBoundBy(Schedule, ShotTime, &FShooterScheduledShot::ShotTime);
+	Schedule.Insert(Shot, InsertIndex);
+}
+
+void UShooterFireScheduler::CancelShot(AShooterWeapon* Weapon)
+{
+	// compare by object index so this still works while the weapon is ending play
+	const TWeakObjectPtr<AShooterWeapon> WeakWeapon(Weapon);
+
+	const int32 Index = Schedule.IndexOfByPredicate([&WeakWeapon](const FShooterScheduledShot& Shot)
+	{
+		return Shot.Weapon.HasSameIndexAndSerialNumber(WeakWeapon);
+	});
+
+	if (Index != INDEX_NONE)
+	{
+		Schedule.RemoveAt(Index, EAllowShrinking::No);
+	}
+}
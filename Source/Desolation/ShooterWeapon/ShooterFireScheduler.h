@@ -0,0 +1,92 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterFireScheduler.generated.h"
+
+class AShooterWeapon;
+
+/**
+ *  Fire time accumulator for a single weapon
+ *  Advances shot times by exactly the refire rate from the previous shot's due time, so every shot that falls
+ *  inside a frame is emitted with its own sub-frame timestamp and the rate of fire doesn't depend on the frame rate
+ */
+struct DESOLATION_API FShooterFireAccumulator
+{
+	/** Time the next shot is due */
+	double NextShotTime = 0.0;
+
+	/** Shots that came due past the per-frame cap and were dropped since the cadence started */
+	int32 NumDroppedShots = 0;
+
+	/** Restarts the cadence with the first shot due at the given time */
+	void Start(double FirstShotTime)
+	{
+		NextShotTime = FirstShotTime;
+		NumDroppedShots = 0;
+	}
+
+	/**
+	 *  Appends the due time of every shot up to Now and advances past them. Returns the number of shots
+	 *  If the shot cap is hit, the remaining backlog is dropped rather than carried into the next frame, and counted in NumDroppedShots
+	 */
+	int32 CollectDueShots(double Now, double RefireRate, TArray<double>& OutShotTimes, int32 MaxShots);
+};
+
+/**
+ *  A pending weapon refire or cooldown event
+ */
+struct FShooterScheduledShot
+{
+	/** World time when the event is due */
+	double ShotTime = 0.0;
+
+	/** Weapon to notify */
+	TWeakObjectPtr<AShooterWeapon> Weapon;
+
+	/** If true, the weapon only needs to be told its cooldown expired instead of firing */
+	bool bCooldownOnly = false;
+};
+
+/**
+ *  Drives the refire cadence of every firing weapon in the world
+ *  Keeps pending shots in a compact array sorted by shot time and fires every due shot in one pass per frame
+ *  instead of each weapon re-arming its own timer after every shot
+ */
+UCLASS()
+class DESOLATION_API UShooterFireScheduler : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+	/** Pending events, sorted by shot time */
+	TArray<FShooterScheduledShot> Schedule;
+
+	/** Scratch list of events that came due this frame */
+	TArray<FShooterScheduledShot> DueShots;
+
+public:
+
+	/** Fires every due shot */
+	virtual void Tick(float DeltaTime) override;
+
+	/** Returns the stat id for the tickable */
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/** Only schedule shots in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+public:
+
+	/** Schedules the weapon's next shot, or just its cooldown notification, replacing any pending event for it */
+	void ScheduleShot(AShooterWeapon* Weapon, double ShotTime, bool bCooldownOnly);
+
+	/** Removes any pending event for the weapon */
+	void CancelShot(AShooterWeapon* Weapon);
+
+	/** Returns the number of weapons with a pending event */
+	int32 GetNumScheduled() const { return Schedule.Num(); }
+};
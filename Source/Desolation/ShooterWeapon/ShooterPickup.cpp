@@ -3,37 +3,26 @@
 
 #include "ShooterWeapon/ShooterPickup.h"
 #include "Components/SceneComponent.h"
-#include "Components/SphereComponent.h"
 #include "Components/StaticMeshComponent.h"
 #include "ShooterWeaponHolder.h"
 #include "ShooterWeapon.h"
+#include "ShooterWeaponRegistry.h"
+#include "ShooterPickupManager.h"
 #include "Engine/World.h"
-#include "TimerManager.h"
 
 AShooterPickup::AShooterPickup()
 {
- 	PrimaryActorTick.bCanEverTick = true;
+	// the pickup manager checks pawns against us, so we don't need to tick
+	PrimaryActorTick.bCanEverTick = false;
 
 	// create the root
 	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
 
-	// create the collision sphere
-	SphereCollision = CreateDefaultSubobject<USphereComponent>(TEXT("Sphere Collision"));
-	SphereCollision->SetupAttachment(RootComponent);
-
-	SphereCollision->SetRelativeLocation(FVector(0.0f, 0.0f, 84.0f));
-	SphereCollision->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
-	SphereCollision->SetCollisionObjectType(ECC_WorldStatic);
-	SphereCollision->SetCollisionResponseToAllChannels(ECR_Ignore);
-	SphereCollision->SetCollisionResponseToChannel(ECC_Pawn, ECR_Overlap);
-	SphereCollision->bFillCollisionUnderneathForNavmesh = true;
-
-	// subscribe to the collision overlap on the sphere
-	SphereCollision->OnComponentBeginOverlap.AddDynamic(this, &AShooterPickup::OnOverlap);
-
 	// create the mesh
 	Mesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Mesh"));
-	Mesh->SetupAttachment(SphereCollision);
+	Mesh->SetupAttachment(RootComponent);
+
+	Mesh->SetRelativeLocation(FVector(0.0f, 0.0f, 84.0f));
 
 	Mesh->SetCollisionProfileName(FName("NoCollision"));
 }
@@ -42,21 +31,47 @@ void AShooterPickup::OnConstruction(const FTransform& Transform)
 {
 	Super::OnConstruction(Transform);
 
-	if (FWeaponTableRow* WeaponData = WeaponType.GetRow<FWeaponTableRow>(FString()))
+#if WITH_EDITOR
+	// preview the mesh in the editor. Game worlds stream it in through the weapon registry instead
+	if (!GetWorld() || !GetWorld()->IsGameWorld())
 	{
-		// set the mesh
-		Mesh->SetStaticMesh(WeaponData->StaticMesh.LoadSynchronous());
+		if (FWeaponTableRow* WeaponData = WeaponType.GetRow<FWeaponTableRow>(FString()))
+		{
+			Mesh->SetStaticMesh(WeaponData->StaticMesh.LoadSynchronous());
+		}
 	}
+#endif
 }
 
 void AShooterPickup::BeginPlay()
 {
 	Super::BeginPlay();
 
-	if (FWeaponTableRow* WeaponData = WeaponType.GetRow<FWeaponTableRow>(FString()))
+	if (UShooterWeaponRegistry* WeaponRegistry = UShooterWeaponRegistry::Get(this))
+	{
+		// find our weapon definition once
+		WeaponDefinitionIndex = WeaponRegistry->ResolveRow(WeaponType);
+
+		// stream in the mesh without blocking. The weapon class is prefetched once a weapon holder gets close
+		WeaponRegistry->RequestBundle(WeaponDefinitionIndex, EShooterWeaponBundle::Pickup, FSimpleDelegate::CreateUObject(this, &AShooterPickup::OnPickupMeshLoaded));
+	}
+
+	// let the pickup manager check pawns against us
+	if (UShooterPickupManager* PickupManager = GetWorld()->GetSubsystem<UShooterPickupManager>())
 	{
-		// copy the weapon class
-		WeaponClass = WeaponData->WeaponToSpawn;
+		PickupManagerSlot = PickupManager->RegisterPickup(this, GetActorLocation() + FVector(0.0f, 0.0f, PickupHeight), PickupRadius);
+	}
+}
+
+void AShooterPickup::OnPickupMeshLoaded()
+{
+	if (const UShooterWeaponRegistry* WeaponRegistry = UShooterWeaponRegistry::Get(this))
+	{
+		// spawned pickups start without a mesh
+		if (UStaticMesh* PickupMesh = WeaponRegistry->GetPickupMesh(WeaponDefinitionIndex))
+		{
+			Mesh->SetStaticMesh(PickupMesh);
+		}
 	}
 }
 
@@ -64,28 +79,51 @@ void AShooterPickup::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	Super::EndPlay(EndPlayReason);
 
-	// clear the respawn timer
-	GetWorld()->GetTimerManager().ClearTimer(RespawnTimer);
+	// leave the pickup manager. This also drops any pending respawn
+	if (UShooterPickupManager* PickupManager = GetWorld()->GetSubsystem<UShooterPickupManager>())
+	{
+		PickupManager->UnregisterPickup(PickupManagerSlot);
+	}
 }
 
-void AShooterPickup::OnOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+void AShooterPickup::PrefetchWeapon()
 {
-	// have we collided against a weapon holder?
-	if (IShooterWeaponHolder* WeaponHolder = Cast<IShooterWeaponHolder>(OtherActor))
+	if (UShooterWeaponRegistry* WeaponRegistry = UShooterWeaponRegistry::Get(this))
 	{
-		WeaponHolder->AddWeaponClass(WeaponClass);
+		WeaponRegistry->RequestBundle(WeaponDefinitionIndex, EShooterWeaponBundle::Equip, FSimpleDelegate());
+	}
+}
 
-		// hide this mesh
-		SetActorHiddenInGame(true);
+void AShooterPickup::GrantTo(IShooterWeaponHolder* WeaponHolder)
+{
+	UShooterWeaponRegistry* WeaponRegistry = UShooterWeaponRegistry::Get(this);
+	const TSubclassOf<AShooterWeapon> WeaponClass = WeaponRegistry ? WeaponRegistry->GetWeaponClass(WeaponDefinitionIndex) : nullptr;
 
-		// disable collision
-		SetActorEnableCollision(false);
+	if (WeaponRegistry)
+	{
+		WeaponRegistry->RecordGrantAttempt(WeaponDefinitionIndex, WeaponClass != nullptr);
+	}
 
-		// disable ticking
-		SetActorTickEnabled(false);
+	// the weapon class is still streaming in, so leave the pickup in place rather than block on it
+	if (!WeaponClass)
+	{
+		// in case the prefetch never started
+		PrefetchWeapon();
+		return;
+	}
+
+	WeaponHolder->AddWeaponClass(WeaponClass);
+
+	// hide this mesh
+	SetActorHiddenInGame(true);
 
-		// schedule the respawn
-		GetWorld()->GetTimerManager().SetTimer(RespawnTimer, this, &AShooterPickup::RespawnPickup, RespawnTime, false);
+	// stop the pickup manager from granting us again
+	bAvailable = false;
+
+	// schedule the respawn
+	if (UShooterPickupManager* PickupManager = GetWorld()->GetSubsystem<UShooterPickupManager>())
+	{
+		PickupManager->ScheduleRespawn(PickupManagerSlot, RespawnTime);
 	}
 }
 
@@ -100,9 +138,6 @@ void AShooterPickup::RespawnPickup()
 
 void AShooterPickup::FinishRespawn()
 {
-	// enable collision
-	SetActorEnableCollision(true);
-
-	// enable tick
-	SetActorTickEnabled(true);
+	// let the pickup manager grant us again
+	bAvailable = true;
 }
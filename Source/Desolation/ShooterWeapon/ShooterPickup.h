@@ -8,9 +8,8 @@
 #include "Engine/StaticMesh.h"
 #include "ShooterPickup.generated.h"
 
-class USphereComponent;
-class UPrimitiveComponent;
 class AShooterWeapon;
+class IShooterWeaponHolder;
 
 /**
  *  Holds information about a type of weapon pickup
@@ -24,9 +23,9 @@ struct FWeaponTableRow : public FTableRowBase
 	UPROPERTY(EditAnywhere)
 	TSoftObjectPtr<UStaticMesh> StaticMesh;
 
-	/** Weapon class to grant on pickup */
+	/** Weapon class to grant on pickup. Streamed in through the weapon registry */
 	UPROPERTY(EditAnywhere)
-	TSubclassOf<AShooterWeapon> WeaponToSpawn;
+	TSoftClassPtr<AShooterWeapon> WeaponToSpawn;
 };
 
 /**
@@ -37,10 +36,6 @@ class DESOLATION_API AShooterPickup : public AActor
 {
 	GENERATED_BODY()
 
-	/** Collision sphere */
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Components", meta = (AllowPrivateAccess = "true"))
-	USphereComponent* SphereCollision;
-
 	/** Weapon pickup mesh. Its mesh asset is set from the weapon data table */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category="Components", meta = (AllowPrivateAccess = "true"))
 	UStaticMeshComponent* Mesh;
@@ -51,15 +46,26 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Pickup")
 	FDataTableRowHandle WeaponType;
 
-	/** Type to weapon to grant on pickup. Set from the weapon data table. */
-	TSubclassOf<AShooterWeapon> WeaponClass;
+	/** Index of this pickup's weapon definition in the weapon registry */
+	int32 WeaponDefinitionIndex = INDEX_NONE;
 	
 	/** Time to wait before respawning this pickup */
 	UPROPERTY(EditAnywhere, Category="Pickup")
 	float RespawnTime = 4.0f;
 
-	/** Timer to respawn the pickup */
-	FTimerHandle RespawnTimer;
+	/** Radius around the pickup center that weapon holders can grab it from */
+	UPROPERTY(EditAnywhere, Category="Pickup", meta = (ClampMin = 0, Units = "cm"))
+	float PickupRadius = 32.0f;
+
+	/** Height of the pickup center above the actor location */
+	UPROPERTY(EditAnywhere, Category="Pickup", meta = (Units = "cm"))
+	float PickupHeight = 84.0f;
+
+	/** Slot of this pickup in the world pickup manager */
+	int32 PickupManagerSlot = INDEX_NONE;
+
+	/** If true, this pickup can currently be picked up */
+	bool bAvailable = true;
 
 public:	
 	
@@ -77,15 +83,25 @@ protected:
 	/** Gameplay cleanup */
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
-	/** Handles collision overlap */
-	UFUNCTION()
-	virtual void OnOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+	/** Called once the pickup mesh has streamed in */
+	void OnPickupMeshLoaded();
 
-protected:
+public:
 
-	/** Called when it's time to respawn this pickup */
+	/** Returns true if this pickup can currently be picked up */
+	bool IsAvailable() const { return bAvailable; }
+
+	/** Starts streaming in the weapon class ahead of a grant. Called by the pickup manager when a weapon holder gets close */
+	void PrefetchWeapon();
+
+	/** Grants this pickup's weapon to a weapon holder in range. Called by the pickup manager */
+	virtual void GrantTo(IShooterWeaponHolder* WeaponHolder);
+
+	/** Called by the pickup manager when it's time to respawn this pickup */
 	void RespawnPickup();
 
+protected:
+
 	/** Passes control to Blueprint to animate the pickup respawn. Should end by calling FinishRespawn */
 	UFUNCTION(BlueprintImplementableEvent, Category="Pickup", meta=(DisplayName = "OnRespawn"))
 	void BP_OnRespawn();
@@ -0,0 +1,310 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterWeapon/ShooterPickupManager.h"
+#include "ShooterPickup.h"
+#include "ShooterWeaponHolder.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/Pawn.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Shooter Pickup Manager"), STAT_ShooterPickupManager, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pickup Distance Checks"), STAT_ShooterPickupChecks, STATGROUP_Game);
+
+/** Size of a pickup grid cell, in cm */
+static constexpr float ShooterPickupCellSize = 1000.0f;
+
+/** Time represented by one respawn wheel tick, in seconds */
+static constexpr double ShooterPickupRespawnResolution = 0.05;
+
+/** Pickup ids pack the slot in the low bits and the slot generation in the high bits */
+static constexpr int32 ShooterPickupSlotBits = 20;
+static constexpr int32 ShooterPickupSlotMask = (1 << ShooterPickupSlotBits) - 1;
+static constexpr uint32 ShooterPickupGenerationMask = (1u << (31 - ShooterPickupSlotBits)) - 1;
+
+static float GShooterPickupPollInterval = 0.1f;
+static FAutoConsoleVariableRef CVarShooterPickupPollInterval(
+	TEXT("Shooter.Pickups.PollInterval"),
+	GShooterPickupPollInterval,
+	TEXT("Time in seconds between checks of weapon holding pawns against nearby pickups"));
+
+static float GShooterPickupPrefetchRadius = 2000.0f;
+static FAutoConsoleVariableRef CVarShooterPickupPrefetchRadius(
+	TEXT("Shooter.Pickups.PrefetchRadius"),
+	GShooterPickupPrefetchRadius,
+	TEXT("Distance in cm at which weapon holding pawns start streaming in a pickup's weapon. Zero loads weapons on first touch instead"));
+
+FShooterTimingWheel::FShooterTimingWheel()
+{
+	Slots.SetNum(NumLevels * SlotsPerLevel);
+}
+
+void FShooterTimingWheel::Schedule(int32 Id, uint64 DueTick)
+{
+	// anything already due fires on the next advance
+	Insert({ FMath::Max(DueTick, CurrentTick + 1), Id });
+
+	++NumScheduled;
+}
+
+void FShooterTimingWheel::Insert(const FEntry& Entry)
+{
+	const uint64 Delta = Entry.DueTick - CurrentTick;
+
+	// find the lowest level whose span covers the delay
+	int32 Level = 0;
+
+	while (Level < NumLevels - 1 && Delta >= (uint64(1) << (BitsPerLevel * (Level + 1))))
+	{
+		++Level;
+	}
+
+	const int32 Slot = static_cast<int32>((Entry.DueTick >> (BitsPerLevel * Level)) & (SlotsPerLevel - 1));
+
+	GetSlot(Level, Slot).Add(Entry);
+}
+
+void FShooterTimingWheel::Advance(uint64 TargetTick, TArray<int32>& OutDue)
+{
+	// with nothing scheduled we can jump straight to the target
+	if (NumScheduled == 0)
+	{
+		CurrentTick = FMath::Max(CurrentTick, TargetTick);
+		return;
+	}
+
+	while (CurrentTick < TargetTick)
+	{
+		++CurrentTick;
+
+		// when a level wraps, pull the next slot of the level above down into the lower levels
+		for (int32 Level = 1; Level < NumLevels; ++Level)
+		{
+			const uint64 LevelMask = (uint64(1) << (BitsPerLevel * Level)) - 1;
+
+			if ((CurrentTick & LevelMask) != 0)
+			{
+				break;
+			}
+
+			TArray<FEntry>& Slot = GetSlot(Level, static_cast<int32>((CurrentTick >> (BitsPerLevel * Level)) & (SlotsPerLevel - 1)));
+
+			Cascade.Reset();
+			Cascade.Append(Slot);
+			Slot.Reset();
+
+			for (const FEntry& Entry : Cascade)
+			{
+				if (Entry.DueTick <= CurrentTick)
+				{
+					OutDue.Add(Entry.Id);
+					--NumScheduled;
+
+				} else {
+
+					Insert(Entry);
+				}
+			}
+		}
+
+		// fire this tick's slot
+		TArray<FEntry>& Slot = GetSlot(0, static_cast<int32>(CurrentTick & (SlotsPerLevel - 1)));
+
+		for (const FEntry& Entry : Slot)
+		{
+			OutDue.Add(Entry.Id);
+		}
+
+		NumScheduled -= Slot.Num();
+		Slot.Reset();
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+void UShooterPickupManager::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterPickupManager);
+
+	// check pawns against pickups at a fixed rate
+	PollAccumulator += DeltaTime;
+
+	if (PollAccumulator >= GShooterPickupPollInterval)
+	{
+		PollAccumulator = FMath::Fmod(PollAccumulator, FMath::Max(GShooterPickupPollInterval, UE_KINDA_SMALL_NUMBER));
+
+		PollPawns();
+	}
+
+	// respawn any pickups that are due
+	DueRespawns.Reset();
+	RespawnWheel.Advance(static_cast<uint64>(GetWorld()->GetTimeSeconds() / ShooterPickupRespawnResolution), DueRespawns);
+
+	for (const int32 Id : DueRespawns)
+	{
+		const int32 Slot = Id & ShooterPickupSlotMask;
+		const uint32 Generation = static_cast<uint32>(Id) >> ShooterPickupSlotBits;
+
+		// ignore respawns for slots that have been reused since they were scheduled
+		if (!Pickups.IsValidIndex(Slot) || (Pickups[Slot].Generation & ShooterPickupGenerationMask) != Generation)
+		{
+			continue;
+		}
+
+		if (AShooterPickup* Pickup = Pickups[Slot].Pickup.Get())
+		{
+			Pickup->RespawnPickup();
+		}
+	}
+}
+
+TStatId UShooterPickupManager::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterPickupManager, STATGROUP_Tickables);
+}
+
+bool UShooterPickupManager::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+int32 UShooterPickupManager::RegisterPickup(AShooterPickup* Pickup, const FVector& Center, float Radius)
+{
+	// reuse a free slot if we have one
+	const int32 Slot = FreeSlots.Num() > 0 ? FreeSlots.Pop(EAllowShrinking::No) : Pickups.AddDefaulted();
+
+	FShooterManagedPickup& Managed = Pickups[Slot];
+	Managed.Pickup = Pickup;
+	Managed.Center = Center;
+	Managed.Radius = Radius;
+	Managed.Cell = GetCell(Center);
+	Managed.bPrefetched = false;
+
+	Cells.FindOrAdd(Managed.Cell).Add(Slot);
+
+	MaxPickupRadius = FMath::Max(MaxPickupRadius, Radius);
+
+	return Slot;
+}
+
+void UShooterPickupManager::UnregisterPickup(int32 Slot)
+{
+	if (!Pickups.IsValidIndex(Slot))
+	{
+		return;
+	}
+
+	FShooterManagedPickup& Managed = Pickups[Slot];
+
+	if (TArray<int32>* CellSlots = Cells.Find(Managed.Cell))
+	{
+		CellSlots->RemoveSingleSwap(Slot, EAllowShrinking::No);
+	}
+
+	// bump the generation so any pending respawn is ignored
+	Managed.Pickup.Reset();
+	++Managed.Generation;
+
+	FreeSlots.Add(Slot);
+}
+
+void UShooterPickupManager::ScheduleRespawn(int32 Slot, float Delay)
+{
+	if (!Pickups.IsValidIndex(Slot))
+	{
+		return;
+	}
+
+	const int32 Id = Slot | static_cast<int32>((Pickups[Slot].Generation & ShooterPickupGenerationMask) << ShooterPickupSlotBits);
+	const double DueTime = GetWorld()->GetTimeSeconds() + Delay;
+
+	RespawnWheel.Schedule(Id, static_cast<uint64>(FMath::CeilToDouble(DueTime / ShooterPickupRespawnResolution)));
+}
+
+void UShooterPickupManager::PollPawns()
+{
+	if (Cells.IsEmpty())
+	{
+		return;
+	}
+
+	int32 NumChecks = 0;
+
+	for (FConstControllerIterator It = GetWorld()->GetControllerIterator(); It; ++It)
+	{
+		APawn* Pawn = It->IsValid() ? (*It)->GetPawn() : nullptr;
+		IShooterWeaponHolder* WeaponHolder = Cast<IShooterWeaponHolder>(Pawn);
+
+		if (!WeaponHolder)
+		{
+			continue;
+		}
+
+		float PawnRadius, PawnHalfHeight;
+		Pawn->GetSimpleCollisionCylinder(PawnRadius, PawnHalfHeight);
+
+		const FVector PawnLocation = Pawn->GetActorLocation();
+
+		// only visit cells a pickup could reach the pawn from, or close enough to start prefetching
+		const float Reach = FMath::Max(MaxPickupRadius + PawnRadius, GShooterPickupPrefetchRadius);
+		const FIntPoint MinCell = GetCell(PawnLocation - FVector(Reach, Reach, 0.0f));
+		const FIntPoint MaxCell = GetCell(PawnLocation + FVector(Reach, Reach, 0.0f));
+
+		for (int32 CellX = MinCell.X; CellX <= MaxCell.X; ++CellX)
+		{
+			for (int32 CellY = MinCell.Y; CellY <= MaxCell.Y; ++CellY)
+			{
+				const TArray<int32>* CellSlots = Cells.Find(FIntPoint(CellX, CellY));
+
+				if (!CellSlots)
+				{
+					continue;
+				}
+
+				for (const int32 Slot : *CellSlots)
+				{
+					FShooterManagedPickup& Managed = Pickups[Slot];
+					AShooterPickup* Pickup = Managed.Pickup.Get();
+
+					if (!Pickup)
+					{
+						continue;
+					}
+
+					++NumChecks;
+
+					const FVector Offset = PawnLocation - Managed.Center;
+
+					// start streaming the weapon in before the pawn gets to it. Respawning pickups are prefetched too
+					if (!Managed.bPrefetched && Offset.SizeSquared() <= FMath::Square(GShooterPickupPrefetchRadius))
+					{
+						Managed.bPrefetched = true;
+						Pickup->PrefetchWeapon();
+					}
+
+					if (!Pickup->IsAvailable())
+					{
+						continue;
+					}
+
+					// test the pickup sphere against the pawn's collision cylinder
+					const float HorizontalReach = Managed.Radius + PawnRadius;
+					const float VerticalReach = Managed.Radius + PawnHalfHeight;
+
+					if (Offset.SizeSquared2D() <= FMath::Square(HorizontalReach) && FMath::Abs(Offset.Z) <= VerticalReach)
+					{
+						Pickup->GrantTo(WeaponHolder);
+					}
+				}
+			}
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_ShooterPickupChecks, NumChecks);
+}
+
+FIntPoint UShooterPickupManager::GetCell(const FVector& Location)
+{
+	return FIntPoint(FMath::FloorToInt32(Location.X / ShooterPickupCellSize), FMath::FloorToInt32(Location.Y / ShooterPickupCellSize));
+}
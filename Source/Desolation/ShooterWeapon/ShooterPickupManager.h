@@ -0,0 +1,157 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterPickupManager.generated.h"
+
+class AShooterPickup;
+
+/**
+ *  Hierarchical timing wheel
+ *  Schedules integer ids on a fixed tick resolution. Each level has 64 slots, and each slot on a level spans a full
+ *  turn of the level below, so scheduling and firing are constant time regardless of the number of pending ids
+ */
+struct DESOLATION_API FShooterTimingWheel
+{
+	/** Number of slots per level. Must be a power of two */
+	static constexpr int32 SlotsPerLevel = 64;
+
+	/** Bits addressed by one level */
+	static constexpr int32 BitsPerLevel = 6;
+
+	/** Number of levels. Delays longer than the top level can span cycle through it until due */
+	static constexpr int32 NumLevels = 3;
+
+	/** Constructor */
+	FShooterTimingWheel();
+
+	/** Schedules an id to fire on the given tick */
+	void Schedule(int32 Id, uint64 DueTick);
+
+	/** Advances to the given tick and collects every id that came due */
+	void Advance(uint64 TargetTick, TArray<int32>& OutDue);
+
+	/** Returns the current tick */
+	uint64 GetCurrentTick() const { return CurrentTick; }
+
+	/** Returns the number of scheduled ids */
+	int32 GetNumScheduled() const { return NumScheduled; }
+
+protected:
+
+	/** A scheduled id */
+	struct FEntry
+	{
+		uint64 DueTick;
+		int32 Id;
+	};
+
+	/** Returns the slot list for a level and slot */
+	TArray<FEntry>& GetSlot(int32 Level, int32 Slot) { return Slots[Level * SlotsPerLevel + Slot]; }
+
+	/** Places an entry on the lowest level that can hold it */
+	void Insert(const FEntry& Entry);
+
+	/** Slot lists for every level */
+	TArray<TArray<FEntry>> Slots;
+
+	/** Scratch list for cascading entries down a level */
+	TArray<FEntry> Cascade;
+
+	/** Last tick processed */
+	uint64 CurrentTick = 0;
+
+	/** Number of scheduled ids */
+	int32 NumScheduled = 0;
+};
+
+/**
+ *  A pickup tracked by the pickup manager
+ */
+struct FShooterManagedPickup
+{
+	/** Managed pickup */
+	TWeakObjectPtr<AShooterPickup> Pickup;
+
+	/** World space center of the pickup volume */
+	FVector Center = FVector::ZeroVector;
+
+	/** Radius of the pickup volume */
+	float Radius = 0.0f;
+
+	/** Grid cell the pickup is stored in */
+	FIntPoint Cell = FIntPoint::ZeroValue;
+
+	/** Incremented whenever the slot is reused, so stale respawns can be ignored */
+	uint32 Generation = 0;
+
+	/** If true, the pickup's weapon has already been requested for prefetching */
+	bool bPrefetched = false;
+};
+
+/**
+ *  Manages every weapon pickup in the world
+ *  Stores pickups in a uniform grid and checks weapon holding pawns against nearby cells at a fixed rate,
+ *  and schedules respawns through a single timing wheel instead of per-pickup overlaps, ticks and timers.
+ *  Pawns approaching a pickup also start streaming its weapon in, so the grant doesn't have to wait on it
+ */
+UCLASS()
+class DESOLATION_API UShooterPickupManager : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+	/** Managed pickups. Unregistered slots are reused */
+	TArray<FShooterManagedPickup> Pickups;
+
+	/** Unused pickup slots */
+	TArray<int32> FreeSlots;
+
+	/** Uniform grid of pickup slots */
+	TMap<FIntPoint, TArray<int32>> Cells;
+
+	/** Largest registered pickup radius, used to size grid queries */
+	float MaxPickupRadius = 0.0f;
+
+	/** Respawn schedule. Ids encode the pickup slot and its generation */
+	FShooterTimingWheel RespawnWheel;
+
+	/** Scratch list of respawns that came due */
+	TArray<int32> DueRespawns;
+
+	/** Time accumulated towards the next pawn poll */
+	float PollAccumulator = 0.0f;
+
+public:
+
+	/** Polls pawns and respawns pickups */
+	virtual void Tick(float DeltaTime) override;
+
+	/** Returns the stat id for the tickable */
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/** Only manage pickups in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+public:
+
+	/** Adds a pickup to the grid and returns its slot */
+	int32 RegisterPickup(AShooterPickup* Pickup, const FVector& Center, float Radius);
+
+	/** Removes a pickup from the grid. Any pending respawn is dropped */
+	void UnregisterPickup(int32 Slot);
+
+	/** Schedules a pickup to respawn after the given delay */
+	void ScheduleRespawn(int32 Slot, float Delay);
+
+protected:
+
+	/** Checks every weapon holding pawn against pickups in nearby cells */
+	void PollPawns();
+
+	/** Returns the grid cell containing a location */
+	static FIntPoint GetCell(const FVector& Location);
+};
@@ -5,10 +5,27 @@
 #include "Components/SphereComponent.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "GameFramework/Character.h"
-#include "Kismet/GameplayStatics.h"
 #include "GameFramework/DamageType.h"
 #include "GameFramework/Pawn.h"
 #include "GameFramework/Controller.h"
+#include "ShooterProjectilePool.h"
+#include "ShooterCollisionChannels.h"
+#include "PhysicalMaterials/PhysicalMaterial.h"
+#include "Engine/World.h"
+#include "Combat/ShooterDamageSubsystem.h"
+#include "Combat/ShooterRadialDamageType.h"
+#include "Combat/ShooterNoiseSubsystem.h"
+#include "TimerManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Ballistic Projectile Update"), STAT_ShooterBallisticUpdate, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Ballistic Sweeps"), STAT_ShooterBallisticSweeps, STATGROUP_Game);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Ballistic Penetrations"), STAT_ShooterBallisticPenetrations, STATGROUP_Game);
+
+/** Max ballistic segments swept in a single frame, so a long hitch can't stall the game thread */
+static constexpr int32 ShooterMaxBallisticSweepsPerFrame = 8;
+
+/** Distance off the hit surface explosions start from, in cm */
+static constexpr float ShooterRadialDamageSurfaceOffset = 5.0f;
 
 AShooterProjectile::AShooterProjectile()
 {
@@ -39,9 +56,64 @@ void AShooterProjectile::BeginPlay()
 	
 	// ignore the pawn that shot this projectile
 	CollisionComponent->IgnoreActorWhenMoving(GetInstigator(), true);
+
+	// save the collision mode so the pool can restore it
+	PooledCollisionEnabled = CollisionComponent->GetCollisionEnabled();
+
+	// fly the analytic trajectory instead of integrating movement
+	if (bUseBallistics)
+	{
+		StartBallisticFlight();
+	}
+}
+
+void AShooterProjectile::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	// clear the pool return timer
+	GetWorldTimerManager().ClearTimer(PoolReturnTimer);
+
+	// make sure the pool doesn't hand us out after we're gone
+	if (UShooterProjectilePoolSubsystem* Pool = OwningPool.Get())
+	{
+		Pool->ForgetProjectile(this);
+	}
+}
+
+void AShooterProjectile::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (bBallisticFlight)
+	{
+		UpdateBallisticFlight(DeltaSeconds);
+	}
+}
+
+void AShooterProjectile::LifeSpanExpired()
+{
+	// pooled projectiles are recycled instead of destroyed
+	if (OwningPool.IsValid())
+	{
+		ReturnToPool();
+		return;
+	}
+
+	Super::LifeSpanExpired();
 }
 
 void AShooterProjectile::NotifyHit(class UPrimitiveComponent* MyComp, AActor* Other, class UPrimitiveComponent* OtherComp, bool bSelfMoved, FVector HitLocation, FVector HitNormal, FVector NormalImpulse, const FHitResult& Hit)
+{
+	ProcessHit(Other, OtherComp, GetVelocity(), Hit);
+}
+
+void AShooterProjectile::ResolveSimulatedHit(const FHitResult& Hit, const FVector& ImpactVelocity)
+{
+	ProcessHit(Hit.GetActor(), Hit.GetComponent(), ImpactVelocity, Hit);
+}
+
+void AShooterProjectile::ProcessHit(AActor* Other, UPrimitiveComponent* OtherComp, const FVector& ImpactVelocity, const FHitResult& Hit)
 {
 	// ignore if we've already hit something else
 	if (bHit)
@@ -50,20 +122,42 @@ void AShooterProjectile::NotifyHit(class UPrimitiveComponent* MyComp, AActor* Ot
 	}
 
 	bHit = true;
+	bBallisticFlight = false;
+
+	ApplyImpactEffects(Other, OtherComp, ImpactVelocity, Hit);
+
+	// disable collision on the projectile
+	CollisionComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+
+	// recycle pooled projectiles once the movement component is done processing this hit
+	if (OwningPool.IsValid())
+	{
+		PoolReturnTimer = GetWorldTimerManager().SetTimerForNextTick(this, &AShooterProjectile::ReturnToPool);
+	}
+}
 
+void AShooterProjectile::ApplyImpactEffects(AActor* Other, UPrimitiveComponent* OtherComp, const FVector& ImpactVelocity, const FHitResult& Hit)
+{
 	// make AI perception noise
-	MakeNoise(NoiseLoudness, GetInstigator(), GetActorLocation(), NoiseRange, NoiseTag);
+	UShooterNoiseSubsystem::ReportOrMakeNoise(this, NoiseLoudness, GetInstigator(), Hit.ImpactPoint, NoiseRange, NoiseTag);
 
 	// have we hit a physics object?
-	if (OtherComp->IsSimulatingPhysics())
+	if (OtherComp && OtherComp->IsSimulatingPhysics())
 	{
 		// give some physics impulse to the object
-		OtherComp->AddImpulseAtLocation(GetVelocity() * PhysicsForce, Hit.ImpactPoint);
+		OtherComp->AddImpulseAtLocation(ImpactVelocity * PhysicsForce, Hit.ImpactPoint);
 	}
 
-	// have we hit a character?
-	if (ACharacter* HitCharacter = Cast<ACharacter>(Other))
+	// do we explode?
+	if (HitDamageType && HitDamageType->IsChildOf<UShooterRadialDamageType>())
 	{
+		// damage everyone around the impact, starting just off the surface so the occlusion tests don't hit it
+		UShooterDamageSubsystem::QueueOrApplyRadialDamage(GetWorld(), Hit.ImpactPoint + Hit.ImpactNormal * ShooterRadialDamageSurfaceOffset, HitDamage * HitDamageScale,
+			GetInstigatorController(), this, TSubclassOf<UShooterRadialDamageType>(HitDamageType.Get()), GetOwner());
+
+	// have we hit a character?
+	} else if (ACharacter* HitCharacter = Cast<ACharacter>(Other)) {
+
 		// ignore the owner of this projectile
 		if (HitCharacter != GetOwner())
 		{
@@ -72,8 +166,8 @@ void AShooterProjectile::NotifyHit(class UPrimitiveComponent* MyComp, AActor* Ot
 		}
 	}
 
-	// disable collision on the projectile
-	CollisionComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	// spawn the impact effects, deduplicated and budgeted with every other impact this frame
+	UShooterImpactEffectsSubsystem::QueueImpact(GetWorld(), Hit, ImpactEffects);
 
 	// pass control to BP for any extra effects
 	BP_OnProjectileHit(Hit);
@@ -81,6 +175,254 @@ void AShooterProjectile::NotifyHit(class UPrimitiveComponent* MyComp, AActor* Ot
 
 void AShooterProjectile::DamageCharacter(ACharacter* HitCharacter, const FHitResult& Hit)
 {
-	// apply damage to the character
-	UGameplayStatics::ApplyDamage(HitCharacter, HitDamage, GetInstigator()->GetController(), this, HitDamageType);
+	// queue the damage so it's applied after this collision callback, merged with any other hits this frame
+	UShooterDamageSubsystem::QueueOrApplyDamage(GetWorld(), HitCharacter, HitDamage * HitDamageScale, GetInstigatorController(), this, HitDamageType);
+}
+
+void AShooterProjectile::ReturnToPool()
+{
+	if (UShooterProjectilePoolSubsystem* Pool = OwningPool.Get())
+	{
+		Pool->ReleaseProjectile(this);
+
+	} else {
+
+		Destroy();
+	}
+}
+
+void AShooterProjectile::OnAcquiredFromPool(const FTransform& SpawnTransform, AActor* NewOwner, APawn* NewInstigator, bool bLaunch)
+{
+	// clear any pending return from a previous use
+	GetWorldTimerManager().ClearTimer(PoolReturnTimer);
+
+	bPoolActive = true;
+	bHit = false;
+	bBallisticFlight = false;
+	HitDamageScale = 1.0f;
+
+	// move into place before collision is restored so we don't sweep from the last position
+	SetActorTransform(SpawnTransform, false, nullptr, ETeleportType::ResetPhysics);
+
+	// update the shooter
+	SetOwner(NewOwner);
+	SetInstigator(NewInstigator);
+
+	// impact proxies only need to be in place to resolve a hit, so they stay asleep
+	if (!bLaunch)
+	{
+		// freshly spawned proxies start moving on BeginPlay, so stop them
+		ProjectileMovement->StopMovementImmediately();
+		ProjectileMovement->Deactivate();
+		SetActorEnableCollision(false);
+		SetActorHiddenInGame(true);
+		SetLifeSpan(0.0f);
+		return;
+	}
+
+	// ignore the new shooter and restore collision
+	CollisionComponent->ClearMoveIgnoreActors();
+	CollisionComponent->IgnoreActorWhenMoving(NewInstigator, true);
+	CollisionComponent->SetCollisionEnabled(PooledCollisionEnabled);
+	SetActorEnableCollision(true);
+
+	// wake up
+	SetActorHiddenInGame(false);
+	SetActorTickEnabled(true);
+
+	// restart the lifespan countdown
+	SetLifeSpan(InitialLifeSpan);
+
+	// ballistic projectiles fly on their own
+	if (bUseBallistics)
+	{
+		StartBallisticFlight();
+		return;
+	}
+
+	// relaunch along the new facing. The movement component drops its updated component when it stops simulating
+	ProjectileMovement->SetUpdatedComponent(CollisionComponent);
+	ProjectileMovement->SetVelocityInLocalSpace(FVector::ForwardVector * ProjectileMovement->InitialSpeed);
+	ProjectileMovement->Activate(true);
+}
+
+void AShooterProjectile::OnReleasedToPool()
+{
+	bPoolActive = false;
+	bBallisticFlight = false;
+	PendingBallisticImpacts.Reset();
+
+	// stop any pending timeouts
+	GetWorldTimerManager().ClearTimer(PoolReturnTimer);
+	SetLifeSpan(0.0f);
+
+	// stop moving
+	ProjectileMovement->StopMovementImmediately();
+	ProjectileMovement->Deactivate();
+
+	// disable collision
+	CollisionComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SetActorEnableCollision(false);
+
+	// go to sleep
+	SetActorHiddenInGame(true);
+	SetActorTickEnabled(false);
+}
+
+void AShooterProjectile::StartBallisticFlight()
+{
+	// the trajectory is evaluated in closed form, so the movement component and the collision sphere sit idle
+	ProjectileMovement->StopMovementImmediately();
+	ProjectileMovement->Deactivate();
+	CollisionComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+
+	BallisticOrigin = GetActorLocation();
+	BallisticVelocity = GetActorForwardVector() * ProjectileMovement->InitialSpeed;
+	BallisticGravityZ = GetWorld()->GetGravityZ() * ProjectileMovement->ProjectileGravityScale;
+
+	BallisticFlightTime = 0.0;
+	BallisticSweptTime = 0.0;
+	bBallisticStopFound = false;
+	PendingBallisticImpacts.Reset();
+
+	RemainingPenetrationDepth = PenetrationDepth;
+	NumPenetrations = 0;
+	HitDamageScale = 1.0f;
+
+	// reuse the same params for every sweep. Penetrated surfaces are added to the ignore list as they're found
+	BallisticQueryParams = FCollisionQueryParams(SCENE_QUERY_STAT(ShooterBallisticSweep), false, this);
+	BallisticQueryParams.AddIgnoredActor(GetInstigator());
+	BallisticQueryParams.bReturnPhysicalMaterial = true;
+
+	bBallisticFlight = true;
+	SetActorTickEnabled(true);
+}
+
+void AShooterProjectile::UpdateBallisticFlight(float DeltaSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_ShooterBallisticUpdate);
+
+	BallisticFlightTime += DeltaSeconds;
+
+	// sweep far enough ahead to cover this frame's position
+	for (int32 Sweep = 0; Sweep < ShooterMaxBallisticSweepsPerFrame && !bBallisticStopFound && BallisticSweptTime < BallisticFlightTime; ++Sweep)
+	{
+		const double SegmentEnd = BallisticSweptTime + BallisticSweepInterval;
+
+		SweepBallisticSegment(BallisticSweptTime, SegmentEnd);
+		BallisticSweptTime = SegmentEnd;
+	}
+
+	// resolve the surfaces we've reached, in flight order
+	int32 NumReached = 0;
+
+	for (const FShooterBallisticImpact& Impact : PendingBallisticImpacts)
+	{
+		if (Impact.FlightTime > BallisticFlightTime)
+		{
+			break;
+		}
+
+		++NumReached;
+		HitDamageScale = Impact.DamageScale;
+
+		if (Impact.bPenetrates)
+		{
+			ApplyImpactEffects(Impact.Hit.GetActor(), Impact.Hit.GetComponent(), Impact.Velocity, Impact.Hit);
+			continue;
+		}
+
+		// stop at the surface
+		SetActorLocation(Impact.Hit.ImpactPoint, false, nullptr, ETeleportType::TeleportPhysics);
+		ProcessHit(Impact.Hit.GetActor(), Impact.Hit.GetComponent(), Impact.Velocity, Impact.Hit);
+		PendingBallisticImpacts.Reset();
+		return;
+	}
+
+	PendingBallisticImpacts.RemoveAt(0, NumReached, EAllowShrinking::No);
+
+	// place the projectile on the trajectory without sweeping
+	const FVector Velocity = GetBallisticVelocity(BallisticFlightTime);
+	SetActorLocationAndRotation(GetBallisticLocation(BallisticFlightTime), Velocity.Rotation(), false, nullptr, ETeleportType::TeleportPhysics);
+}
+
+void AShooterProjectile::SweepBallisticSegment(double StartTime, double EndTime)
+{
+	INC_DWORD_STAT(STAT_ShooterBallisticSweeps);
+
+	// approximate the drop curve with a straight chord. The error is gravity * interval^2 / 8, well under a centimeter at the default interval
+	const FVector Start = GetBallisticLocation(StartTime);
+	const FVector End = GetBallisticLocation(EndTime);
+
+	// sweep the projectile's own collision sphere, overlapping everything that blocks projectiles,
+	// so one multi-hit query returns every surface along the segment the projectile would have touched
+	TArray<FHitResult> Hits;
+	const FCollisionResponseParams ResponseParams(ECR_Overlap);
+
+	GetWorld()->SweepMultiByChannel(Hits, Start, End, FQuat::Identity, Shooter_ObjectChannel_Projectile, CollisionComponent->GetCollisionShape(), BallisticQueryParams, ResponseParams);
+
+	Hits.Sort([](const FHitResult& A, const FHitResult& B) { return A.Time < B.Time; });
+
+	const FVector Direction = (End - Start).GetSafeNormal();
+
+	for (const FHitResult& Hit : Hits)
+	{
+		UPrimitiveComponent* HitComponent = Hit.GetComponent();
+
+		// only surfaces that would have blocked the projectile count
+		if (!HitComponent || HitComponent->GetCollisionResponseToChannel(Shooter_ObjectChannel_Projectile) != ECR_Block)
+		{
+			continue;
+		}
+
+		FShooterBallisticImpact& Impact = PendingBallisticImpacts.AddDefaulted_GetRef();
+		Impact.FlightTime = FMath::Lerp(StartTime, EndTime, static_cast<double>(Hit.Time));
+		Impact.Hit = Hit;
+		Impact.Velocity = GetBallisticVelocity(Impact.FlightTime);
+		Impact.DamageScale = HitDamageScale;
+		Impact.bPenetrates = TryPenetrate(Hit, Direction);
+
+		if (!Impact.bPenetrates)
+		{
+			bBallisticStopFound = true;
+			return;
+		}
+
+		// later surfaces take reduced damage, and the penetrated surface is never hit again
+		HitDamageScale *= PenetrationDamageScale;
+		BallisticQueryParams.AddIgnoredComponent(HitComponent);
+	}
+}
+
+bool AShooterProjectile::TryPenetrate(const FHitResult& Hit, const FVector& Direction)
+{
+	if (NumPenetrations >= MaxPenetrations || RemainingPenetrationDepth <= 0.0f)
+	{
+		return false;
+	}
+
+	// scale the depth left by how hard this surface is to punch through
+	const EPhysicalSurface SurfaceType = Hit.PhysMaterial.IsValid() ? Hit.PhysMaterial->SurfaceType.GetValue() : SurfaceType_Default;
+	const float* FoundResistance = SurfacePenetrationResistance.Find(SurfaceType);
+	const float Resistance = FoundResistance ? FMath::Max(*FoundResistance, UE_KINDA_SMALL_NUMBER) : 1.0f;
+	const float MaxThickness = RemainingPenetrationDepth / Resistance;
+
+	// trace back against the hit component from the deepest point we could reach to find the exit.
+	// No hit means that point is still inside the surface, so it's too thick
+	FHitResult ExitHit;
+	const FVector Entry = Hit.ImpactPoint;
+	const FVector DeepestPoint = Entry + Direction * MaxThickness;
+
+	if (!Hit.GetComponent()->LineTraceComponent(ExitHit, DeepestPoint, Entry, FCollisionQueryParams(SCENE_QUERY_STAT(ShooterBallisticExit), false)))
+	{
+		return false;
+	}
+
+	const float Thickness = FVector::Dist(Entry, ExitHit.ImpactPoint);
+
+	RemainingPenetrationDepth -= Thickness * Resistance;
+	++NumPenetrations;
+
+	INC_DWORD_STAT(STAT_ShooterBallisticPenetrations);
+	return true;
 }
@@ -4,11 +4,38 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "CollisionQueryParams.h"
+#include "Chaos/ChaosEngineInterface.h"
+#include "Combat/ShooterImpactEffects.h"
 #include "ShooterProjectile.generated.h"
 
 class USphereComponent;
 class UProjectileMovementComponent;
 class ACharacter;
+class UShooterProjectilePoolSubsystem;
+class UPrimitiveComponent;
+class UStaticMesh;
+
+/**
+ *  A surface found ahead of a ballistic projectile, resolved once the projectile's flight time reaches it
+ */
+struct FShooterBallisticImpact
+{
+	/** Flight time the projectile reaches the surface at */
+	double FlightTime = 0.0;
+
+	/** Surface hit */
+	FHitResult Hit;
+
+	/** Projectile velocity at the surface */
+	FVector Velocity = FVector::ZeroVector;
+
+	/** Damage multiplier left after any surfaces penetrated before this one */
+	float DamageScale = 1.0f;
+
+	/** If true, the projectile punches through this surface and keeps flying */
+	bool bPenetrates = false;
+};
 
 /**
  *  Simple projectile class for a first person shooter game
@@ -52,9 +79,96 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Hit")
 	TSubclassOf<UDamageType> HitDamageType;
 
+	/** Effects spawned through the pooled impact pipeline on every surface hit */
+	UPROPERTY(EditAnywhere, Category="Hit")
+	FShooterImpactEffectSettings ImpactEffects;
+
+	/**
+	 *  If true, the projectile follows its gravity-drop trajectory in closed form instead of using the projectile movement component.
+	 *  The path ahead is swept in long segments at a coarse interval, and surfaces along it can be penetrated
+	 */
+	UPROPERTY(EditAnywhere, Category="Hit|Ballistics")
+	bool bUseBallistics = false;
+
+	/** Flight time covered by each ballistic sweep. Longer segments mean fewer queries but a coarser approximation of the drop curve */
+	UPROPERTY(EditAnywhere, Category="Hit|Ballistics", meta = (EditCondition = "bUseBallistics", ClampMin = 0.01, ClampMax = 1, Units = "s"))
+	float BallisticSweepInterval = 0.05f;
+
+	/** Thickness of default material the projectile can punch through over its whole flight. Zero disables penetration */
+	UPROPERTY(EditAnywhere, Category="Hit|Ballistics", meta = (EditCondition = "bUseBallistics", ClampMin = 0, Units = "cm"))
+	float PenetrationDepth = 0.0f;
+
+	/** Max number of surfaces the projectile can punch through */
+	UPROPERTY(EditAnywhere, Category="Hit|Ballistics", meta = (EditCondition = "bUseBallistics", ClampMin = 0))
+	int32 MaxPenetrations = 2;
+
+	/** Damage multiplier applied for every surface the projectile punches through */
+	UPROPERTY(EditAnywhere, Category="Hit|Ballistics", meta = (EditCondition = "bUseBallistics", ClampMin = 0, ClampMax = 1))
+	float PenetrationDamageScale = 0.6f;
+
+	/** Multiplies the thickness of surfaces by physical surface type when spending penetration depth. Unlisted surfaces use 1 */
+	UPROPERTY(EditAnywhere, Category="Hit|Ballistics", meta = (EditCondition = "bUseBallistics"))
+	TMap<TEnumAsByte<EPhysicalSurface>, float> SurfacePenetrationResistance;
+
+	/** Mesh drawn for each round while this projectile is simulated as data. Every round of this class is an instance of one shared component */
+	UPROPERTY(EditAnywhere, Category="Simulation")
+	TObjectPtr<UStaticMesh> SimulatedMesh;
+
+	/** Scale of the simulated round mesh */
+	UPROPERTY(EditAnywhere, Category="Simulation")
+	FVector SimulatedMeshScale = FVector::OneVector;
+
 	/** If true, this projectile has already hit another surface */
 	bool bHit = false;
 
+	/** Pool that owns this projectile. Unset for projectiles spawned outside of the projectile pool */
+	TWeakObjectPtr<UShooterProjectilePoolSubsystem> OwningPool;
+
+	/** If true, this projectile is currently handed out by its pool */
+	bool bPoolActive = false;
+
+	/** Collision mode to restore when this projectile is handed out by its pool */
+	TEnumAsByte<ECollisionEnabled::Type> PooledCollisionEnabled = ECollisionEnabled::QueryAndPhysics;
+
+	/** Timer to return this projectile to its pool after a hit */
+	FTimerHandle PoolReturnTimer;
+
+	/** Damage multiplier applied to the next hit, lowered by penetrated surfaces */
+	float HitDamageScale = 1.0f;
+
+	/** If true, this projectile is flying on its closed form ballistic trajectory */
+	bool bBallisticFlight = false;
+
+	/** If true, a surface that stops this projectile has been found ahead, so no more sweeps are needed */
+	bool bBallisticStopFound = false;
+
+	/** Launch location of the ballistic trajectory */
+	FVector BallisticOrigin = FVector::ZeroVector;
+
+	/** Launch velocity of the ballistic trajectory */
+	FVector BallisticVelocity = FVector::ZeroVector;
+
+	/** Vertical acceleration along the ballistic trajectory */
+	double BallisticGravityZ = 0.0;
+
+	/** Time in flight since launch */
+	double BallisticFlightTime = 0.0;
+
+	/** Flight time the trajectory has been swept up to */
+	double BallisticSweptTime = 0.0;
+
+	/** Penetration depth left to spend */
+	float RemainingPenetrationDepth = 0.0f;
+
+	/** Number of surfaces penetrated so far */
+	int32 NumPenetrations = 0;
+
+	/** Surfaces found ahead that haven't been reached yet, in flight order */
+	TArray<FShooterBallisticImpact> PendingBallisticImpacts;
+
+	/** Query params reused by every sweep of this flight. Penetrated components are added to its ignore list */
+	FCollisionQueryParams BallisticQueryParams;
+
 public:	
 
 	/** Constructor */
@@ -65,11 +179,44 @@ protected:
 	/** Gameplay initialization */
 	virtual void BeginPlay() override;
 
+	/** Gameplay cleanup */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Advances ballistic flight */
+	virtual void Tick(float DeltaSeconds) override;
+
+	/** Recycles pooled projectiles instead of destroying them when their lifespan runs out */
+	virtual void LifeSpanExpired() override;
+
 	/** Handles collision */
 	virtual void NotifyHit(class UPrimitiveComponent* MyComp, AActor* Other, class UPrimitiveComponent* OtherComp, bool bSelfMoved, FVector HitLocation, FVector HitNormal, FVector NormalImpulse, const FHitResult& Hit) override;
 
 protected:
 
+	/** Applies the effects of hitting a surface. Shared by movement collisions and externally simulated hits */
+	void ProcessHit(AActor* Other, UPrimitiveComponent* OtherComp, const FVector& ImpactVelocity, const FHitResult& Hit);
+
+	/** Applies noise, impulse, damage and Blueprint hit effects for a surface without ending the flight */
+	void ApplyImpactEffects(AActor* Other, UPrimitiveComponent* OtherComp, const FVector& ImpactVelocity, const FHitResult& Hit);
+
+	/** Stops the movement component and starts flying along the closed form trajectory from the current transform */
+	void StartBallisticFlight();
+
+	/** Advances the ballistic flight time, sweeping ahead and resolving any surfaces reached */
+	void UpdateBallisticFlight(float DeltaSeconds);
+
+	/** Sweeps the trajectory between two flight times with a single multi-hit query and queues the surfaces found */
+	void SweepBallisticSegment(double StartTime, double EndTime);
+
+	/** Returns true if the projectile can punch through the hit surface, and spends the penetration depth it costs */
+	bool TryPenetrate(const FHitResult& Hit, const FVector& Direction);
+
+	/** Returns the location on the ballistic trajectory at the given flight time */
+	FVector GetBallisticLocation(double FlightTime) const { return BallisticOrigin + BallisticVelocity * FlightTime + FVector(0.0, 0.0, 0.5 * BallisticGravityZ * FlightTime * FlightTime); }
+
+	/** Returns the velocity on the ballistic trajectory at the given flight time */
+	FVector GetBallisticVelocity(double FlightTime) const { return BallisticVelocity + FVector(0.0, 0.0, BallisticGravityZ * FlightTime); }
+
 	/** Apply damage to a hit character */
 	UFUNCTION(BlueprintCallable, Category="Projectile")
 	virtual void DamageCharacter(ACharacter* HitCharacter, const FHitResult& Hit);
@@ -77,4 +224,39 @@ protected:
 	/** Passes control to Blueprint to implement any effects on hit */
 	UFUNCTION(BlueprintImplementableEvent, Category="Projectile", meta=(DisplayName = "On Projectile Hit"))
 	void BP_OnProjectileHit(const FHitResult& Hit);
+
+	/** Returns this projectile to its pool, or destroys it if it isn't pooled */
+	void ReturnToPool();
+
+public:
+
+	/** Assigns the pool that owns this projectile. Must be called before the projectile finishes spawning */
+	void SetOwningPool(UShooterProjectilePoolSubsystem* Pool) { OwningPool = Pool; }
+
+	/** Returns true if this projectile is currently handed out by its pool */
+	bool IsPoolActive() const { return bPoolActive; }
+
+	/** Resets this projectile when handed out by its pool. Launches it from the given transform unless it's only needed to resolve an impact */
+	void OnAcquiredFromPool(const FTransform& SpawnTransform, AActor* NewOwner, APawn* NewInstigator, bool bLaunch = true);
+
+	/** Applies damage, noise and hit effects for an impact found outside of this actor's own movement */
+	void ResolveSimulatedHit(const FHitResult& Hit, const FVector& ImpactVelocity);
+
+	/** Returns the collision component */
+	USphereComponent* GetCollisionComponent() const { return CollisionComponent; }
+
+	/** Returns the projectile movement component */
+	UProjectileMovementComponent* GetProjectileMovement() const { return ProjectileMovement; }
+
+	/** Returns the mesh drawn for each simulated round, if any */
+	UStaticMesh* GetSimulatedMesh() const { return SimulatedMesh; }
+
+	/** Returns the scale of the simulated round mesh */
+	const FVector& GetSimulatedMeshScale() const { return SimulatedMeshScale; }
+
+	/** Returns the lifespan this projectile starts with */
+	float GetDefaultLifeSpan() const { return InitialLifeSpan; }
+
+	/** Puts this projectile to sleep when returned to its pool */
+	void OnReleasedToPool();
 };
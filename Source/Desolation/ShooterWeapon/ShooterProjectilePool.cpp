@@ -0,0 +1,172 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterWeapon/ShooterProjectilePool.h"
+#include "ShooterProjectile.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY(LogShooterProjectilePool);
+
+static FAutoConsoleCommandWithWorld GShooterProjectilePoolDumpCommand(
+	TEXT("Shooter.ProjectilePool.Dump"),
+	TEXT("Logs hit, miss and high-water mark counters for every projectile pool in the world"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (const UShooterProjectilePoolSubsystem* Pool = World ? World->GetSubsystem<UShooterProjectilePoolSubsystem>() : nullptr)
+		{
+			Pool->DumpStats();
+		}
+	}));
+
+void UShooterProjectilePoolSubsystem::Deinitialize()
+{
+	// report the final pool usage before tearing down
+	DumpStats();
+
+	Pools.Empty();
+
+	Super::Deinitialize();
+}
+
+bool UShooterProjectilePoolSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterProjectilePoolSubsystem::PrewarmProjectiles(TSubclassOf<AShooterProjectile> ProjectileClass, int32 Count)
+{
+	if (!ProjectileClass)
+	{
+		return;
+	}
+
+	FShooterProjectileClassPool& Pool = Pools.FindOrAdd(ProjectileClass);
+
+	// spawn dormant projectiles until we have enough waiting
+	while (Pool.Inactive.Num() < Count)
+	{
+		AShooterProjectile* Projectile = SpawnPooledProjectile(ProjectileClass, FTransform::Identity, nullptr, nullptr);
+
+		if (!Projectile)
+		{
+			break;
+		}
+
+		Projectile->OnReleasedToPool();
+		Pool.Inactive.Add(Projectile);
+	}
+}
+
+AShooterProjectile* UShooterProjectilePoolSubsystem::AcquireProjectile(TSubclassOf<AShooterProjectile> ProjectileClass, const FTransform& SpawnTransform, AActor* Owner, APawn* Instigator, bool bLaunch)
+{
+	if (!ProjectileClass)
+	{
+		return nullptr;
+	}
+
+	FShooterProjectileClassPool& Pool = Pools.FindOrAdd(ProjectileClass);
+
+	// reuse the most recently returned projectile, skipping any that were destroyed while pooled
+	AShooterProjectile* Projectile = nullptr;
+
+	while (!Projectile && Pool.Inactive.Num() > 0)
+	{
+		Projectile = Pool.Inactive.Pop(EAllowShrinking::No);
+
+		if (!IsValid(Projectile))
+		{
+			Projectile = nullptr;
+		}
+	}
+
+	if (Projectile)
+	{
+		++Pool.Stats.Hits;
+
+	} else {
+
+		// the pool ran dry, so grow it
+		Projectile = SpawnPooledProjectile(ProjectileClass, SpawnTransform, Owner, Instigator);
+
+		if (!Projectile)
+		{
+			return nullptr;
+		}
+
+		++Pool.Stats.Misses;
+	}
+
+	// update the usage counters
+	++Pool.Stats.NumActive;
+	Pool.Stats.HighWaterMark = FMath::Max(Pool.Stats.HighWaterMark, Pool.Stats.NumActive);
+
+	// reset the projectile and send it on its way
+	Projectile->OnAcquiredFromPool(SpawnTransform, Owner, Instigator, bLaunch);
+
+	return Projectile;
+}
+
+void UShooterProjectilePoolSubsystem::ReleaseProjectile(AShooterProjectile* Projectile)
+{
+	// ignore projectiles that are already pooled
+	if (!IsValid(Projectile) || !Projectile->IsPoolActive())
+	{
+		return;
+	}
+
+	FShooterProjectileClassPool& Pool = Pools.FindOrAdd(Projectile->GetClass());
+
+	--Pool.Stats.NumActive;
+
+	// put the projectile to sleep and make it available again
+	Projectile->OnReleasedToPool();
+	Pool.Inactive.Add(Projectile);
+}
+
+void UShooterProjectilePoolSubsystem::ForgetProjectile(AShooterProjectile* Projectile)
+{
+	if (FShooterProjectileClassPool* Pool = Pools.Find(Projectile->GetClass()))
+	{
+		if (Projectile->IsPoolActive())
+		{
+			--Pool->Stats.NumActive;
+
+		} else {
+
+			Pool->Inactive.RemoveSingleSwap(Projectile, EAllowShrinking::No);
+		}
+	}
+}
+
+FShooterProjectilePoolStats UShooterProjectilePoolSubsystem::GetPoolStats(TSubclassOf<AShooterProjectile> ProjectileClass) const
+{
+	const FShooterProjectileClassPool* Pool = Pools.Find(ProjectileClass);
+	return Pool ? Pool->Stats : FShooterProjectilePoolStats();
+}
+
+void UShooterProjectilePoolSubsystem::DumpStats() const
+{
+	for (const TPair<TSubclassOf<AShooterProjectile>, FShooterProjectileClassPool>& Pair : Pools)
+	{
+		const FShooterProjectilePoolStats& Stats = Pair.Value.Stats;
+
+		UE_LOG(LogShooterProjectilePool, Log, TEXT("%s: hits %d, misses %d, active %d, high-water %d, inactive %d"),
+			*GetNameSafe(Pair.Key), Stats.Hits, Stats.Misses, Stats.NumActive, Stats.HighWaterMark, Pair.Value.Inactive.Num());
+	}
+}
+
+AShooterProjectile* UShooterProjectilePoolSubsystem::SpawnPooledProjectile(TSubclassOf<AShooterProjectile> ProjectileClass, const FTransform& SpawnTransform, AActor* Owner, APawn* Instigator)
+{
+	// defer spawning so the projectile knows it's pooled before BeginPlay
+	AShooterProjectile* Projectile = GetWorld()->SpawnActorDeferred<AShooterProjectile>(ProjectileClass, SpawnTransform, Owner, Instigator, ESpawnActorCollisionHandlingMethod::AlwaysSpawn, ESpawnActorScaleMethod::OverrideRootScale);
+
+	if (Projectile)
+	{
+		Projectile->SetOwningPool(this);
+		Projectile->FinishSpawning(SpawnTransform);
+	}
+
+	return Projectile;
+}
@@ -0,0 +1,99 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ShooterProjectilePool.generated.h"
+
+class AShooterProjectile;
+class APawn;
+
+DECLARE_LOG_CATEGORY_EXTERN(LogShooterProjectilePool, Log, All);
+
+/**
+ *  Usage counters for a single projectile class pool
+ */
+USTRUCT()
+struct FShooterProjectilePoolStats
+{
+	GENERATED_BODY()
+
+	/** Number of acquisitions served by an inactive pooled projectile */
+	int32 Hits = 0;
+
+	/** Number of acquisitions that had to spawn a new projectile */
+	int32 Misses = 0;
+
+	/** Number of projectiles currently handed out */
+	int32 NumActive = 0;
+
+	/** Highest number of projectiles handed out at the same time */
+	int32 HighWaterMark = 0;
+};
+
+/**
+ *  Pooled projectiles of a single class
+ */
+USTRUCT()
+struct FShooterProjectileClassPool
+{
+	GENERATED_BODY()
+
+	/** Projectiles waiting to be handed out */
+	UPROPERTY()
+	TArray<TObjectPtr<AShooterProjectile>> Inactive;
+
+	/** Usage counters for this pool */
+	FShooterProjectilePoolStats Stats;
+};
+
+/**
+ *  Per-world pool of reusable shooter projectiles
+ *  Pre-warms projectiles per class and recycles them on hit or lifespan timeout
+ *  instead of spawning and destroying an actor for every shot
+ */
+UCLASS()
+class DESOLATION_API UShooterProjectilePoolSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+	/** Pools indexed by projectile class */
+	UPROPERTY()
+	TMap<TSubclassOf<AShooterProjectile>, FShooterProjectileClassPool> Pools;
+
+public:
+
+	/** Subsystem cleanup */
+	virtual void Deinitialize() override;
+
+protected:
+
+	/** Only pool projectiles in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+public:
+
+	/** Ensures at least the given number of inactive projectiles of this class are ready to be handed out */
+	void PrewarmProjectiles(TSubclassOf<AShooterProjectile> ProjectileClass, int32 Count);
+
+	/** Hands out a projectile at the given transform, reusing an inactive one when possible. If bLaunch is false, the projectile stays asleep so it can resolve an externally computed hit */
+	AShooterProjectile* AcquireProjectile(TSubclassOf<AShooterProjectile> ProjectileClass, const FTransform& SpawnTransform, AActor* Owner, APawn* Instigator, bool bLaunch = true);
+
+	/** Returns a handed out projectile to its pool */
+	void ReleaseProjectile(AShooterProjectile* Projectile);
+
+	/** Removes a pooled projectile that is being destroyed */
+	void ForgetProjectile(AShooterProjectile* Projectile);
+
+	/** Returns the usage counters for the given projectile class */
+	FShooterProjectilePoolStats GetPoolStats(TSubclassOf<AShooterProjectile> ProjectileClass) const;
+
+	/** Logs the usage counters of every pool */
+	void DumpStats() const;
+
+protected:
+
+	/** Spawns a new projectile owned by this pool */
+	AShooterProjectile* SpawnPooledProjectile(TSubclassOf<AShooterProjectile> ProjectileClass, const FTransform& SpawnTransform, AActor* Owner, APawn* Instigator);
+};
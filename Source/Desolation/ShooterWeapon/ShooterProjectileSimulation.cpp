@@ -0,0 +1,457 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterWeapon/ShooterProjectileSimulation.h"
+#include "ShooterProjectile.h"
+#include "ShooterProjectilePool.h"
+#include "ShooterCollisionChannels.h"
+#include "Components/SphereComponent.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "GameFramework/Pawn.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+/** Flight time for simulated projectiles whose class doesn't set a lifespan */
+static constexpr float ShooterDefaultSimulatedLifeSpan = 10.0f;
+
+static FAutoConsoleCommandWithWorld GShooterProjectileSimulationDumpCommand(
+	TEXT("Shooter.ProjectileSim.Dump"),
+	TEXT("Logs live, launched and impact counters for simulated projectiles in the world"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (const UShooterProjectileSimulationSubsystem* Simulation = World ? World->GetSubsystem<UShooterProjectileSimulationSubsystem>() : nullptr)
+		{
+			Simulation->DumpStats();
+		}
+	}));
+
+////////////////////////////////////////////////////////////////////
+
+int32 FShooterSimulatedProjectileBuffers::Add(const FVector& Location, const FVector& Velocity, double InGravityZ, float LifeSpan, int32 ArchetypeIndex, AActor* InOwner, APawn* InInstigator)
+{
+	PosX.Add(Location.X);
+	PosY.Add(Location.Y);
+	PosZ.Add(Location.Z);
+
+	PrevX.Add(Location.X);
+	PrevY.Add(Location.Y);
+	PrevZ.Add(Location.Z);
+
+	VelX.Add(Velocity.X);
+	VelY.Add(Velocity.Y);
+	VelZ.Add(Velocity.Z);
+
+	GravityZ.Add(InGravityZ);
+	TimeLeft.Add(LifeSpan);
+	Archetype.Add(ArchetypeIndex);
+	Owner.Emplace(InOwner);
+	Instigator.Emplace(InInstigator);
+	PendingSweep.AddDefaulted();
+
+	return PosX.Num() - 1;
+}
+
+void FShooterSimulatedProjectileBuffers::RemoveAtSwap(int32 Index)
+{
+	PosX.RemoveAtSwap(Index, EAllowShrinking::No);
+	PosY.RemoveAtSwap(Index, EAllowShrinking::No);
+	PosZ.RemoveAtSwap(Index, EAllowShrinking::No);
+
+	PrevX.RemoveAtSwap(Index, EAllowShrinking::No);
+	PrevY.RemoveAtSwap(Index, EAllowShrinking::No);
+	PrevZ.RemoveAtSwap(Index, EAllowShrinking::No);
+
+	VelX.RemoveAtSwap(Index, EAllowShrinking::No);
+	VelY.RemoveAtSwap(Index, EAllowShrinking::No);
+	VelZ.RemoveAtSwap(Index, EAllowShrinking::No);
+
+	GravityZ.RemoveAtSwap(Index, EAllowShrinking::No);
+	TimeLeft.RemoveAtSwap(Index, EAllowShrinking::No);
+	Archetype.RemoveAtSwap(Index, EAllowShrinking::No);
+	Owner.RemoveAtSwap(Index, EAllowShrinking::No);
+	Instigator.RemoveAtSwap(Index, EAllowShrinking::No);
+	PendingSweep.RemoveAtSwap(Index, EAllowShrinking::No);
+}
+
+void FShooterSimulatedProjectileBuffers::Reset()
+{
+	PosX.Reset();
+	PosY.Reset();
+	PosZ.Reset();
+
+	PrevX.Reset();
+	PrevY.Reset();
+	PrevZ.Reset();
+
+	VelX.Reset();
+	VelY.Reset();
+	VelZ.Reset();
+
+	GravityZ.Reset();
+	TimeLeft.Reset();
+	Archetype.Reset();
+	Owner.Reset();
+	Instigator.Reset();
+	PendingSweep.Reset();
+}
+
+void FShooterSimulatedProjectileBuffers::Integrate(float DeltaTime)
+{
+	const int32 Count = Num();
+	const double Dt = DeltaTime;
+	const double HalfDtSquared = 0.5 * Dt * Dt;
+
+	// remember where each projectile starts this step so it can be swept
+	FMemory::Memcpy(PrevX.GetData(), PosX.GetData(), Count * sizeof(double));
+	FMemory::Memcpy(PrevY.GetData(), PosY.GetData(), Count * sizeof(double));
+	FMemory::Memcpy(PrevZ.GetData(), PosZ.GetData(), Count * sizeof(double));
+
+	double* RESTRICT Px = PosX.GetData();
+	double* RESTRICT Py = PosY.GetData();
+	double* RESTRICT Pz = PosZ.GetData();
+	const double* RESTRICT Vx = VelX.GetData();
+	const double* RESTRICT Vy = VelY.GetData();
+	double* RESTRICT Vz = VelZ.GetData();
+	const double* RESTRICT Gz = GravityZ.GetData();
+
+	const VectorRegister4Double DtVec = MakeVectorRegisterDouble(Dt, Dt, Dt, Dt);
+	const VectorRegister4Double HalfDtSquaredVec = MakeVectorRegisterDouble(HalfDtSquared, HalfDtSquared, HalfDtSquared, HalfDtSquared);
+
+	int32 Index = 0;
+
+	// step four projectiles at a time
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		// horizontal motion is linear
+		VectorStore(VectorMultiplyAdd(VectorLoad(Vx + Index), DtVec, VectorLoad(Px + Index)), Px + Index);
+		VectorStore(VectorMultiplyAdd(VectorLoad(Vy + Index), DtVec, VectorLoad(Py + Index)), Py + Index);
+
+		// vertical motion uses the closed form for constant acceleration, so it's exact for any step size
+		const VectorRegister4Double G = VectorLoad(Gz + Index);
+		const VectorRegister4Double StartVz = VectorLoad(Vz + Index);
+
+		VectorRegister4Double NewPz = VectorMultiplyAdd(StartVz, DtVec, VectorLoad(Pz + Index));
+		NewPz = VectorMultiplyAdd(G, HalfDtSquaredVec, NewPz);
+
+		VectorStore(NewPz, Pz + Index);
+		VectorStore(VectorMultiplyAdd(G, DtVec, StartVz), Vz + Index);
+	}
+
+	// step the remaining projectiles one by one
+	for (; Index < Count; ++Index)
+	{
+		Px[Index] += Vx[Index] * Dt;
+		Py[Index] += Vy[Index] * Dt;
+		Pz[Index] += Vz[Index] * Dt + Gz[Index] * HalfDtSquared;
+		Vz[Index] += Gz[Index] * Dt;
+	}
+}
+
+////////////////////////////////////////////////////////////////////
+
+void UShooterProjectileSimulationSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	UnownedQueryParams.Init(nullptr, FCollisionQueryParams(SCENE_QUERY_STAT(ShooterProjectileSimulation), false));
+}
+
+void UShooterProjectileSimulationSubsystem::Deinitialize()
+{
+	// report the final counters before tearing down
+	DumpStats();
+
+	Projectiles.Reset();
+
+	if (VisualHost)
+	{
+		VisualHost->Destroy();
+		VisualHost = nullptr;
+	}
+
+	Archetypes.Empty();
+	ArchetypeLookup.Empty();
+	InstigatorQueryParams.Empty();
+
+	Super::Deinitialize();
+}
+
+void UShooterProjectileSimulationSubsystem::Tick(float DeltaTime)
+{
+	// nothing in flight
+	if (Projectiles.Num() == 0)
+	{
+		// hide the rounds left over from the last frame something was flying
+		UpdateVisuals();
+		return;
+	}
+
+	// resolve impacts found by the sweeps issued last frame
+	ResolvePendingSweeps();
+
+	// retire expired projectiles once their final segment has come back without a hit
+	for (int32 Index = Projectiles.Num() - 1; Index >= 0; --Index)
+	{
+		if (Projectiles.TimeLeft[Index] <= 0.0f)
+		{
+			Projectiles.RemoveAtSwap(Index);
+		}
+	}
+
+	// move every surviving projectile
+	Projectiles.Integrate(DeltaTime);
+
+	// projectiles running out of flight time this step only travel the part of it they had left
+	for (int32 Index = 0; Index < Projectiles.Num(); ++Index)
+	{
+		Projectiles.TimeLeft[Index] -= DeltaTime;
+
+		if (Projectiles.TimeLeft[Index] <= 0.0f)
+		{
+			const double Fraction = FMath::Clamp((DeltaTime + Projectiles.TimeLeft[Index]) / DeltaTime, 0.0, 1.0);
+
+			Projectiles.PosX[Index] = FMath::Lerp(Projectiles.PrevX[Index], Projectiles.PosX[Index], Fraction);
+			Projectiles.PosY[Index] = FMath::Lerp(Projectiles.PrevY[Index], Projectiles.PosY[Index], Fraction);
+			Projectiles.PosZ[Index] = FMath::Lerp(Projectiles.PrevZ[Index], Projectiles.PosZ[Index], Fraction);
+		}
+	}
+
+	// sweep the new flight segments, including the final one of each expiring projectile
+	IssueSweeps();
+
+	// draw the rounds at their new positions
+	UpdateVisuals();
+}
+
+TStatId UShooterProjectileSimulationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UShooterProjectileSimulationSubsystem, STATGROUP_Tickables);
+}
+
+bool UShooterProjectileSimulationSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UShooterProjectileSimulationSubsystem::LaunchProjectile(TSubclassOf<AShooterProjectile> ProjectileClass, const FTransform& LaunchTransform, AActor* Owner, APawn* Instigator)
+{
+	if (!ProjectileClass)
+	{
+		return;
+	}
+
+	const int32 ArchetypeIndex = FindOrAddArchetype(ProjectileClass);
+	const FShooterSimulatedProjectileArchetype& Archetype = Archetypes[ArchetypeIndex];
+
+	// launch along the transform's facing
+	const FVector Velocity = LaunchTransform.GetRotation().GetForwardVector() * Archetype.Speed;
+
+	Projectiles.Add(LaunchTransform.GetLocation(), Velocity, Archetype.GravityZ, Archetype.LifeSpan, ArchetypeIndex, Owner, Instigator);
+
+	// build the instigator's sweep params the first time it launches, so the sweeps never build their own
+	if (Instigator && !InstigatorQueryParams.Contains(Instigator))
+	{
+		// drop the params of pawns that have gone away
+		for (auto It = InstigatorQueryParams.CreateIterator(); It; ++It)
+		{
+			if (!It.Key().ResolveObjectPtr())
+			{
+				It.RemoveCurrent();
+			}
+		}
+
+		InstigatorQueryParams.Add(Instigator).Init(Instigator, FCollisionQueryParams(SCENE_QUERY_STAT(ShooterProjectileSimulation), false, Instigator));
+	}
+
+	++NumLaunched;
+}
+
+void UShooterProjectileSimulationSubsystem::DumpStats() const
+{
+	UE_LOG(LogShooterProjectilePool, Log, TEXT("Simulated projectiles: live %d, launched %d, impacts %d, archetypes %d"),
+		Projectiles.Num(), NumLaunched, NumImpacts, Archetypes.Num());
+}
+
+int32 UShooterProjectileSimulationSubsystem::FindOrAddArchetype(TSubclassOf<AShooterProjectile> ProjectileClass)
+{
+	if (const int32* Found = ArchetypeLookup.Find(ProjectileClass.Get()))
+	{
+		return *Found;
+	}
+
+	// read the flight parameters from the class defaults
+	const AShooterProjectile* Defaults = GetDefault<AShooterProjectile>(ProjectileClass);
+
+	FShooterSimulatedProjectileArchetype& Archetype = Archetypes.AddDefaulted_GetRef();
+	Archetype.ProjectileClass = ProjectileClass;
+	Archetype.Radius = Defaults->GetCollisionComponent()->GetScaledSphereRadius();
+	Archetype.Speed = Defaults->GetProjectileMovement()->InitialSpeed;
+	Archetype.GravityZ = GetWorld()->GetGravityZ() * Defaults->GetProjectileMovement()->ProjectileGravityScale;
+	Archetype.LifeSpan = Defaults->GetDefaultLifeSpan() > 0.0f ? Defaults->GetDefaultLifeSpan() : ShooterDefaultSimulatedLifeSpan;
+
+	CreateVisual(Archetype, Defaults);
+
+	const int32 ArchetypeIndex = Archetypes.Num() - 1;
+	ArchetypeLookup.Add(ProjectileClass.Get(), ArchetypeIndex);
+
+	return ArchetypeIndex;
+}
+
+void UShooterProjectileSimulationSubsystem::ResolvePendingSweeps()
+{
+	UWorld* World = GetWorld();
+
+	// walk backwards so removals only swap in projectiles we've already checked
+	for (int32 Index = Projectiles.Num() - 1; Index >= 0; --Index)
+	{
+		FTraceDatum SweepData;
+
+		if (!World->QueryTraceData(Projectiles.PendingSweep[Index], SweepData))
+		{
+			continue;
+		}
+
+		if (const FHitResult* Hit = FHitResult::GetFirstBlockingHit(SweepData.OutHits))
+		{
+			ResolveImpact(Index, *Hit);
+			Projectiles.RemoveAtSwap(Index);
+		}
+	}
+}
+
+void UShooterProjectileSimulationSubsystem::IssueSweeps()
+{
+	UWorld* World = GetWorld();
+
+	// consecutive projectiles usually come from the same pawn, so remember the last lookup
+	const APawn* LastInstigator = nullptr;
+	const FShooterCombatQueryParams* InstigatorParams = &UnownedQueryParams;
+
+	for (int32 Index = 0; Index < Projectiles.Num(); ++Index)
+	{
+		const FVector Start(Projectiles.PrevX[Index], Projectiles.PrevY[Index], Projectiles.PrevZ[Index]);
+		const FVector End(Projectiles.PosX[Index], Projectiles.PosY[Index], Projectiles.PosZ[Index]);
+
+		const FCollisionShape Shape = FCollisionShape::MakeSphere(Archetypes[Projectiles.Archetype[Index]].Radius);
+
+		// ignore the pawn that shot this projectile, using the params built when it launched
+		const APawn* Instigator = Projectiles.Instigator[Index].Get();
+
+		if (Instigator != LastInstigator)
+		{
+			const FShooterCombatQueryParams* Found = Instigator ? InstigatorQueryParams.Find(Instigator) : nullptr;
+			InstigatorParams = Found ? Found : &UnownedQueryParams;
+			LastInstigator = Instigator;
+		}
+
+		FShooterCombatQueryScope QueryScope;
+		const FShooterQueryParamsRef QueryParams = InstigatorParams->GetSelfParams();
+
+		Projectiles.PendingSweep[Index] = World->AsyncSweepByChannel(EAsyncTraceType::Single, Start, End, FQuat::Identity, Shooter_ObjectChannel_Projectile, Shape, QueryParams);
+	}
+}
+
+void UShooterProjectileSimulationSubsystem::CreateVisual(FShooterSimulatedProjectileArchetype& Archetype, const AShooterProjectile* Defaults)
+{
+	UWorld* World = GetWorld();
+
+	// dedicated servers have nothing to draw, and classes without a simulated mesh fly invisibly
+	if (!Defaults->GetSimulatedMesh() || World->GetNetMode() == NM_DedicatedServer)
+	{
+		return;
+	}
+
+	// spawn the actor that owns the instanced meshes the first time one is needed
+	if (!VisualHost)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags |= RF_Transient;
+
+		VisualHost = World->SpawnActor<AActor>(SpawnParams);
+	}
+
+	if (!VisualHost)
+	{
+		return;
+	}
+
+	// one instanced mesh per class, purely cosmetic
+	UInstancedStaticMeshComponent* Visual = NewObject<UInstancedStaticMeshComponent>(VisualHost);
+	Visual->SetMobility(EComponentMobility::Movable);
+	Visual->SetStaticMesh(Defaults->GetSimulatedMesh());
+	Visual->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Visual->SetCastShadow(false);
+	Visual->RegisterComponent();
+
+	Archetype.Visual = Visual;
+	Archetype.VisualScale = Defaults->GetSimulatedMeshScale();
+}
+
+void UShooterProjectileSimulationSubsystem::UpdateVisuals()
+{
+	for (int32 ArchetypeIndex = 0; ArchetypeIndex < Archetypes.Num(); ++ArchetypeIndex)
+	{
+		const FShooterSimulatedProjectileArchetype& Archetype = Archetypes[ArchetypeIndex];
+
+		if (!Archetype.Visual)
+		{
+			continue;
+		}
+
+		// gather this class's rounds, facing along their velocity
+		VisualTransforms.Reset();
+
+		for (int32 Index = 0; Index < Projectiles.Num(); ++Index)
+		{
+			if (Projectiles.Archetype[Index] == ArchetypeIndex)
+			{
+				const FVector Location(Projectiles.PosX[Index], Projectiles.PosY[Index], Projectiles.PosZ[Index]);
+				const FVector Velocity(Projectiles.VelX[Index], Projectiles.VelY[Index], Projectiles.VelZ[Index]);
+
+				VisualTransforms.Emplace(Velocity.Rotation(), Location, Archetype.VisualScale);
+			}
+		}
+
+		// grow or shrink from the end so existing instances are only moved, never reordered
+		int32 NumInstances = Archetype.Visual->GetInstanceCount();
+
+		while (NumInstances > VisualTransforms.Num())
+		{
+			Archetype.Visual->RemoveInstance(--NumInstances);
+		}
+
+		while (NumInstances < VisualTransforms.Num())
+		{
+			Archetype.Visual->AddInstance(VisualTransforms[NumInstances++], true);
+		}
+
+		if (VisualTransforms.Num() > 0)
+		{
+			Archetype.Visual->BatchUpdateInstancesTransforms(0, VisualTransforms, true, true, true);
+		}
+	}
+}
+
+void UShooterProjectileSimulationSubsystem::ResolveImpact(int32 Index, const FHitResult& Hit)
+{
+	++NumImpacts;
+
+	UShooterProjectilePoolSubsystem* ProjectilePool = GetWorld()->GetSubsystem<UShooterProjectilePoolSubsystem>();
+
+	if (!ProjectilePool)
+	{
+		return;
+	}
+
+	const FShooterSimulatedProjectileArchetype& Archetype = Archetypes[Projectiles.Archetype[Index]];
+	const FVector Velocity(Projectiles.VelX[Index], Projectiles.VelY[Index], Projectiles.VelZ[Index]);
+
+	// borrow a sleeping projectile at the impact point to run the regular hit logic
+	const FTransform ImpactTransform(Velocity.Rotation(), Hit.Location);
+
+	if (AShooterProjectile* ImpactProxy = ProjectilePool->AcquireProjectile(Archetype.ProjectileClass, ImpactTransform, Projectiles.Owner[Index].Get(), Projectiles.Instigator[Index].Get(), false))
+	{
+		ImpactProxy->ResolveSimulatedHit(Hit, Velocity);
+	}
+}
@@ -0,0 +1,187 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "WorldCollision.h"
+#include "Combat/ShooterCombatQueryParams.h"
+#include "ShooterProjectileSimulation.generated.h"
+
+class AShooterProjectile;
+class APawn;
+class UInstancedStaticMeshComponent;
+
+/**
+ *  Flight parameters shared by every simulated projectile of a single class
+ *  Read once from the projectile class defaults
+ */
+USTRUCT()
+struct FShooterSimulatedProjectileArchetype
+{
+	GENERATED_BODY()
+
+	/** Projectile class used to resolve impacts */
+	UPROPERTY()
+	TSubclassOf<AShooterProjectile> ProjectileClass;
+
+	/** Radius of the swept collision sphere */
+	float Radius = 0.0f;
+
+	/** Launch speed */
+	float Speed = 0.0f;
+
+	/** Vertical acceleration while in flight */
+	float GravityZ = 0.0f;
+
+	/** Time in flight before the projectile expires */
+	float LifeSpan = 0.0f;
+
+	/** Draws every live projectile of this class as one instance. Unset if the class has no simulated mesh or nothing is rendered */
+	UPROPERTY()
+	TObjectPtr<UInstancedStaticMeshComponent> Visual;
+
+	/** Scale of each drawn instance */
+	FVector VisualScale = FVector::OneVector;
+};
+
+/**
+ *  Structure-of-arrays storage for simulated projectiles
+ *  Every array holds one entry per live projectile, in the same order
+ */
+struct FShooterSimulatedProjectileBuffers
+{
+	/** Current positions */
+	TArray<double> PosX, PosY, PosZ;
+
+	/** Positions at the start of the last step. Swept against the world to find impacts */
+	TArray<double> PrevX, PrevY, PrevZ;
+
+	/** Current velocities */
+	TArray<double> VelX, VelY, VelZ;
+
+	/** Vertical acceleration of each projectile */
+	TArray<double> GravityZ;
+
+	/** Remaining flight time of each projectile */
+	TArray<float> TimeLeft;
+
+	/** Index into the archetype list */
+	TArray<int32> Archetype;
+
+	/** Actor that fired each projectile */
+	TArray<TWeakObjectPtr<AActor>> Owner;
+
+	/** Pawn responsible for each projectile's damage */
+	TArray<TWeakObjectPtr<APawn>> Instigator;
+
+	/** Sweep issued for each projectile's last step */
+	TArray<FTraceHandle> PendingSweep;
+
+	/** Returns the number of live projectiles */
+	int32 Num() const { return PosX.Num(); }
+
+	/** Adds a projectile and returns its index */
+	int32 Add(const FVector& Location, const FVector& Velocity, double InGravityZ, float LifeSpan, int32 ArchetypeIndex, AActor* InOwner, APawn* InInstigator);
+
+	/** Removes a projectile by swapping the last one into its slot */
+	void RemoveAtSwap(int32 Index);
+
+	/** Removes every projectile */
+	void Reset();
+
+	/** Advances every projectile by the given time under constant gravity */
+	void Integrate(float DeltaTime);
+};
+
+/**
+ *  Simulates projectiles as plain data instead of one actor with movement and collision components per bullet
+ *  Positions are integrated four at a time over structure-of-arrays buffers. Each projectile's step is then swept with its own async query on the projectile channel,
+ *  so the cost saved is the per-actor movement and collision components, not the scene queries
+ *  Only impacts touch actors: the hit is handed to a sleeping pooled projectile so damage, noise and Blueprint hit effects run as usual
+ *  Rounds are drawn as instances of one mesh per projectile class, set with the class's simulated mesh. Classes without one fly invisibly
+ */
+UCLASS()
+class DESOLATION_API UShooterProjectileSimulationSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+	/** Flight parameters for each simulated projectile class */
+	UPROPERTY()
+	TArray<FShooterSimulatedProjectileArchetype> Archetypes;
+
+	/** Maps projectile classes to their archetype index */
+	TMap<TObjectKey<UClass>, int32> ArchetypeLookup;
+
+	/** Live projectile data */
+	FShooterSimulatedProjectileBuffers Projectiles;
+
+	/** Sweep query params for each pawn that has launched projectiles, built on its first launch. Each ignores its pawn */
+	TMap<TObjectKey<APawn>, FShooterCombatQueryParams> InstigatorQueryParams;
+
+	/** Sweep query params for projectiles whose instigator is gone */
+	FShooterCombatQueryParams UnownedQueryParams;
+
+	/** Transient actor owning the instanced mesh components that draw the projectiles */
+	UPROPERTY()
+	TObjectPtr<AActor> VisualHost;
+
+	/** Scratch instance transforms, reused every frame */
+	TArray<FTransform> VisualTransforms;
+
+	/** Total projectiles launched */
+	int32 NumLaunched = 0;
+
+	/** Total impacts resolved */
+	int32 NumImpacts = 0;
+
+public:
+
+	/** Subsystem initialization */
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	/** Subsystem cleanup */
+	virtual void Deinitialize() override;
+
+	/** Advances the simulation */
+	virtual void Tick(float DeltaTime) override;
+
+	/** Returns the stat id for the tickable */
+	virtual TStatId GetStatId() const override;
+
+protected:
+
+	/** Only simulate projectiles in game worlds */
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+public:
+
+	/** Launches a simulated projectile of the given class along the transform's facing */
+	void LaunchProjectile(TSubclassOf<AShooterProjectile> ProjectileClass, const FTransform& LaunchTransform, AActor* Owner, APawn* Instigator);
+
+	/** Returns the number of projectiles currently in flight */
+	int32 GetNumLiveProjectiles() const { return Projectiles.Num(); }
+
+	/** Logs the simulation counters */
+	void DumpStats() const;
+
+protected:
+
+	/** Returns the archetype index for a projectile class, reading its defaults the first time it's seen */
+	int32 FindOrAddArchetype(TSubclassOf<AShooterProjectile> ProjectileClass);
+
+	/** Reads back last frame's sweeps and resolves any impacts */
+	void ResolvePendingSweeps();
+
+	/** Issues one async sweep per projectile along its last step */
+	void IssueSweeps();
+
+	/** Creates the instanced mesh that draws an archetype's projectiles */
+	void CreateVisual(FShooterSimulatedProjectileArchetype& Archetype, const AShooterProjectile* Defaults);
+
+	/** Moves each archetype's instances to its live projectiles */
+	void UpdateVisuals();
+
+	/** Hands an impact over to a pooled projectile so damage and hit effects run */
+	void ResolveImpact(int32 Index, const FHitResult& Hit);
+};
@@ -5,17 +5,106 @@
 #include "Kismet/KismetMathLibrary.h"
 #include "Engine/World.h"
 #include "ShooterProjectile.h"
+#include "ShooterProjectilePool.h"
+#include "ShooterProjectileSimulation.h"
+#include "ShooterFireScheduler.h"
 #include "ShooterWeaponHolder.h"
+#include "ShooterCollisionChannels.h"
 #include "Components/SceneComponent.h"
-#include "TimerManager.h"
 #include "Animation/AnimInstance.h"
 #include "Components/SkeletalMeshComponent.h"
+#include "Engine/SkeletalMeshSocket.h"
 #include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerState.h"
+#include "GameFramework/DamageType.h"
+#include "Combat/ShooterDamageSubsystem.h"
+#include "Combat/ShooterNoiseSubsystem.h"
+#include "Combat/ShooterShotBatchComponent.h"
+#include "Combat/ShooterHitboxRegistry.h"
+#include "Combat/ShooterQueryScratch.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "AbilitySystemComponent.h"
+#include "AbilitySystemGlobals.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Pellet Traces"), STAT_ShooterPelletTraces, STATGROUP_Game);
+
+static int32 GShooterMaxShotsPerFrame = 32;
+static FAutoConsoleVariableRef CVarShooterMaxShotsPerFrame(
+	TEXT("Shooter.Weapons.MaxShotsPerFrame"),
+	GShooterMaxShotsPerFrame,
+	TEXT("Most shots a single weapon may fire in one frame. Any further backlog after a hitch is dropped"));
+
+/** Salt for the pellet spread stream, keeping it independent from the single projectile spread */
+static constexpr uint32 PelletStreamSalt = 0x50454C;
+
+void FShooterPelletSpread::Build(const FVector& AimDirection, float HalfAngle, int32 Count, FRandomStream& Stream)
+{
+	Num = Count;
+
+	// pad to a whole number of vector lanes
+	const int32 PaddedNum = Align(Count, 4);
+
+	DirX.SetNumUninitialized(PaddedNum, EAllowShrinking::No);
+	DirY.SetNumUninitialized(PaddedNum, EAllowShrinking::No);
+	DirZ.SetNumUninitialized(PaddedNum, EAllowShrinking::No);
+	AimWeight.SetNumZeroed(PaddedNum, EAllowShrinking::No);
+	RightWeight.SetNumZeroed(PaddedNum, EAllowShrinking::No);
+	UpWeight.SetNumZeroed(PaddedNum, EAllowShrinking::No);
+
+	const double SpreadRadius = FMath::Tan(FMath::DegreesToRadians(FMath::Clamp(HalfAngle, 0.0f, 89.0f)));
+
+	// draw a uniform point on the spread disc for each pellet, in pellet order so the pattern can be rebuilt from the stream
+	for (int32 Pellet = 0; Pellet < Count; ++Pellet)
+	{
+		const double Radius = SpreadRadius * FMath::Sqrt(Stream.FRand());
+		const double Angle = Stream.FRand() * UE_DOUBLE_TWO_PI;
+
+		double Sin, Cos;
+		FMath::SinCos(&Sin, &Cos, Angle);
+
+		// the disc offset is perpendicular to the aim, so normalizing only depends on its radius
+		const double InvLength = 1.0 / FMath::Sqrt(1.0 + Radius * Radius);
+
+		AimWeight[Pellet] = InvLength;
+		RightWeight[Pellet] = Radius * Cos * InvLength;
+		UpWeight[Pellet] = Radius * Sin * InvLength;
+	}
+
+	// build a basis around the aim direction
+	FVector Right, Up;
+	AimDirection.FindBestAxisVectors(Right, Up);
+
+	const VectorRegister4Double AimX = MakeVectorRegisterDouble(AimDirection.X, AimDirection.X, AimDirection.X, AimDirection.X);
+	const VectorRegister4Double AimY = MakeVectorRegisterDouble(AimDirection.Y, AimDirection.Y, AimDirection.Y, AimDirection.Y);
+	const VectorRegister4Double AimZ = MakeVectorRegisterDouble(AimDirection.Z, AimDirection.Z, AimDirection.Z, AimDirection.Z);
+	const VectorRegister4Double RightX = MakeVectorRegisterDouble(Right.X, Right.X, Right.X, Right.X);
+	const VectorRegister4Double RightY = MakeVectorRegisterDouble(Right.Y, Right.Y, Right.Y, Right.Y);
+	const VectorRegister4Double RightZ = MakeVectorRegisterDouble(Right.Z, Right.Z, Right.Z, Right.Z);
+	const VectorRegister4Double UpX = MakeVectorRegisterDouble(Up.X, Up.X, Up.X, Up.X);
+	const VectorRegister4Double UpY = MakeVectorRegisterDouble(Up.Y, Up.Y, Up.Y, Up.Y);
+	const VectorRegister4Double UpZ = MakeVectorRegisterDouble(Up.Z, Up.Z, Up.Z, Up.Z);
+
+	// blend the basis axes four pellets at a time
+	for (int32 Index = 0; Index < PaddedNum; Index += 4)
+	{
+		const VectorRegister4Double A = VectorLoad(AimWeight.GetData() + Index);
+		const VectorRegister4Double R = VectorLoad(RightWeight.GetData() + Index);
+		const VectorRegister4Double U = VectorLoad(UpWeight.GetData() + Index);
+
+		VectorStore(VectorMultiplyAdd(U, UpX, VectorMultiplyAdd(R, RightX, VectorMultiply(A, AimX))), DirX.GetData() + Index);
+		VectorStore(VectorMultiplyAdd(U, UpY, VectorMultiplyAdd(R, RightY, VectorMultiply(A, AimY))), DirY.GetData() + Index);
+		VectorStore(VectorMultiplyAdd(U, UpZ, VectorMultiplyAdd(R, RightZ, VectorMultiply(A, AimZ))), DirZ.GetData() + Index);
+	}
+}
 
 AShooterWeapon::AShooterWeapon()
 {
 	PrimaryActorTick.bCanEverTick = true;
 
+	// tick after animation so the cached muzzle transform matches this frame's pose
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+
 	// create the root
 	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
 
@@ -34,6 +123,8 @@ AShooterWeapon::AShooterWeapon()
 	ThirdPersonMesh->SetCollisionProfileName(FName("NoCollision"));
 	ThirdPersonMesh->SetFirstPersonPrimitiveType(EFirstPersonPrimitiveType::WorldSpaceRepresentation);
 	ThirdPersonMesh->bOwnerNoSee = true;
+
+	PelletDamageType = UDamageType::StaticClass();
 }
 
 void AShooterWeapon::BeginPlay()
@@ -43,23 +134,69 @@ void AShooterWeapon::BeginPlay()
 	// subscribe to the owner's destroyed delegate
 	GetOwner()->OnDestroyed.AddDynamic(this, &AShooterWeapon::OnOwnerDestroyed);
 
+	// bind the pellet trace callback
+	PelletTraceDelegate.BindUObject(this, &AShooterWeapon::OnPelletTraceCompleted);
+
+	// build the query params every weapon trace uses once. They ignore the weapon and its owner
+	CombatQueryParams.Init(this, FCollisionQueryParams(SCENE_QUERY_STAT(ShooterWeaponTrace), false, this), GetOwner());
+
 	// cast the weapon owner
 	WeaponOwner = Cast<IShooterWeaponHolder>(GetOwner());
 	PawnOwner = Cast<APawn>(GetOwner());
 
+	// find where to send predicted shots, if the owner predicts them
+	ShotBatch = GetOwner()->FindComponentByClass<UShooterShotBatchComponent>();
+
 	// fill the first ammo clip
 	CurrentBullets = MagazineSize;
 
+	// pick the fire routines for this weapon's settings
+	SelectFireMode();
+
+	// hash the class path once for the derived spread seed
+	ClassSeedHash = GetTypeHash(GetClass()->GetPathName());
+
+	// get some projectiles ready so the first shots don't hitch on spawning
+	PrewarmProjectilePool(GetWorld());
+
 	// attach the meshes to the owner
 	WeaponOwner->AttachWeaponMeshes(this);
+
+	// find the muzzle now that the meshes are in place
+	ResolveMuzzleSocket();
 }
 
 void AShooterWeapon::EndPlay(EEndPlayReason::Type EndPlayReason)
 {
 	Super::EndPlay(EndPlayReason);
 
-	// clear the refire timer
-	GetWorld()->GetTimerManager().ClearTimer(RefireTimer);
+	// cancel any pending shot
+	if (UShooterFireScheduler* FireScheduler = GetWorld()->GetSubsystem<UShooterFireScheduler>())
+	{
+		FireScheduler->CancelShot(this);
+	}
+
+	// take back the fire ability we granted, if the owner is sticking around
+	if (FireAbilityHandle.IsValid() && HasAuthority())
+	{
+		if (UAbilitySystemComponent* AbilitySystemComponent = UAbilitySystemGlobals::GetAbilitySystemComponentFromActor(GetOwner()))
+		{
+			AbilitySystemComponent->ClearAbility(FireAbilityHandle);
+		}
+
+		FireAbilityHandle = FGameplayAbilitySpecHandle();
+	}
+}
+
+void AShooterWeapon::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// inactive weapons can't shoot, so skip them
+	if (!IsHidden())
+	{
+		UpdateMuzzleTransformCache();
+	}
 }
 
 void AShooterWeapon::OnOwnerDestroyed(AActor* DestroyedActor)
@@ -73,14 +210,20 @@ void AShooterWeapon::ActivateWeapon()
 	// unhide this weapon
 	SetActorHiddenInGame(false);
 
+	// the owner may have changed since we last resolved the muzzle
+	ResolveMuzzleSocket();
+
+	// the fire settings may have changed since we were last active
+	SelectFireMode();
+
 	// notify the owner
 	WeaponOwner->OnWeaponActivated(this);
 }
 
 void AShooterWeapon::DeactivateWeapon()
 {
-	// ensure we're no longer firing this weapon while deactivated
-	StopFiring();
+	// ensure we're no longer firing this weapon while deactivated, even mid burst
+	CancelFiring();
 
 	// hide the weapon
 	SetActorHiddenInGame(true);
@@ -89,26 +232,40 @@ void AShooterWeapon::DeactivateWeapon()
 	WeaponOwner->OnWeaponDeactivated(this);
 }
 
-void AShooterWeapon::StartFiring()
+void AShooterWeapon::StartFiring(bool bHoldTrigger)
 {
+	// pulling the trigger again mid burst doesn't extend it, it only decides whether the next burst follows
+	if (IsBurstRunning())
+	{
+		bRefireWhileHeld = bHoldTrigger;
+		return;
+	}
+
 	// raise the firing flag
 	bIsFiring = true;
+	bRefireWhileHeld = bHoldTrigger;
+
+	// start a fresh burst
+	BurstShotsLeft = BurstCount;
 
 	// check how much time has passed since we last shot
 	// this may be under the refire rate if the weapon shoots slow enough and the player is spamming the trigger
-	const float TimeSinceLastShot = GetWorld()->GetTimeSeconds() - TimeOfLastShot;
+	const double Now = GetWorld()->GetTimeSeconds();
+	const double TimeSinceLastShot = Now - TimeOfLastShot;
 
 	if (TimeSinceLastShot > RefireRate)
 	{
 		// fire the weapon right away
-		Fire();
+		FireCadence.Start(Now);
+		FireDueShots();
 
 	} else {
 
-		// if we're full auto, schedule the next shot
-		if (bFullAuto)
+		// if we're refiring automatically, schedule the next shot for when the cooldown runs out
+		if (GetTriggerMode() != EShooterTriggerMode::SemiAuto || bRefireWhileHeld)
 		{
-			GetWorld()->GetTimerManager().SetTimer(RefireTimer, this, &AShooterWeapon::Fire, TimeSinceLastShot, false);
+			FireCadence.Start(TimeOfLastShot + RefireRate);
+			ScheduleNextShot(FireCadence.NextShotTime, false);
 		}
 
 	}
@@ -116,97 +273,447 @@ void AShooterWeapon::StartFiring()
 
 void AShooterWeapon::StopFiring()
 {
-	// lower the firing flag
+	// the trigger is up, so no further bursts follow
+	bRefireWhileHeld = false;
+
+	// a started burst always fires all of its shots
+	if (IsBurstRunning())
+	{
+		return;
+	}
+
+	CancelFiring();
+}
+
+void AShooterWeapon::CancelFiring()
+{
+	// lower the firing flags
 	bIsFiring = false;
+	bRefireWhileHeld = false;
+
+	// cancel any pending shot
+	if (UShooterFireScheduler* FireScheduler = GetWorld()->GetSubsystem<UShooterFireScheduler>())
+	{
+		FireScheduler->CancelShot(this);
+	}
+}
+
+void AShooterWeapon::SelectFireMode()
+{
+	FireRoutines = SelectShooterFireRoutines<AShooterWeapon>(GetTriggerMode(), PelletCount > 1, bInfiniteAmmo);
+}
+
+bool AShooterWeapon::IsBurstRunning() const
+{
+	return bIsFiring && GetTriggerMode() == EShooterTriggerMode::Burst && BurstShotsLeft > 0 && BurstShotsLeft < BurstCount;
+}
+
+EShooterTriggerMode AShooterWeapon::GetTriggerMode() const
+{
+	if (BurstCount > 1)
+	{
+		return EShooterTriggerMode::Burst;
+	}
 
-	// clear the refire timer
-	GetWorld()->GetTimerManager().ClearTimer(RefireTimer);
+	return bFullAuto ? EShooterTriggerMode::FullAuto : EShooterTriggerMode::SemiAuto;
 }
 
-void AShooterWeapon::Fire()
+void AShooterWeapon::FireDueShots()
 {
 	// ensure the player still wants to fire. They may have let go of the trigger
 	if (!bIsFiring)
 	{
 		return;
 	}
-	
-	// fire a projectile at the target
-	FireProjectile(WeaponOwner->GetWeaponTargetLocation());
 
-	// update the time of our last shot
-	TimeOfLastShot = GetWorld()->GetTimeSeconds();
+	// run the fire routine specialized for our fire mode
+	FireRoutines.FireDueShots(*this, GetWorld()->GetTimeSeconds(), GShooterMaxShotsPerFrame);
 
-	// make noise so the AI perception system can hear us
-	MakeNoise(ShotLoudness, PawnOwner, PawnOwner->GetActorLocation(), ShotNoiseRange, ShotNoiseTag);
+	// a burst fired after the trigger was released ends the firing on its last shot
+	if (GetTriggerMode() == EShooterTriggerMode::Burst && BurstShotsLeft <= 0)
+	{
+		bIsFiring = false;
+	}
+}
 
-	// are we full auto?
-	if (bFullAuto)
+void AShooterWeapon::FireConfirmedShot(uint32 ShotIndex, const FVector& TargetLocation, uint32 NumSkipped)
+{
+	// take the skipped rounds out of the server's magazine. An empty magazine reloads itself, so full magazines cost nothing extra
+	if (!bInfiniteAmmo && MagazineSize > 0)
 	{
-		// schedule the next shot
-		GetWorld()->GetTimerManager().SetTimer(RefireTimer, this, &AShooterWeapon::Fire, RefireRate, false);
-	} else {
+		for (uint32 Round = NumSkipped % MagazineSize; Round > 0; --Round)
+		{
+			FShooterMagazineAmmo::Consume(CurrentBullets, MagazineSize);
+		}
+	}
+
+	// replay the client's spread stream
+	ShotCounter = ShotIndex;
 
-		// for semi-auto weapons, schedule the cooldown notification
-		GetWorld()->GetTimerManager().SetTimer(RefireTimer, this, &AShooterWeapon::FireCooldownExpired, RefireRate, false);
+	// the client already played the feedback and runs its own trigger, so the server only fires the shot
+	const double Now = GetWorld()->GetTimeSeconds();
+	FireRoutines.FireConfirmedShot(*this, TargetLocation, Now, Now);
+}
 
+void AShooterWeapon::RecordPredictedShot(uint32 ShotIndex, const FVector& TargetLocation, double ShotAge)
+{
+	if (ShotBatch && ShotBatch->ShouldRecordShots())
+	{
+		ShotBatch->RecordShot(ShotIndex, TargetLocation, ShotAge);
 	}
 }
 
+void AShooterWeapon::AdvanceShot(double ShotTime)
+{
+	// advance to the next shot's random stream
+	++ShotCounter;
+
+	// update the time of our last shot
+	TimeOfLastShot = ShotTime;
+
+	// make noise so the AI perception system can hear us
+	UShooterNoiseSubsystem::ReportOrMakeNoise(this, ShotLoudness, PawnOwner, PawnOwner->GetActorLocation(), ShotNoiseRange, ShotNoiseTag);
+}
+
 void AShooterWeapon::FireCooldownExpired()
 {
 	// notify the owner
 	WeaponOwner->OnSemiWeaponRefire();
 }
 
-void AShooterWeapon::FireProjectile(const FVector& TargetLocation)
+void AShooterWeapon::ScheduleNextShot(double ShotTime, bool bCooldownOnly)
+{
+	if (UShooterFireScheduler* FireScheduler = GetWorld()->GetSubsystem<UShooterFireScheduler>())
+	{
+		FireScheduler->ScheduleShot(this, ShotTime, bCooldownOnly);
+	}
+}
+
+void AShooterWeapon::OnScheduledShotDue(bool bCooldownOnly)
+{
+	if (bCooldownOnly)
+	{
+		FireCooldownExpired();
+
+	} else {
+
+		FireDueShots();
+	}
+}
+
+void AShooterWeapon::FireProjectile(const FVector& TargetLocation, double ShotAge)
+{
+	// get the projectile transform, with spread drawn from this shot's stream
+	FRandomStream SpreadStream = MakeNextShotStream();
+	FTransform ProjectileTransform = CalculateProjectileSpawnTransform(TargetLocation, SpreadStream);
+
+	// back-date the projectile to when the shot was actually due
+	if (ShotAge > 0.0)
+	{
+		BackdateProjectileTransform(ProjectileTransform, ShotAge);
+	}
+
+	SpawnProjectile(ProjectileTransform);
+
+	// let remote clients show the shot. Projectiles carry their final direction, so no seed is needed
+	BroadcastShotEvent(ProjectileTransform.GetLocation(), ProjectileTransform.GetRotation().Vector(), 0);
+}
+
+void AShooterWeapon::BackdateProjectileTransform(FTransform& ProjectileTransform, double ShotAge) const
+{
+	const AShooterProjectile* ProjectileCDO = ProjectileClass ? ProjectileClass->GetDefaultObject<AShooterProjectile>() : nullptr;
+	const UProjectileMovementComponent* ProjectileMovement = ProjectileCDO ? ProjectileCDO->GetProjectileMovement() : nullptr;
+
+	if (!ProjectileMovement)
+	{
+		return;
+	}
+
+	const FVector Start = ProjectileTransform.GetLocation();
+	const FVector End = Start + ProjectileTransform.GetRotation().Vector() * (ProjectileMovement->InitialSpeed * ShotAge);
+
+	// don't advance through anything the projectile would have hit. It collides from the muzzle instead
+	FShooterCombatQueryScope QueryScope;
+	const FShooterQueryParamsRef QueryParams = CombatQueryParams.GetSelfParams();
+
+	if (!GetWorld()->LineTraceTestByChannel(Start, End, Shooter_ObjectChannel_Projectile, QueryParams))
+	{
+		ProjectileTransform.SetLocation(End);
+	}
+}
+
+void AShooterWeapon::SpawnProjectile(const FTransform& ProjectileTransform)
+{
+	// are we simulating projectiles as data?
+	UShooterProjectileSimulationSubsystem* ProjectileSimulation = bSimulateProjectiles ? GetWorld()->GetSubsystem<UShooterProjectileSimulationSubsystem>() : nullptr;
+
+	if (ProjectileSimulation)
+	{
+		// hand the projectile over to the simulation
+		ProjectileSimulation->LaunchProjectile(ProjectileClass, ProjectileTransform, GetOwner(), PawnOwner);
+
+	} else if (UShooterProjectilePoolSubsystem* ProjectilePool = GetWorld()->GetSubsystem<UShooterProjectilePoolSubsystem>()) {
+
+		// get the projectile from the world pool
+		ProjectilePool->AcquireProjectile(ProjectileClass, ProjectileTransform, GetOwner(), PawnOwner);
+
+	} else {
+
+		// no pool in this world, so spawn the projectile directly
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		SpawnParams.TransformScaleMethod = ESpawnActorScaleMethod::OverrideRootScale;
+		SpawnParams.Owner = GetOwner();
+		SpawnParams.Instigator = PawnOwner;
+
+		GetWorld()->SpawnActor<AShooterProjectile>(ProjectileClass, ProjectileTransform, SpawnParams);
+	}
+}
+
+void AShooterWeapon::FirePellets(const FVector& TargetLocation)
 {
-	// get the projectile transform
-	FTransform ProjectileTransform = CalculateProjectileSpawnTransform(TargetLocation);
-	
-	// spawn the projectile
-	FActorSpawnParameters SpawnParams;
-	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
-	SpawnParams.TransformScaleMethod = ESpawnActorScaleMethod::OverrideRootScale;
-	SpawnParams.Owner = GetOwner();
-	SpawnParams.Instigator = PawnOwner;
+	const FVector MuzzleLoc = GetMuzzleTransform().GetLocation();
+	const FVector AimDirection = (TargetLocation - MuzzleLoc).GetSafeNormal();
+
+	// build every pellet direction for this shot at once
+	FRandomStream PelletStream = MakeNextShotStream(PelletStreamSalt);
+	const int32 PelletSeed = PelletStream.GetInitialSeed();
+
+	PelletSpread.Build(AimDirection, PelletSpreadHalfAngle, PelletCount, PelletStream);
+
+	TracePellets(MuzzleLoc);
+
+	// let remote clients show the shot. They rebuild the same pellets from the seed
+	BroadcastShotEvent(MuzzleLoc, AimDirection, PelletSeed);
+}
+
+void AShooterWeapon::TracePellets(const FVector& MuzzleLoc)
+{
+	UWorld* World = GetWorld();
+	const UShooterHitboxRegistrySubsystem* HitboxRegistry = World->GetSubsystem<UShooterHitboxRegistrySubsystem>();
+
+	// lay the pellet rays and their character hits out in this frame's scratch memory
+	const TArrayView<FShooterHitboxRay> Rays = UShooterQueryScratchSubsystem::AllocateFrameArray<FShooterHitboxRay>(World, PelletSpread.Num);
+	const TArrayView<FShooterHitboxRayHit> CharacterHits = UShooterQueryScratchSubsystem::AllocateFrameArray<FShooterHitboxRayHit>(World, Rays.Num());
+
+	// pellets can't hit the weapon's owner
+	const int32 IgnoreOwner = HitboxRegistry ? HitboxRegistry->FindOwnerIndex(GetOwner()) : INDEX_NONE;
+
+	for (int32 Pellet = 0; Pellet < Rays.Num(); ++Pellet)
+	{
+		Rays[Pellet].Start = MuzzleLoc;
+		Rays[Pellet].End = MuzzleLoc + (PelletSpread.GetDirection(Pellet) * PelletRange);
+		Rays[Pellet].IgnoreOwner = IgnoreOwner;
+	}
+
+	// test the whole spread against the characters in one batch
+	if (HitboxRegistry)
+	{
+		HitboxRegistry->RaycastCharacters(Rays, CharacterHits);
+	}
 
-	AShooterProjectile* Projectile = GetWorld()->SpawnActor<AShooterProjectile>(ProjectileClass, ProjectileTransform, SpawnParams);
+	// ignore the weapon and its owner
+	FShooterCombatQueryScope QueryScope;
+	const FShooterQueryParamsRef QueryParams = CombatQueryParams.GetSelfParams();
 
+	// only world geometry goes through physics. Each pellet's async trace stops at the character it reached
+	// and carries the character along, so the callback can report it if nothing is in the way
+	for (int32 Pellet = 0; Pellet < Rays.Num(); ++Pellet)
+	{
+		const FShooterHitboxRayHit& CharacterHit = CharacterHits[Pellet];
+		const FVector End = CharacterHit.Owner != INDEX_NONE ? MuzzleLoc + (PelletSpread.GetDirection(Pellet) * CharacterHit.Distance) : Rays[Pellet].End;
+
+		World->AsyncLineTraceByObjectType(EAsyncTraceType::Single, MuzzleLoc, End, UShooterHitboxRegistrySubsystem::GetWorldObjectParams(), QueryParams, &PelletTraceDelegate, static_cast<uint32>(CharacterHit.Owner + 1));
+	}
+
+	INC_DWORD_STAT_BY(STAT_ShooterPelletTraces, Rays.Num());
+}
+
+void AShooterWeapon::BroadcastShotEvent(const FVector& Origin, const FVector& AimDirection, int32 Seed)
+{
+	// only the server sends shot events, and only when there's someone to receive them
+	if (!ShotBatch || !PawnOwner->HasAuthority() || GetNetMode() == NM_Standalone)
+	{
+		return;
+	}
+
+	ShotBatch->BroadcastShot(this, Origin, AimDirection, Seed);
+}
+
+void AShooterWeapon::FireCosmeticShot(const FVector& Origin, const FVector& AimDirection, int32 Seed)
+{
+	if (PelletCount > 1)
+	{
+		// rebuild the server's pellets from its seed
+		FRandomStream PelletStream(Seed);
+		PelletSpread.Build(AimDirection, PelletSpreadHalfAngle, PelletCount, PelletStream);
+
+		TracePellets(Origin);
+
+	} else {
+
+		SpawnProjectile(FTransform(AimDirection.Rotation(), Origin, FVector::OneVector));
+	}
+
+	// consume ammo so the display matches the server
+	if (!bInfiniteAmmo)
+	{
+		FShooterMagazineAmmo::Consume(CurrentBullets, MagazineSize);
+	}
+
+	// play feedback. Any damage is ignored, since clients never apply it
+	FinishShot();
+}
+
+void AShooterWeapon::FinishShot()
+{
 	// play the firing montage
 	WeaponOwner->PlayFiringMontage(FiringMontage);
 
 	// add recoil
 	WeaponOwner->AddWeaponRecoil(FiringRecoil);
 
-	// consume bullets
-	--CurrentBullets;
+	// update the weapon HUD
+	WeaponOwner->UpdateWeaponHUD(CurrentBullets, MagazineSize);
+}
+
+void AShooterWeapon::OnPelletTraceCompleted(const FTraceHandle& Handle, FTraceDatum& Data)
+{
+	const FHitResult* Hit = FHitResult::GetFirstBlockingHit(Data.OutHits);
+
+	// nothing in the way of the character the pellet reached, so the character takes the hit
+	FHitResult CharacterHitResult;
 
-	// if the clip is depleted, reload it
-	if (CurrentBullets <= 0)
+	if (!Hit && Data.UserData != 0)
 	{
-		CurrentBullets = MagazineSize;
+		if (const UShooterHitboxRegistrySubsystem* HitboxRegistry = GetWorld()->GetSubsystem<UShooterHitboxRegistrySubsystem>())
+		{
+			FShooterHitboxRayHit CharacterHit;
+			CharacterHit.Owner = static_cast<int32>(Data.UserData) - 1;
+			CharacterHit.Distance = FVector::Dist(Data.Start, Data.End);
+
+			const FVector RangeEnd = Data.Start + ((Data.End - Data.Start).GetSafeNormal() * PelletRange);
+
+			if (HitboxRegistry->MakeCharacterHit(Data.Start, RangeEnd, CharacterHit, CharacterHitResult))
+			{
+				Hit = &CharacterHitResult;
+			}
+		}
 	}
 
-	// update the weapon HUD
-	WeaponOwner->UpdateWeaponHUD(CurrentBullets, MagazineSize);
+	if (!Hit)
+	{
+		return;
+	}
+
+	// the damage queue merges all pellets hitting the same actor into one damage call
+	if (AActor* HitActor = Hit->GetActor())
+	{
+		UShooterDamageSubsystem::QueueOrApplyDamage(GetWorld(), HitActor, PelletDamage, PawnOwner ? PawnOwner->GetController() : nullptr, this, PelletDamageType);
+	}
+
+	// spawn the impact effects, deduplicated and budgeted with every other impact this frame
+	UShooterImpactEffectsSubsystem::QueueImpact(GetWorld(), *Hit, PelletImpactEffects);
+
+	// pass control to BP for any extra effects
+	BP_OnPelletHit(*Hit);
 }
 
-FTransform AShooterWeapon::CalculateProjectileSpawnTransform(const FVector& TargetLocation) const
+FTransform AShooterWeapon::CalculateProjectileSpawnTransform(const FVector& TargetLocation, FRandomStream& SpreadStream) const
 {
 	// find the muzzle location
-	const FVector MuzzleLoc = FirstPersonMesh->GetSocketLocation(MuzzleSocketName);
+	const FVector MuzzleLoc = GetMuzzleTransform().GetLocation();
 
 	// calculate the spawn location ahead of the muzzle
 	const FVector SpawnLoc = MuzzleLoc + ((TargetLocation - MuzzleLoc).GetSafeNormal() * MuzzleOffset);
 
 	// find the aim rotation vector while applying some variance to the target 
-	const FRotator AimRot = UKismetMathLibrary::FindLookAtRotation(SpawnLoc, TargetLocation + (UKismetMathLibrary::RandomUnitVector() * AimVariance));
+	const FRotator AimRot = UKismetMathLibrary::FindLookAtRotation(SpawnLoc, TargetLocation + (SpreadStream.VRand() * AimVariance));
 
 	// return the built transform
 	return FTransform(AimRot, SpawnLoc, FVector::OneVector);
 }
 
+void AShooterWeapon::ResolveMuzzleSocket()
+{
+	// shoot from the mesh the owner is actually seen holding
+	const bool bPlayerOwned = PawnOwner && PawnOwner->IsPlayerControlled();
+
+	MuzzleMesh = bPlayerOwned ? FirstPersonMesh : ThirdPersonMesh;
+	MuzzleSocketLocalTransform = FTransform::Identity;
+
+	if (const USkeletalMeshSocket* Socket = MuzzleMesh->GetSocketByName(MuzzleSocketName))
+	{
+		MuzzleBoneIndex = MuzzleMesh->GetBoneIndex(Socket->BoneName);
+		MuzzleSocketLocalTransform = Socket->GetSocketLocalTransform();
+
+	} else {
+
+		// the muzzle may be a bone instead of a socket
+		MuzzleBoneIndex = MuzzleMesh->GetBoneIndex(MuzzleSocketName);
+	}
+
+	// fill the cache so shots fired before our next tick are still valid
+	UpdateMuzzleTransformCache();
+}
+
+void AShooterWeapon::UpdateMuzzleTransformCache()
+{
+	const TArray<FTransform>& BoneTransforms = MuzzleMesh->GetComponentSpaceTransforms();
+
+	if (BoneTransforms.IsValidIndex(MuzzleBoneIndex))
+	{
+		CachedMuzzleTransform = MuzzleSocketLocalTransform * BoneTransforms[MuzzleBoneIndex];
+
+	} else {
+
+		// no muzzle on this mesh, so shoot from the mesh origin
+		CachedMuzzleTransform = FTransform::Identity;
+	}
+}
+
+FTransform AShooterWeapon::GetMuzzleTransform() const
+{
+	// the cache is in component space, so it follows any owner movement since it was filled
+	return CachedMuzzleTransform * MuzzleMesh->GetComponentTransform();
+}
+
+FRandomStream AShooterWeapon::MakeShotStream(int32 Seed, uint32 ShotIndex, uint32 Salt)
+{
+	// hash instead of advancing a single stream, so a lost or reordered shot can't desync the rest
+	return FRandomStream(static_cast<int32>(HashCombineFast(HashCombineFast(GetTypeHash(Seed), GetTypeHash(ShotIndex)), GetTypeHash(Salt))));
+}
+
+int32 AShooterWeapon::GetSpreadSeed() const
+{
+	if (SpreadSeed != 0)
+	{
+		return SpreadSeed;
+	}
+
+	// build the seed from data every machine shares, so predicted and confirmed shots draw the same spread
+	const APlayerState* PlayerState = PawnOwner ? PawnOwner->GetPlayerState() : nullptr;
+	const uint32 OwnerHash = PlayerState ? GetTypeHash(PlayerState->GetPlayerId()) : 0;
+	const int32 Seed = static_cast<int32>(HashCombineFast(OwnerHash, ClassSeedHash));
+
+	return Seed != 0 ? Seed : 1;
+}
+
+void AShooterWeapon::SetSpreadSeed(int32 NewSeed)
+{
+	SpreadSeed = NewSeed;
+	ShotCounter = 0;
+}
+
+void AShooterWeapon::PrewarmProjectilePool(UWorld* World) const
+{
+	// the pool tops up to the prewarm count, so calling this again once the weapon spawns is cheap
+	if (UShooterProjectilePoolSubsystem* ProjectilePool = World ? World->GetSubsystem<UShooterProjectilePoolSubsystem>() : nullptr)
+	{
+		ProjectilePool->PrewarmProjectiles(ProjectileClass, ProjectilePoolPrewarmCount);
+	}
+}
+
 const TSubclassOf<UAnimInstance>& AShooterWeapon::GetFirstPersonAnimInstanceClass() const
 {
 	return FirstPersonAnimInstanceClass;
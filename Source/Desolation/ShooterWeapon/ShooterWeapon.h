@@ -6,6 +6,12 @@
 #include "GameFramework/Actor.h"
 #include "ShooterWeaponHolder.h"
 #include "Animation/AnimInstance.h"
+#include "WorldCollision.h"
+#include "GameplayAbilitySpecHandle.h"
+#include "ShooterFireScheduler.h"
+#include "ShooterFireModes.h"
+#include "Combat/ShooterImpactEffects.h"
+#include "Combat/ShooterCombatQueryParams.h"
 #include "ShooterWeapon.generated.h"
 
 class UGameplayAbility;
@@ -15,6 +21,30 @@ class AShooterProjectile;
 class USkeletalMeshComponent;
 class UAnimMontage;
 class UAnimInstance;
+class UDamageType;
+class UShooterShotBatchComponent;
+
+/**
+ *  Pellet directions for one shot
+ *  Stored as separate component arrays so the directions can be built four at a time
+ */
+struct FShooterPelletSpread
+{
+	/** Direction components, padded to a multiple of four */
+	TArray<double> DirX, DirY, DirZ;
+
+	/** Per-pellet weights of the aim, right and up axes */
+	TArray<double> AimWeight, RightWeight, UpWeight;
+
+	/** Number of valid pellets */
+	int32 Num = 0;
+
+	/** Draws pellet offsets from the stream and builds every direction in one vectorized pass */
+	void Build(const FVector& AimDirection, float HalfAngle, int32 Count, FRandomStream& Stream);
+
+	/** Returns a pellet's direction */
+	FVector GetDirection(int32 Index) const { return FVector(DirX[Index], DirY[Index], DirZ[Index]); }
+};
 
 /**
  *  Base class for a simple first person shooter weapon
@@ -38,6 +68,9 @@ class DESOLATION_API AShooterWeapon : public AActor
 	UPROPERTY(EditAnywhere, Category="Components")
 	TSubclassOf<UGameplayAbility> WeaponFireAbility;
 
+	/** Spec handle of the fire ability granted to the owner for this weapon. Granted once when the weapon is picked up */
+	FGameplayAbilitySpecHandle FireAbilityHandle;
+
 protected:
 
 	/** Cast pointer to the weapon owner */
@@ -47,10 +80,22 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Ammo")
 	TSubclassOf<AShooterProjectile> ProjectileClass;
 
+	/** Number of projectiles to pre-warm in the world projectile pool when this weapon begins play */
+	UPROPERTY(EditAnywhere, Category="Ammo", meta = (ClampMin = 0))
+	int32 ProjectilePoolPrewarmCount = 10;
+
+	/** If true, projectiles are simulated as plain data by the projectile simulation subsystem instead of being spawned as actors */
+	UPROPERTY(EditAnywhere, Category="Ammo")
+	bool bSimulateProjectiles = false;
+
 	/** Number of bullets in a magazine */
 	UPROPERTY(EditAnywhere, Category="Ammo")
 	int32 MagazineSize = 10;
 
+	/** If true, shots don't use up the magazine */
+	UPROPERTY(EditAnywhere, Category="Ammo")
+	bool bInfiniteAmmo = false;
+
 	/** Number of bullets in the current magazine */
 	int32 CurrentBullets = 0;
 	
@@ -58,23 +103,74 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Animation")
 	UAnimMontage* FiringMontage;
 
-	/** AnimInstance class to set for the first person character mesh when this weapon is active */
+	/** AnimInstance class to set for the first person character mesh when this weapon is active. Only used if there's no first person anim layer class */
 	UPROPERTY(EditAnywhere, Category="Animation")
 	TSubclassOf<UAnimInstance> FirstPersonAnimInstanceClass;
 
-	/** AnimInstance class to set for the third person character mesh when this weapon is active */
+	/** AnimInstance class to set for the third person character mesh when this weapon is active. Only used if there's no third person anim layer class */
 	UPROPERTY(EditAnywhere, Category="Animation")
 	TSubclassOf<UAnimInstance> ThirdPersonAnimInstanceClass;
 
+	/** Anim layers to link into the first person character mesh's anim instance when this weapon is active */
+	UPROPERTY(EditAnywhere, Category="Animation")
+	TSubclassOf<UAnimInstance> FirstPersonAnimLayerClass;
+
+	/** Anim layers to link into the third person character mesh's anim instance when this weapon is active */
+	UPROPERTY(EditAnywhere, Category="Animation")
+	TSubclassOf<UAnimInstance> ThirdPersonAnimLayerClass;
+
 	/** Cone half-angle for variance while aiming */
 	UPROPERTY(EditAnywhere, Category="Aim")
 	float AimVariance = 0.0f;
 
+	/** Number of pellets fired per shot. Values over one fire hitscan pellets instead of projectiles */
+	UPROPERTY(EditAnywhere, Category="Pellets", meta = (ClampMin = 1))
+	int32 PelletCount = 1;
+
+	/** Cone half-angle in degrees that pellets spread across */
+	UPROPERTY(EditAnywhere, Category="Pellets", meta = (ClampMin = 0, ClampMax = 89))
+	float PelletSpreadHalfAngle = 5.0f;
+
+	/** Max distance a pellet can hit at */
+	UPROPERTY(EditAnywhere, Category="Pellets")
+	float PelletRange = 5000.0f;
+
+	/** Damage applied by each pellet that hits */
+	UPROPERTY(EditAnywhere, Category="Pellets")
+	float PelletDamage = 10.0f;
+
+	/** Type of damage applied by pellets */
+	UPROPERTY(EditAnywhere, Category="Pellets")
+	TSubclassOf<UDamageType> PelletDamageType;
+
+	/** Effects spawned through the pooled impact pipeline where pellets hit */
+	UPROPERTY(EditAnywhere, Category="Pellets")
+	FShooterImpactEffectSettings PelletImpactEffects;
+
+	/** Directions of the pellets in the current shot */
+	FShooterPelletSpread PelletSpread;
+
+	/** Called as each pellet's async trace completes */
+	FTraceDelegate PelletTraceDelegate;
+
+	/** Query params shared by the weapon's backdate and pellet traces, built once in BeginPlay */
+	FShooterCombatQueryParams CombatQueryParams;
+
+	/** Seed for this weapon's spread streams. Zero derives one from the owner's player id and the weapon class, so every machine agrees on it */
+	UPROPERTY(EditAnywhere, Category="Aim")
+	int32 SpreadSeed = 0;
+
+	/** Hash of the weapon class path. Unlike the class name's hash, it's the same on every machine */
+	uint32 ClassSeedHash = 0;
+
+	/** Number of shots fired so far. Together with the spread seed it identifies each shot's random stream */
+	uint32 ShotCounter = 0;
+
 	/** Amount of firing recoil to apply to the owner */
 	UPROPERTY(EditAnywhere, Category="Aim")
 	float FiringRecoil = 0.0f;
 
-	/** Name of the first person muzzle socket where projectiles will spawn */
+	/** Name of the muzzle socket where projectiles will spawn */
 	UPROPERTY(EditAnywhere, Category="Aim")
 	FName MuzzleSocketName;
 
@@ -82,26 +178,62 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Aim")
 	float MuzzleOffset = 10.0f;
 
+	/** Mesh the muzzle is read from. First person for player owners, third person for everyone else */
+	TObjectPtr<USkeletalMeshComponent> MuzzleMesh;
+
+	/** Index of the bone the muzzle socket is attached to on the muzzle mesh */
+	int32 MuzzleBoneIndex = INDEX_NONE;
+
+	/** Muzzle socket transform relative to its bone */
+	FTransform MuzzleSocketLocalTransform;
+
+	/** Muzzle transform in muzzle mesh component space, refreshed once per frame after animation */
+	FTransform CachedMuzzleTransform;
+
 	/** If true, this weapon will automatically fire at the refire rate */
 	UPROPERTY(EditAnywhere, Category="Refire")
 	bool bFullAuto = false;
 
-	/** Time between shots for this weapon. Affects both full auto and semi auto modes */
+	/** Shots fired per trigger pull. Values over one make this a burst weapon, overriding full auto */
+	UPROPERTY(EditAnywhere, Category="Refire", meta = (ClampMin = 0))
+	int32 BurstCount = 0;
+
+	/** Time between shots for this weapon. Affects full auto, burst and semi auto modes */
 	UPROPERTY(EditAnywhere, Category="Refire")
 	float RefireRate = 0.5f;
 
 	/** Game time of last shot fired, used to enforce refire rate on semi auto */
-	float TimeOfLastShot = 0.0f;
+	double TimeOfLastShot = 0.0;
+
+	/** Accumulates shot due times so every shot inside a frame fires at its exact time */
+	FShooterFireAccumulator FireCadence;
+
+	/** Scratch list of shot times that came due this frame */
+	TArray<double> DueShotTimes;
 
 	/** If true, the weapon is currently firing */
 	bool bIsFiring = false;
 
-	/** Timer to handle full auto refiring */
-	FTimerHandle RefireTimer;
+	/** If true, semi auto shots keep refiring at the refire rate for as long as the trigger is held */
+	bool bRefireWhileHeld = false;
+
+	/** Shots left in the current burst */
+	int32 BurstShotsLeft = 0;
+
+	/** Fire routines specialized for this weapon's trigger, emission and ammo configuration */
+	TShooterFireRoutines<AShooterWeapon> FireRoutines;
+
+	template<typename TTrigger, typename TEmission, typename TAmmo> friend struct TShooterFirePipeline;
+	friend struct FShooterProjectileEmission;
+	friend struct FShooterPelletEmission;
 
 	/** Cast pawn pointer to the owner for AI perception system interactions */
 	TObjectPtr<APawn> PawnOwner;
 
+	/** Owner component that sends predicted shots to the server, if the owner has one */
+	UPROPERTY()
+	TObjectPtr<UShooterShotBatchComponent> ShotBatch;
+
 	/** Loudness of the shot for AI perception system interactions */
 	UPROPERTY(EditAnywhere, Category="Perception")
 	float ShotLoudness = 1.0f;
@@ -122,6 +254,12 @@ public:
 	// Getter for the WeaponFire Ability
 	FORCEINLINE TSubclassOf<UGameplayAbility> GetWeaponFireAbility() const { return WeaponFireAbility; }
 
+	/** Returns the spec handle of the fire ability granted for this weapon */
+	const FGameplayAbilitySpecHandle& GetFireAbilityHandle() const { return FireAbilityHandle; }
+
+	/** Caches the spec handle of the fire ability granted for this weapon */
+	void SetFireAbilityHandle(const FGameplayAbilitySpecHandle& Handle) { FireAbilityHandle = Handle; }
+
 protected:
 	
 	/** Gameplay initialization */
@@ -130,6 +268,11 @@ protected:
 	/** Gameplay Cleanup */
 	virtual void EndPlay(EEndPlayReason::Type EndPlayReason) override;
 
+public:
+
+	/** Refreshes the cached muzzle transform */
+	virtual void Tick(float DeltaTime) override;
+
 protected:
 
 	/** Called when the weapon's owner is destroyed */
@@ -144,28 +287,118 @@ public:
 	/** Deactivates this weapon */
 	void DeactivateWeapon();
 
-	/** Start firing this weapon */
-	void StartFiring();
+	/** Start firing this weapon. If bHoldTrigger is set, semi auto weapons keep refiring until StopFiring is called */
+	void StartFiring(bool bHoldTrigger = false);
 
-	/** Stop firing this weapon */
+	/** Releases the trigger. A burst that has already started still fires its remaining shots */
 	void StopFiring();
 
+	/** Stops firing right away, cutting any running burst short */
+	void CancelFiring();
+
 protected:
 
-	/** Fire the weapon */
-	virtual void Fire();
+	/** Returns true if a burst has fired its first shot and still has shots left */
+	bool IsBurstRunning() const;
+
+	/** Picks the specialized fire routines for the current trigger, emission and ammo settings */
+	void SelectFireMode();
+
+	/** Returns the trigger mode the weapon settings describe */
+	EShooterTriggerMode GetTriggerMode() const;
+
+	/** Fires every shot that has come due since the last frame, then schedules the next one */
+	void FireDueShots();
+
+	/** Returns where the owner wants the next shot to go */
+	FVector GetShotTargetLocation() const { return WeaponOwner->GetWeaponTargetLocation(); }
+
+	/** Sends a predicted shot to the server, if the owner predicts its shots */
+	void RecordPredictedShot(uint32 ShotIndex, const FVector& TargetLocation, double ShotAge);
+
+	/** Advances to the next shot's random stream and makes the shot's noise */
+	void AdvanceShot(double ShotTime);
 
 	/** Called when the refire rate time has passed while shooting semi auto weapons */
 	void FireCooldownExpired();
 
-	/** Fire a projectile towards the target location */
-	virtual void FireProjectile(const FVector& TargetLocation);
+	/** Schedules the next shot, or only the cooldown notification, with the world fire scheduler */
+	void ScheduleNextShot(double ShotTime, bool bCooldownOnly);
+
+public:
+
+	/** Called by the world fire scheduler when this weapon's pending shot or cooldown is due */
+	void OnScheduledShotDue(bool bCooldownOnly);
+
+	/** Fires a client predicted shot on the server once it has been validated, replaying the client's spread. Skipped shot indices are charged as fired rounds */
+	void FireConfirmedShot(uint32 ShotIndex, const FVector& TargetLocation, uint32 NumSkipped = 0);
+
+protected:
+
+	/** Fire a projectile towards the target location. Shots due earlier in the frame are advanced by their age */
+	void FireProjectile(const FVector& TargetLocation, double ShotAge = 0.0);
+
+	/** Advances a projectile spawn transform along its flight by the given time, unless something is in the way */
+	void BackdateProjectileTransform(FTransform& ProjectileTransform, double ShotAge) const;
+
+	/** Spawns or simulates a projectile with the given transform */
+	void SpawnProjectile(const FTransform& ProjectileTransform);
+
+	/** Fire a spread of hitscan pellets towards the target location */
+	void FirePellets(const FVector& TargetLocation);
+
+	/** Tests the current spread against the hitbox registry as one batch, then issues one async world geometry trace per pellet */
+	void TracePellets(const FVector& MuzzleLoc);
 
-	/** Calculates the spawn transform for projectiles shot by this weapon */
-	FTransform CalculateProjectileSpawnTransform(const FVector& TargetLocation) const;
+	/** Sends a compact shot event to remote clients so they can show the shot without a replicated projectile */
+	void BroadcastShotEvent(const FVector& Origin, const FVector& AimDirection, int32 Seed);
 
 public:
 
+	/** Shows a shot fired on the server by a remote owner. Spawns local projectiles or pellet traces only */
+	void FireCosmeticShot(const FVector& Origin, const FVector& AimDirection, int32 Seed);
+
+protected:
+
+	/** Plays shot feedback on the owner and updates the ammo display */
+	void FinishShot();
+
+	/** Queues the damage of a completed pellet trace. Reports the character the pellet reached if no world geometry was in the way */
+	void OnPelletTraceCompleted(const FTraceHandle& Handle, FTraceDatum& Data);
+
+	/** Passes control to Blueprint to implement any effects on pellet hit */
+	UFUNCTION(BlueprintImplementableEvent, Category="Weapon", meta=(DisplayName = "On Pellet Hit"))
+	void BP_OnPelletHit(const FHitResult& Hit);
+
+	/** Calculates the spawn transform for projectiles shot by this weapon, drawing spread from the given stream */
+	FTransform CalculateProjectileSpawnTransform(const FVector& TargetLocation, FRandomStream& SpreadStream) const;
+
+	/** Picks the muzzle mesh for the current owner and resolves the muzzle socket's bone on it */
+	void ResolveMuzzleSocket();
+
+	/** Copies the animated muzzle transform into the cache */
+	void UpdateMuzzleTransformCache();
+
+public:
+
+	/** Returns the world space muzzle transform from the cache */
+	FTransform GetMuzzleTransform() const;
+
+	/** Returns the random stream for a shot. Any machine can rebuild it from the seed, shot index and salt alone */
+	static FRandomStream MakeShotStream(int32 Seed, uint32 ShotIndex, uint32 Salt = 0);
+
+	/** Returns the random stream for the next shot this weapon will fire. Use a different salt for each independent random decision */
+	FRandomStream MakeNextShotStream(uint32 Salt = 0) const { return MakeShotStream(GetSpreadSeed(), ShotCounter, Salt); }
+
+	/** Sets the spread seed and restarts the shot counter, so the following shots repeat a known pattern */
+	void SetSpreadSeed(int32 NewSeed);
+
+	/** Returns the spread seed. Derived seeds are rebuilt on every call, since the owner's player state may replicate after the weapon spawns */
+	int32 GetSpreadSeed() const;
+
+	/** Returns the number of shots fired so far */
+	uint32 GetShotCounter() const { return ShotCounter; }
+
 	/** Returns the first person mesh */
 	UFUNCTION(BlueprintPure, Category="Weapon")
 	USkeletalMeshComponent* GetFirstPersonMesh() const { return FirstPersonMesh; };
@@ -180,9 +413,21 @@ public:
 	/** Returns the third person anim instance class */
 	const TSubclassOf<UAnimInstance>& GetThirdPersonAnimInstanceClass() const;
 
+	/** Returns the first person anim layer class */
+	const TSubclassOf<UAnimInstance>& GetFirstPersonAnimLayerClass() const { return FirstPersonAnimLayerClass; }
+
+	/** Returns the third person anim layer class */
+	const TSubclassOf<UAnimInstance>& GetThirdPersonAnimLayerClass() const { return ThirdPersonAnimLayerClass; }
+
 	/** Returns the magazine size */
 	int32 GetMagazineSize() const { return MagazineSize; };
 
+	/** Gets this weapon's projectiles ready in the world's pool, so the first shots don't hitch on spawning. Safe to call on the default object */
+	void PrewarmProjectilePool(UWorld* World) const;
+
+	/** Returns the time in seconds between shots */
+	float GetRefireRate() const { return RefireRate; }
+
 	/** Returns the current bullet count */
 	int32 GetBulletCount() const { return CurrentBullets; }
 };
@@ -0,0 +1,225 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+
+#include "ShooterWeapon/ShooterWeaponRegistry.h"
+#include "ShooterPickup.h"
+#include "ShooterWeapon.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY(LogShooterWeaponRegistry);
+
+static FAutoConsoleCommandWithWorld GShooterPrefetchDumpCommand(
+	TEXT("Shooter.Prefetch.Dump"),
+	TEXT("Logs weapon prefetch hit rate and the load time it saved"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (const UShooterWeaponRegistry* WeaponRegistry = UShooterWeaponRegistry::Get(World))
+		{
+			WeaponRegistry->DumpPrefetchStats();
+		}
+	}));
+
+UShooterWeaponRegistry* UShooterWeaponRegistry::Get(const UObject* WorldContextObject)
+{
+	const UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	const UGameInstance* GameInstance = World ? World->GetGameInstance() : nullptr;
+
+	return GameInstance ? GameInstance->GetSubsystem<UShooterWeaponRegistry>() : nullptr;
+}
+
+int32 UShooterWeaponRegistry::ResolveRow(const FDataTableRowHandle& RowHandle)
+{
+	if (!RowHandle.DataTable)
+	{
+		return INDEX_NONE;
+	}
+
+	// flatten the table the first time we see it
+	if (!RegisteredTables.Contains(RowHandle.DataTable))
+	{
+		RegisterTable(RowHandle.DataTable);
+	}
+
+	const int32* DefinitionIndex = RowLookup.Find(MakeTuple(RowHandle.DataTable.Get(), RowHandle.RowName));
+
+	return DefinitionIndex ? *DefinitionIndex : INDEX_NONE;
+}
+
+void UShooterWeaponRegistry::RegisterTable(const UDataTable* Table)
+{
+	RegisteredTables.Add(Table);
+
+	if (Table->GetRowStruct() != FWeaponTableRow::StaticStruct())
+	{
+		UE_LOG(LogShooterWeaponRegistry, Warning, TEXT("%s doesn't use FWeaponTableRow rows"), *GetNameSafe(Table));
+		return;
+	}
+
+	Table->ForeachRow<FWeaponTableRow>(TEXT("UShooterWeaponRegistry::RegisterTable"), [this, Table](const FName& RowName, const FWeaponTableRow& Row)
+	{
+		FShooterWeaponDefinition& Definition = Definitions.AddDefaulted_GetRef();
+		Definition.RowName = RowName;
+		Definition.PickupMeshPath = Row.StaticMesh;
+		Definition.WeaponClassPath = Row.WeaponToSpawn;
+
+		RowLookup.Add(MakeTuple(Table, RowName), Definitions.Num() - 1);
+	});
+}
+
+void UShooterWeaponRegistry::RequestBundle(int32 DefinitionIndex, EShooterWeaponBundle Bundle, FSimpleDelegate OnLoaded)
+{
+	if (!Definitions.IsValidIndex(DefinitionIndex))
+	{
+		return;
+	}
+
+	const int32 BundleIndex = static_cast<int32>(Bundle);
+	FShooterWeaponDefinition& Definition = Definitions[DefinitionIndex];
+
+	// nothing to wait for
+	if (Definition.bBundleLoaded[BundleIndex])
+	{
+		OnLoaded.ExecuteIfBound();
+		return;
+	}
+
+	// queue the callback first, since the load may complete right away if the assets are already in memory
+	if (OnLoaded.IsBound())
+	{
+		Definition.PendingCallbacks[BundleIndex].Add(MoveTemp(OnLoaded));
+	}
+
+	// is the bundle already streaming?
+	if (Definition.BundleHandles[BundleIndex].IsValid())
+	{
+		return;
+	}
+
+	const FSoftObjectPath AssetPath = Bundle == EShooterWeaponBundle::Pickup ? Definition.PickupMeshPath.ToSoftObjectPath() : Definition.WeaponClassPath.ToSoftObjectPath();
+
+	if (AssetPath.IsNull())
+	{
+		OnBundleLoaded(DefinitionIndex, Bundle);
+		return;
+	}
+
+	Definition.BundleRequestTime[BundleIndex] = FPlatformTime::Seconds();
+	Definition.BundleHandles[BundleIndex] = UAssetManager::GetStreamableManager().RequestAsyncLoad(AssetPath,
+		FStreamableDelegate::CreateUObject(this, &UShooterWeaponRegistry::OnBundleLoaded, DefinitionIndex, Bundle),
+		FStreamableManager::AsyncLoadHighPriority);
+}
+
+bool UShooterWeaponRegistry::IsBundleLoaded(int32 DefinitionIndex, EShooterWeaponBundle Bundle) const
+{
+	return Definitions.IsValidIndex(DefinitionIndex) && Definitions[DefinitionIndex].bBundleLoaded[static_cast<int32>(Bundle)];
+}
+
+UStaticMesh* UShooterWeaponRegistry::GetPickupMesh(int32 DefinitionIndex) const
+{
+	return Definitions.IsValidIndex(DefinitionIndex) ? Definitions[DefinitionIndex].PickupMesh.Get() : nullptr;
+}
+
+TSubclassOf<AShooterWeapon> UShooterWeaponRegistry::GetWeaponClass(int32 DefinitionIndex) const
+{
+	return Definitions.IsValidIndex(DefinitionIndex) ? Definitions[DefinitionIndex].WeaponClass : nullptr;
+}
+
+void UShooterWeaponRegistry::OnBundleLoaded(int32 DefinitionIndex, EShooterWeaponBundle Bundle)
+{
+	const int32 BundleIndex = static_cast<int32>(Bundle);
+	FShooterWeaponDefinition& Definition = Definitions[DefinitionIndex];
+
+	// resolve the loaded assets
+	if (Bundle == EShooterWeaponBundle::Pickup)
+	{
+		Definition.PickupMesh = Definition.PickupMeshPath.Get();
+
+	} else {
+
+		Definition.WeaponClass = Definition.WeaponClassPath.Get();
+
+		PrewarmWeaponClass(Definition.WeaponClass);
+
+		// measure how long a pickup would have waited on this bundle
+		const double Now = FPlatformTime::Seconds();
+		Definition.EquipLoadSeconds = Definition.BundleRequestTime[BundleIndex] > 0.0 ? Now - Definition.BundleRequestTime[BundleIndex] : 0.0;
+
+		if (Definition.bDemandMissed)
+		{
+			DemandWaitSeconds += Now - Definition.DemandMissTime;
+		}
+	}
+
+	Definition.bBundleLoaded[BundleIndex] = true;
+
+	// run the callbacks. Move them out first, since a callback may request more bundles
+	TArray<FSimpleDelegate> Callbacks = MoveTemp(Definition.PendingCallbacks[BundleIndex]);
+
+	for (const FSimpleDelegate& Callback : Callbacks)
+	{
+		Callback.ExecuteIfBound();
+	}
+}
+
+void UShooterWeaponRegistry::PrewarmWeaponClass(TSubclassOf<AShooterWeapon> WeaponClass) const
+{
+	UWorld* World = GetGameInstance()->GetWorld();
+
+	if (!WeaponClass || !World)
+	{
+		return;
+	}
+
+	// the weapon's meshes, anim classes and fire ability are hard references, so loading the class already brought them in.
+	// What's left for the first spawn is filling the projectile pool, so do that now instead of on pickup
+	WeaponClass->GetDefaultObject<AShooterWeapon>()->PrewarmProjectilePool(World);
+}
+
+void UShooterWeaponRegistry::RecordGrantAttempt(int32 DefinitionIndex, bool bEquipLoaded)
+{
+	if (!Definitions.IsValidIndex(DefinitionIndex))
+	{
+		return;
+	}
+
+	FShooterWeaponDefinition& Definition = Definitions[DefinitionIndex];
+
+	if (bEquipLoaded)
+	{
+		// grants after a miss only had to wait part of the load, so they don't count as hits
+		if (Definition.bDemandMissed)
+		{
+			return;
+		}
+
+		++NumPrefetchHits;
+
+		// the load time is only saved once per definition
+		if (!Definition.bPrefetchCredited)
+		{
+			Definition.bPrefetchCredited = true;
+			PrefetchSecondsSaved += Definition.EquipLoadSeconds;
+		}
+
+	} else if (!Definition.bDemandMissed) {
+
+		// the pickup manager retries every poll, so only count the first wait
+		Definition.bDemandMissed = true;
+		Definition.DemandMissTime = FPlatformTime::Seconds();
+
+		++NumPrefetchMisses;
+	}
+}
+
+void UShooterWeaponRegistry::DumpPrefetchStats() const
+{
+	const int32 NumAttempts = NumPrefetchHits + NumPrefetchMisses;
+
+	UE_LOG(LogShooterWeaponRegistry, Log, TEXT("Weapon prefetch: hits %d, misses %d (%.1f%% hit rate), load time saved %.1fms, time spent waiting %.1fms"),
+		NumPrefetchHits, NumPrefetchMisses, NumAttempts > 0 ? 100.0f * NumPrefetchHits / NumAttempts : 0.0f,
+		PrefetchSecondsSaved * 1000.0, DemandWaitSeconds * 1000.0);
+}
@@ -0,0 +1,151 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Engine/DataTable.h"
+#include "ShooterWeaponRegistry.generated.h"
+
+class AShooterWeapon;
+class UStaticMesh;
+struct FStreamableHandle;
+
+DECLARE_LOG_CATEGORY_EXTERN(LogShooterWeaponRegistry, Log, All);
+
+/**
+ *  Groups of assets that are streamed in together for a weapon definition
+ */
+enum class EShooterWeaponBundle : uint8
+{
+	/** Assets needed to display a pickup */
+	Pickup,
+
+	/** Assets needed to equip the weapon. The weapon class brings its anim instance classes with it */
+	Equip,
+
+	Count
+};
+
+/**
+ *  A weapon table row resolved into a flat, index addressed definition
+ */
+USTRUCT()
+struct FShooterWeaponDefinition
+{
+	GENERATED_BODY()
+
+	/** Table row this definition was built from */
+	FName RowName;
+
+	/** Mesh to display on the pickup */
+	TSoftObjectPtr<UStaticMesh> PickupMeshPath;
+
+	/** Weapon class to grant on pickup */
+	TSoftClassPtr<AShooterWeapon> WeaponClassPath;
+
+	/** Pickup mesh, once the pickup bundle has loaded */
+	UPROPERTY()
+	TObjectPtr<UStaticMesh> PickupMesh;
+
+	/** Weapon class, once the equip bundle has loaded */
+	UPROPERTY()
+	TSubclassOf<AShooterWeapon> WeaponClass;
+
+	/** Streaming handle for each bundle. Keeps the loaded assets in memory */
+	TSharedPtr<FStreamableHandle> BundleHandles[static_cast<int32>(EShooterWeaponBundle::Count)];
+
+	/** Callbacks waiting on each bundle */
+	TArray<FSimpleDelegate> PendingCallbacks[static_cast<int32>(EShooterWeaponBundle::Count)];
+
+	/** If true, the bundle has finished loading */
+	bool bBundleLoaded[static_cast<int32>(EShooterWeaponBundle::Count)] = { false, false };
+
+	/** Platform time each bundle was first requested at */
+	double BundleRequestTime[static_cast<int32>(EShooterWeaponBundle::Count)] = { 0.0, 0.0 };
+
+	/** Time in seconds it took to stream the equip bundle and fill the projectile pool */
+	double EquipLoadSeconds = 0.0;
+
+	/** Platform time a pickup first had to wait on the equip bundle */
+	double DemandMissTime = 0.0;
+
+	/** If true, a pickup was touched before the equip bundle finished loading */
+	bool bDemandMissed = false;
+
+	/** If true, the equip load time has already been counted as saved */
+	bool bPrefetchCredited = false;
+};
+
+/**
+ *  Resolves weapon data table rows once into a flat definition table and streams their assets in asynchronously
+ *  through the Asset Manager, so map load and pickups never block on disk
+ */
+UCLASS()
+class DESOLATION_API UShooterWeaponRegistry : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+	/** Flattened weapon definitions */
+	UPROPERTY()
+	TArray<FShooterWeaponDefinition> Definitions;
+
+	/** Tables that have been flattened into the definitions */
+	UPROPERTY()
+	TArray<TObjectPtr<const UDataTable>> RegisteredTables;
+
+	/** Maps table rows to their definition index. Only used when resolving a row handle */
+	TMap<TTuple<const UDataTable*, FName>, int32> RowLookup;
+
+	/** Number of grants that found their equip bundle already loaded */
+	int32 NumPrefetchHits = 0;
+
+	/** Number of definitions a pickup had to wait on */
+	int32 NumPrefetchMisses = 0;
+
+	/** Total load time that was hidden from pickups by prefetching, in seconds */
+	double PrefetchSecondsSaved = 0.0;
+
+	/** Total time pickups spent waiting on equip bundles, in seconds */
+	double DemandWaitSeconds = 0.0;
+
+public:
+
+	/** Returns the registry for the object's game instance */
+	static UShooterWeaponRegistry* Get(const UObject* WorldContextObject);
+
+	/** Flattens the row's table if needed and returns the row's definition index, or INDEX_NONE */
+	int32 ResolveRow(const FDataTableRowHandle& RowHandle);
+
+	/** Starts streaming a definition's bundle. The callback runs once it's loaded, right away if it already is */
+	void RequestBundle(int32 DefinitionIndex, EShooterWeaponBundle Bundle, FSimpleDelegate OnLoaded);
+
+	/** Returns true if the definition's bundle has finished loading */
+	bool IsBundleLoaded(int32 DefinitionIndex, EShooterWeaponBundle Bundle) const;
+
+	/** Returns a definition's pickup mesh, or nullptr if it hasn't loaded yet */
+	UStaticMesh* GetPickupMesh(int32 DefinitionIndex) const;
+
+	/** Returns a definition's weapon class, or nullptr if it hasn't loaded yet */
+	TSubclassOf<AShooterWeapon> GetWeaponClass(int32 DefinitionIndex) const;
+
+	/** Returns the number of definitions */
+	int32 GetNumDefinitions() const { return Definitions.Num(); }
+
+	/** Records a pickup trying to grant a definition's weapon, for prefetch statistics */
+	void RecordGrantAttempt(int32 DefinitionIndex, bool bEquipLoaded);
+
+	/** Logs prefetch hit rate and time saved */
+	void DumpPrefetchStats() const;
+
+protected:
+
+	/** Flattens every row of the table into the definitions */
+	void RegisterTable(const UDataTable* Table);
+
+	/** Resolves a bundle's assets and runs its callbacks */
+	void OnBundleLoaded(int32 DefinitionIndex, EShooterWeaponBundle Bundle);
+
+	/** Fills the world's projectile pool for a loaded weapon class, so the first pickup doesn't spawn them */
+	void PrewarmWeaponClass(TSubclassOf<AShooterWeapon> WeaponClass) const;
+};
@@ -5,17 +5,25 @@
 #include "ShooterWeapon/ShooterWeapon.h"
 #include "Components/SkeletalMeshComponent.h"
 #include "Camera/CameraComponent.h"
-#include "Kismet/KismetMathLibrary.h"
 #include "Engine/World.h"
 #include "Gamemode/DesolationGameMode.h"
 #include "Components/CapsuleComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "TimerManager.h"
+#include "Combat/ShooterLagCompensation.h"
+#include "Combat/ShooterHitboxRegistry.h"
+#include "Combat/ShooterDamageSubsystem.h"
+
+/** Salt for the NPC aim error stream, keeping it independent from the weapon's own spread */
+static constexpr uint32 NPCAimStreamSalt = 0x41494D;
 
 void AShooterNPC::BeginPlay()
 {
 	Super::BeginPlay();
 
+	// build the query params every combat trace of ours starts from
+	CombatQueryParams.Init(this, FCollisionQueryParams(SCENE_QUERY_STAT(ShooterNPCCombatQuery), false, this));
+
 	// spawn the weapon
 	FActorSpawnParameters SpawnParams;
 	SpawnParams.Owner = this;
@@ -23,12 +31,35 @@ void AShooterNPC::BeginPlay()
 	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
 
 	Weapon = GetWorld()->SpawnActor<AShooterWeapon>(WeaponClass, GetActorTransform(), SpawnParams);
+
+	// record our hitboxes so remote shots against us can be rewound
+	if (UShooterLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UShooterLagCompensationSubsystem>())
+	{
+		LagCompensation->RegisterCharacter(this);
+	}
+
+	// make our capsule hittable by registry traces
+	if (UShooterHitboxRegistrySubsystem* HitboxRegistry = GetWorld()->GetSubsystem<UShooterHitboxRegistrySubsystem>())
+	{
+		HitboxRegistry->RegisterCharacter(this);
+	}
 }
 
 void AShooterNPC::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	Super::EndPlay(EndPlayReason);
 
+	// stop recording our hitboxes
+	if (UShooterLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UShooterLagCompensationSubsystem>())
+	{
+		LagCompensation->UnregisterCharacter(this);
+	}
+
+	if (UShooterHitboxRegistrySubsystem* HitboxRegistry = GetWorld()->GetSubsystem<UShooterHitboxRegistrySubsystem>())
+	{
+		HitboxRegistry->UnregisterCharacter(this);
+	}
+
 	// clear the death timer
 	GetWorld()->GetTimerManager().ClearTimer(DeathTimer);
 }
@@ -47,7 +78,8 @@ float AShooterNPC::TakeDamage(float Damage, struct FDamageEvent const& DamageEve
 	// Have we depleted HP?
 	if (CurrentHP <= 0.0f)
 	{
-		Die();
+		// die once all of this frame's damage has been applied
+		UShooterDamageSubsystem::QueueOrResolveDeath(GetWorld(), this, FSimpleDelegate::CreateUObject(this, &AShooterNPC::Die));
 	}
 
 	return Damage;
@@ -82,11 +114,16 @@ void AShooterNPC::UpdateWeaponHUD(int32 CurrentAmmo, int32 MagazineSize)
 
 FVector AShooterNPC::GetWeaponTargetLocation()
 {
+	FShooterCombatQueryScope QueryScope;
+
 	// start aiming from the camera location
 	const FVector AimSource = GetFirstPersonCameraComponent()->GetComponentLocation();
 
 	FVector AimDir, AimTarget = FVector::ZeroVector;
 
+	// draw aim error from the weapon's stream for this shot, salted so it doesn't mirror the weapon spread
+	FRandomStream AimStream = Weapon ? Weapon->MakeNextShotStream(NPCAimStreamSalt) : FRandomStream(NPCAimStreamSalt);
+
 	// do we have an aim target?
 	if (CurrentAimTarget)
 	{
@@ -94,30 +131,34 @@ FVector AShooterNPC::GetWeaponTargetLocation()
 		AimTarget = CurrentAimTarget->GetActorLocation();
 
 		// apply a vertical offset to target head/feet
-		AimTarget.Z += FMath::RandRange(MinAimOffsetZ, MaxAimOffsetZ);
+		AimTarget.Z += AimStream.FRandRange(MinAimOffsetZ, MaxAimOffsetZ);
 
 		// get the aim direction and apply randomness in a cone
 		AimDir = (AimTarget - AimSource).GetSafeNormal();
-		AimDir = UKismetMathLibrary::RandomUnitVectorInConeInDegrees(AimDir, AimVarianceHalfAngle);
+		AimDir = AimStream.VRandCone(AimDir, FMath::DegreesToRadians(AimVarianceHalfAngle));
 
 		
 	} else {
 
 		// no aim target, so just use the camera facing
-		AimDir = UKismetMathLibrary::RandomUnitVectorInConeInDegrees(GetFirstPersonCameraComponent()->GetForwardVector(), AimVarianceHalfAngle);
+		AimDir = AimStream.VRandCone(GetFirstPersonCameraComponent()->GetForwardVector(), FMath::DegreesToRadians(AimVarianceHalfAngle));
 
 	}
 
 	// calculate the unobstructed aim target location
 	AimTarget = AimSource + (AimDir * AimRange);
 
-	// run a visibility trace to see if there's obstructions
+	// test characters against the hitbox registry and only trace world geometry through physics
 	FHitResult OutHit;
 
-	FCollisionQueryParams QueryParams;
-	QueryParams.AddIgnoredActor(this);
+	if (const UShooterHitboxRegistrySubsystem* HitboxRegistry = GetWorld()->GetSubsystem<UShooterHitboxRegistrySubsystem>())
+	{
+		HitboxRegistry->Trace(AimSource, AimTarget, this, CombatQueryParams.GetSelfParams(), OutHit);
 
-	GetWorld()->LineTraceSingleByChannel(OutHit, AimSource, AimTarget, ECC_Visibility, QueryParams);
+	} else {
+
+		GetWorld()->LineTraceSingleByChannel(OutHit, AimSource, AimTarget, ECC_Visibility, CombatQueryParams.GetSelfParams());
+	}
 
 	// return either the impact point or the trace end
 	return OutHit.bBlockingHit ? OutHit.ImpactPoint : OutHit.TraceEnd;
@@ -140,12 +181,7 @@ void AShooterNPC::OnWeaponDeactivated(AShooterWeapon* InWeapon)
 
 void AShooterNPC::OnSemiWeaponRefire()
 {
-	// are we still shooting?
-	if (bIsShooting)
-	{
-		// fire the weapon
-		Weapon->StartFiring();
-	}
+	// unused. The weapon keeps refiring on its own while we hold the trigger
 }
 
 void AShooterNPC::Die()
@@ -166,6 +202,17 @@ void AShooterNPC::Die()
 		//GM->IncrementTeamScore(TeamByte);
 	}
 
+	// ragdolls can't be shot, so stop recording our hitboxes
+	if (UShooterLagCompensationSubsystem* LagCompensation = GetWorld()->GetSubsystem<UShooterLagCompensationSubsystem>())
+	{
+		LagCompensation->UnregisterCharacter(this);
+	}
+
+	if (UShooterHitboxRegistrySubsystem* HitboxRegistry = GetWorld()->GetSubsystem<UShooterHitboxRegistrySubsystem>())
+	{
+		HitboxRegistry->UnregisterCharacter(this);
+	}
+
 	// disable capsule collision
 	GetCapsuleComponent()->SetCollisionEnabled(ECollisionEnabled::NoCollision);
 
@@ -195,8 +242,8 @@ void AShooterNPC::StartShooting(AActor* ActorToShoot)
 	// raise the flag
 	bIsShooting = true;
 
-	// signal the weapon
-	Weapon->StartFiring();
+	// signal the weapon, holding the trigger so semi auto weapons keep refiring
+	Weapon->StartFiring(true);
 }
 
 void AShooterNPC::StopShooting()
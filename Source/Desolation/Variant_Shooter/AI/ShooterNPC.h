@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "Character/DesolationCharacter.h"
 #include "ShooterWeapon/ShooterWeaponHolder.h"
+#include "Combat/ShooterCombatQueryParams.h"
 #include "ShooterNPC.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FPawnDeathDelegate);
@@ -75,6 +76,9 @@ protected:
 	/** Actor currently being targeted */
 	TObjectPtr<AActor> CurrentAimTarget;
 
+	/** Query params prebuilt for this character's aim, line of sight and perception traces */
+	FShooterCombatQueryParams CombatQueryParams;
+
 	/** If true, this character is currently shooting its weapon */
 	bool bIsShooting = false;
 
@@ -150,4 +154,7 @@ public:
 
 	/** Signals this character to stop shooting */
 	void StopShooting();
+
+	/** Returns the query params prebuilt for this character's combat traces */
+	FShooterCombatQueryParams& GetCombatQueryParams() { return CombatQueryParams; }
 };
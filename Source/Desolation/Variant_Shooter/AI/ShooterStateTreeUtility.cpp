@@ -9,6 +9,8 @@
 #include "Perception/AIPerceptionComponent.h"
 #include "ShooterAIController.h"
 #include "StateTreeAsyncExecutionContext.h"
+#include "Combat/ShooterCombatQueryParams.h"
+#include "Combat/ShooterQueryScratch.h"
 
 bool FStateTreeLineOfSightToTargetCondition::TestCondition(FStateTreeExecutionContext& Context) const
 {
@@ -42,20 +44,26 @@ bool FStateTreeLineOfSightToTargetCondition::TestCondition(FStateTreeExecutionCo
 	// get the character's camera location as the source for the line checks
 	const FVector Start = InstanceData.Character->GetFirstPersonCameraComponent()->GetComponentLocation();
 
+	FShooterCombatQueryScope QueryScope;
+
 	// ignore the character and target. We want to ensure there's an unobstructed trace not counting them
-	FCollisionQueryParams QueryParams;
-	QueryParams.AddIgnoredActor(InstanceData.Character);
-	QueryParams.AddIgnoredActor(InstanceData.Target);
+	const FShooterQueryParamsRef QueryParams = InstanceData.Character->GetCombatQueryParams().GetTargetParams(InstanceData.Target);
+
+	// lay out the endpoints for the traces in this frame's scratch memory
+	const UWorld* World = InstanceData.Character->GetWorld();
+	const TArrayView<FVector> Ends = UShooterQueryScratchSubsystem::AllocateFrameArray<FVector>(World, InstanceData.NumberOfVerticalLineOfSightChecks - 1);
+
+	for (int32 i = 0; i < Ends.Num(); ++i)
+	{
+		Ends[i] = CenterOfMass + FVector(0.0f, 0.0f, Extent.Z - ExtentZOffset * i);
+	}
 
 	FHitResult OutHit;
 
 	// run a number of vertically offset line traces to the target location
-	for (int32 i = 0; i < InstanceData.NumberOfVerticalLineOfSightChecks - 1; ++i)
+	for (const FVector& End : Ends)
 	{
-		// calculate the endpoint for the trace
-		const FVector End = CenterOfMass + FVector(0.0f, 0.0f, Extent.Z - ExtentZOffset * i);
-
-		InstanceData.Character->GetWorld()->LineTraceSingleByChannel(OutHit, Start, End, ECC_Visibility, QueryParams);
+		World->LineTraceSingleByChannel(OutHit, Start, End, ECC_Visibility, QueryParams);
 
 		// is the trace unobstructed?
 		if (!OutHit.bBlockingHit)
@@ -245,10 +253,10 @@ EStateTreeRunStatus FStateTreeSenseEnemiesTask::EnterState(FStateTreeExecutionCo
 					// is the direction within our perception cone?
 					if (DirDot >= MaxDot)
 					{
+						FShooterCombatQueryScope QueryScope;
+
 						// run a line trace between the character and the sensed actor
-						FCollisionQueryParams QueryParams;
-						QueryParams.AddIgnoredActor(LambdaInstanceData->Character);
-						QueryParams.AddIgnoredActor(SensedActor);
+						const FShooterQueryParamsRef QueryParams = LambdaInstanceData->Character->GetCombatQueryParams().GetTargetParams(SensedActor);
 
 						FHitResult OutHit;
 